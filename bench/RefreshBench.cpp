@@ -0,0 +1,313 @@
+#include "../include/gamepad/Gamepad.h"
+#include "../include/gamepad/GamepadManager.h"
+#include "../include/gamepad/JSEvent.h"
+#include "../include/gamepad/EventRecorder.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <ctime>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Event values double as an index into the send timestamp table
+static constexpr size_t SEND_SLOTS = 32768;
+
+struct BenchOptions
+{
+    std::string mode = "all";   /* single, batched, wait, ring, epoll or all */
+    size_t events = 100000;     /* events to push through the pipe */
+    size_t rate = 20000;        /* events per second, 0 for as fast as possible (latency then measures backlog) */
+    size_t chunk = 8;           /* events per write(), roughly one hardware report */
+    size_t batch = 128;         /* read batch size for the batched modes */
+    std::string input;          /* recording or raw JSEvent dump to replay instead of synthetic axes */
+    bool realtime = false;      /* replay input with its original timing */
+};
+
+struct BenchResult
+{
+    size_t events = 0;
+    double seconds = 0;
+    double cpuNsPerEvent = 0;
+    uint64_t p50Ns = 0;
+    uint64_t p99Ns = 0;
+    uint64_t readCalls = 0;
+};
+
+struct BenchContext
+{
+    std::vector<std::atomic<uint64_t>> sendNs;
+    std::vector<uint64_t> latencies;
+    size_t observed = 0;
+    short lastValue = -1;
+    std::atomic<uint64_t> producedNs{0};
+
+    BenchContext() : sendNs(SEND_SLOTS) {}
+};
+
+/**
+ *  @brief Gives the current CLOCK_MONOTONIC time.
+ *  @return The time in nanoseconds
+ */
+static uint64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+/**
+ *  @brief Gives the CPU time consumed by the calling thread.
+ *  @return The time in nanoseconds
+ */
+static uint64_t threadCpuNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/**
+ *  @brief Builds the event stream, either synthetic stick motion or a recorded file.
+ *  @param options The benchmark options
+ *  @return The events to send
+ */
+static std::vector<JSEvent> buildStream(const BenchOptions &options)
+{
+    std::vector<JSEvent> stream;
+    if (!options.input.empty())
+    {
+        FILE *file = fopen(options.input.c_str(), "rb");
+        if (!file)
+        {
+            perror("fopen");
+            exit(1);
+        }
+        RecordingHeader header;
+        // Recordings from Gamepad::startRecording() carry a header, raw dumps don't
+        if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != RecordingHeader::MAGIC)
+            rewind(file);
+        JSEvent event;
+        while (fread(&event, sizeof(JSEvent), 1, file) == 1)
+            stream.push_back(event);
+        fclose(file);
+        return stream;
+    }
+    stream.resize(options.events);
+    for (size_t i = 0; i < options.events; i++)
+        // Two sticks' worth of axes, like a pad being swept
+        stream[i] = JSEvent{(uint)(i / 1000), 0, EVENT_AXIS, (uint8_t)(i % 4)};
+    return stream;
+}
+
+/**
+ *  @brief Writes the stream into the pipe in chunks, stamping each chunk's send time.
+ *  @param fd The write end of the pipe
+ *  @param stream The events to send, values are overwritten with the chunk slot
+ *  @param options The benchmark options
+ *  @param context Receives the send timestamps
+ */
+static void produce(int fd, std::vector<JSEvent> stream, const BenchOptions &options, BenchContext &context)
+{
+    uint64_t start = nowNs();
+    size_t chunks = 0;
+    for (size_t offset = 0; offset < stream.size(); offset += options.chunk, chunks++)
+    {
+        size_t count = std::min(options.chunk, stream.size() - offset);
+        uint64_t due = 0;
+        if (options.realtime)
+            due = start + (uint64_t)(stream[offset].time - stream[0].time) * 1000000ull;
+        else if (options.rate > 0)
+            due = start + (uint64_t)offset * 1000000000ull / options.rate;
+        while (due && nowNs() < due)
+            ;
+
+        short slot = (short)(chunks % SEND_SLOTS);
+        for (size_t i = 0; i < count; i++)
+            stream[offset + i].value = slot;
+        context.sendNs[slot].store(nowNs(), std::memory_order_release);
+        const char *data = reinterpret_cast<const char *>(&stream[offset]);
+        size_t remaining = count * sizeof(JSEvent);
+        while (remaining > 0)
+        {
+            ssize_t written = write(fd, data, remaining);
+            if (written <= 0)
+                return;
+            data += written;
+            remaining -= written;
+        }
+    }
+}
+
+/**
+ *  @brief Counts an observed event and samples its send-to-observation latency.
+ *  @param ctx The BenchContext
+ *  @param event The observed event
+ */
+static void observe(void *ctx, const JSEvent &event)
+{
+    BenchContext &context = *static_cast<BenchContext *>(ctx);
+    context.observed++;
+    // One latency sample per chunk, taken at its first event
+    if (event.value != context.lastValue)
+    {
+        context.lastValue = event.value;
+        uint64_t sent = context.sendNs[(size_t)event.value % SEND_SLOTS].load(std::memory_order_acquire);
+        context.latencies.push_back(nowNs() - sent);
+    }
+}
+
+/**
+ *  @brief Runs one mode over a fresh pipe.
+ *  @param mode The mode name
+ *  @param options The benchmark options
+ *  @param stream The events to send
+ *  @return The measurements
+ */
+static BenchResult runMode(const std::string &mode, const BenchOptions &options, const std::vector<JSEvent> &stream)
+{
+    int fds[2];
+    if (pipe(fds) < 0)
+    {
+        perror("pipe");
+        exit(1);
+    }
+    // Large pipe so the producer is limited by the consumer, not the pipe
+    fcntl(fds[1], F_SETPIPE_SZ, 1 << 20);
+
+    BenchContext context;
+    context.latencies.reserve(stream.size() / options.chunk + 1);
+    Gamepad gamepad("/proc/self/fd/" + std::to_string(fds[0]));
+    gamepad.setBatchSize(mode == "single" ? 1 : options.batch);
+    gamepad.onAny(&observe, &context);
+
+    GamepadManager manager;
+    if (mode == "epoll")
+        manager.add(gamepad);
+    if (mode == "ring")
+        gamepad.startReader();
+
+    // Sync events and indices past the device's counts never reach the handler
+    size_t observable = 0;
+    for (const JSEvent &event : stream)
+    {
+        uint8_t type = event.type & ~EVENT_INIT;
+        if ((type == EVENT_AXIS && event.number < gamepad.getAxisCount()) ||
+            (type == EVENT_BUTTON && event.number < gamepad.getButtonCount()))
+            observable++;
+    }
+
+    GamepadStats before = gamepad.getStats();
+    uint64_t cpuStart = threadCpuNs();
+    uint64_t start = nowNs();
+    std::thread producer([&]()
+                         {
+        produce(fds[1], stream, options, context);
+        context.producedNs.store(nowNs(), std::memory_order_release); });
+
+    while (context.observed < observable)
+    {
+        // Bounded in case the count is off (e.g. events lost to a full pipe), one second after the last write
+        uint64_t producedNs = context.producedNs.load(std::memory_order_acquire);
+        if (producedNs && nowNs() - producedNs > 1000000000ull)
+            break;
+        if (mode == "wait")
+            gamepad.waitForEvent(std::chrono::milliseconds(100));
+        else if (mode == "epoll")
+            manager.poll(std::chrono::milliseconds(100));
+        else
+            gamepad.refresh();
+    }
+
+    uint64_t elapsed = nowNs() - start;
+    uint64_t cpu = threadCpuNs() - cpuStart;
+    producer.join();
+    if (mode == "ring")
+        gamepad.stopReader();
+    GamepadStats after = gamepad.getStats();
+    close(fds[1]);
+    close(fds[0]);
+
+    BenchResult result;
+    result.events = context.observed;
+    result.seconds = elapsed / 1e9;
+    result.cpuNsPerEvent = result.events ? (double)cpu / result.events : 0;
+    result.readCalls = after.readCalls - before.readCalls;
+    if (!context.latencies.empty())
+    {
+        std::sort(context.latencies.begin(), context.latencies.end());
+        result.p50Ns = context.latencies[context.latencies.size() / 2];
+        result.p99Ns = context.latencies[context.latencies.size() * 99 / 100];
+    }
+    return result;
+}
+
+/**
+ *  @brief Parses command line options.
+ *  @param argc Argument count
+ *  @param argv Arguments
+ *  @return The options
+ */
+static BenchOptions parseOptions(int argc, char **argv)
+{
+    BenchOptions options;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (arg == "--realtime")
+        {
+            options.realtime = true;
+            continue;
+        }
+        if (!value)
+        {
+            fprintf(stderr, "usage: %s [--mode single|batched|wait|ring|epoll|all] [--events N] "
+                            "[--rate EVENTS_PER_SEC] [--chunk N] [--batch N] [--input FILE [--realtime]]\n",
+                    argv[0]);
+            exit(1);
+        }
+        if (arg == "--mode")
+            options.mode = value;
+        else if (arg == "--events")
+            options.events = strtoul(value, nullptr, 10);
+        else if (arg == "--rate")
+            options.rate = strtoul(value, nullptr, 10);
+        else if (arg == "--chunk")
+            options.chunk = std::max<size_t>(1, strtoul(value, nullptr, 10));
+        else if (arg == "--batch")
+            options.batch = strtoul(value, nullptr, 10);
+        else if (arg == "--input")
+            options.input = value;
+        i++;
+    }
+    return options;
+}
+
+int main(int argc, char **argv)
+{
+    BenchOptions options = parseOptions(argc, argv);
+    std::vector<JSEvent> stream = buildStream(options);
+    std::vector<std::string> modes{"single", "batched", "wait", "ring", "epoll"};
+    if (options.mode != "all")
+        modes = {options.mode};
+
+    // Unpaced, events pile up in the pipe and the percentiles measure that backlog, not latency
+    bool paced = options.rate > 0 || (options.realtime && !options.input.empty());
+    printf("%-8s %10s %12s %10s %12s %12s %10s\n", "mode", "events", "events/s", "ns/event",
+           paced ? "p50 ns" : "p50 backlog", paced ? "p99 ns" : "p99 backlog", "reads");
+    for (const std::string &mode : modes)
+    {
+        BenchResult result = runMode(mode, options, stream);
+        printf("%-8s %10zu %12.0f %10.1f %12lu %12lu %10lu\n", mode.c_str(), result.events,
+               result.events / result.seconds, result.cpuNsPerEvent,
+               (unsigned long)result.p50Ns, (unsigned long)result.p99Ns, (unsigned long)result.readCalls);
+    }
+    return 0;
+}
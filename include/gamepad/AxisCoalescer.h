@@ -0,0 +1,111 @@
+#ifndef AXISCOALESCER_H
+#define AXISCOALESCER_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include "GamepadState.h"
+#include "BitMask.h"
+#include "JSEvent.h"
+
+/**
+ *  @brief How the events of one axis are thinned out before they are applied.
+ *  @details Events of a coalesced axis within one batch always collapse to the latest.
+ */
+struct AxisCoalescing
+{
+    std::chrono::microseconds interval{0}; /* at most one event per interval, 0 to only merge within a batch */
+    uint16_t threshold = 0;                /* smaller changes wait until the axis is quiet, 0 to pass all */
+};
+
+/**
+ *  @brief Collapses bursts of axis events to their latest value, with optional rate limit and hysteresis.
+ *  @details Works in place on a batch of raw events: an axis event followed by another one for
+ *  @details the same axis is dropped, and the survivor is held back if it comes too soon after
+ *  @details the last applied value or differs from it by less than the threshold. Held-back
+ *  @details values are never lost, flush() hands them out once the interval has passed,
+ *  @details and a sub-threshold value once its axis had no newer event, so the final state
+ *  @details always arrives. Button, sync and init events are never touched.
+ */
+class AxisCoalescer
+{
+public:
+    /**
+     *  @brief Initializes an AxisCoalescer that passes every axis through.
+     *  @return The created AxisCoalescer object
+     */
+    AxisCoalescer();
+
+    /**
+     *  @brief Coalesces one axis.
+     *  @param axis The index of the axis
+     *  @param options The interval and threshold
+     *  @return 0 on success, -1 if the index is out of range
+     */
+    int setOptions(size_t axis, const AxisCoalescing &options);
+
+    /**
+     *  @brief Gives the options of one axis.
+     *  @param axis The index of the axis, must be below GamepadState::MAX_AXES
+     *  @return The options
+     */
+    const AxisCoalescing &getOptions(size_t axis) const;
+
+    /**
+     *  @brief Drops superseded and held-back axis events from a batch.
+     *  @param events The batch, compacted in place
+     *  @param count The number of events
+     *  @param nowNs CLOCK_MONOTONIC time of the batch
+     *  @return The number of events left, in their original order
+     */
+    size_t filter(JSEvent *events, size_t count, uint64_t nowNs);
+
+    /**
+     *  @brief Hands out the held-back values that may be applied now.
+     *  @param nowNs CLOCK_MONOTONIC time, usually that of the last filter()
+     *  @param out Buffer of at least GamepadState::MAX_AXES events
+     *  @return The number of events written
+     *  @details Call once after the filter() calls of a refresh: a sub-threshold value is
+     *  @details released by the first call that follows no new event on its axis.
+     */
+    size_t flush(uint64_t nowNs, JSEvent *out);
+
+    /**
+     *  @brief Gives how long until flush() has a held-back value to hand out.
+     *  @param nowNs CLOCK_MONOTONIC time
+     *  @return Nanoseconds until the earliest one is due, 0 if one is due now, -1 if none is held
+     *  @details A sub-threshold value is due once its interval has passed, the flush() of
+     *  @details a refresh that reads nothing new for its axis then releases it.
+     */
+    int64_t nextDueNs(uint64_t nowNs) const;
+
+    /**
+     *  @brief Drops the held-back values, e.g. when the stream is reopened.
+     */
+    void reset();
+
+private:
+    std::array<AxisCoalescing, GamepadState::MAX_AXES> options;
+    // Flat copies of the options for the per-event checks
+    std::array<uint64_t, GamepadState::MAX_AXES> intervalNs{};
+    std::array<uint16_t, GamepadState::MAX_AXES> thresholds{};
+    std::array<short, GamepadState::MAX_AXES> applied{};
+    std::array<uint64_t, GamepadState::MAX_AXES> appliedNs{};
+    std::array<JSEvent, GamepadState::MAX_AXES> held{};
+    BitMask<GamepadState::MAX_AXES> coalesced;
+    BitMask<GamepadState::MAX_AXES> pending;
+    BitMask<GamepadState::MAX_AXES> touched;
+
+    /**
+     *  @brief Checks whether a value may be applied now.
+     *  @param axis The index of the axis
+     *  @param value The value
+     *  @param nowNs CLOCK_MONOTONIC time
+     *  @param quiet Whether the axis had no event since the last flush()
+     *  @return true if it may be applied
+     */
+    bool due(size_t axis, short value, uint64_t nowNs, bool quiet) const;
+};
+
+#endif // AXISCOALESCER_H
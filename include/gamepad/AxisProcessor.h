@@ -0,0 +1,170 @@
+#ifndef AXISPROCESSOR_H
+#define AXISPROCESSOR_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "GamepadState.h"
+#include "BitMask.h"
+
+/**
+ *  @brief How one raw axis is turned into a float in [-1, 1].
+ *  @details Applied in order: centering and range scaling, axial deadzone and saturation,
+ *  @details response curve, inversion.
+ */
+struct AxisCalibration
+{
+    short center = 0;         /* raw value at rest */
+    short minimum = -32767;   /* raw value at full negative travel */
+    short maximum = 32767;    /* raw value at full positive travel */
+    float deadzone = 0.0f;    /* fraction of travel around the center reported as 0 */
+    float saturation = 1.0f;  /* fraction of travel reported as full output */
+    float curve = 0.0f;       /* 0 for a linear response, up to 1 for a cubic one */
+    bool invert = false;      /* flip the sign of the output */
+};
+
+/**
+ *  @brief Deadzone, calibration and normalization for every axis of a GamepadState.
+ *  @details Parameters live in separate aligned float arrays so four axes are processed
+ *  @details per SSE2/NEON instruction, and only blocks of four containing a changed axis
+ *  @details are recomputed. Builds without either fall back to the same math in scalar code.
+ */
+class AxisProcessor
+{
+public:
+    /**
+     *  @brief Number of axes processed per vector.
+     */
+    static constexpr size_t LANES = 4;
+
+    /**
+     *  @brief Most axis pairs that can share a radial deadzone.
+     */
+    static constexpr size_t MAX_RADIAL_PAIRS = 16;
+
+    /**
+     *  @brief Initializes an AxisProcessor with identity calibration on every axis.
+     *  @return The created AxisProcessor object
+     */
+    AxisProcessor();
+
+    /**
+     *  @brief Replaces the calibration of one axis.
+     *  @param axis The index of the axis
+     *  @param calibration The new calibration
+     *  @return 0 on success, -1 if the index is out of range
+     */
+    int setCalibration(size_t axis, const AxisCalibration &calibration);
+
+    /**
+     *  @brief Gives the calibration of one axis.
+     *  @param axis The index of the axis, must be below GamepadState::MAX_AXES
+     *  @return The calibration
+     */
+    const AxisCalibration &getCalibration(size_t axis) const;
+
+    /**
+     *  @brief Makes two axes share a circular deadzone, replacing any previous one for the pair.
+     *  @param xAxis The index of the horizontal axis
+     *  @param yAxis The index of the vertical axis
+     *  @param deadzone Radius reported as the center, as a fraction of travel
+     *  @param saturation Radius reported as full deflection, as a fraction of travel
+     *  @return 0 on success, -1 if an index is out of range or all pairs are in use
+     *  @details Applied to the normalized pair before the per-axis deadzone, which should
+     *  @details usually be left at 0 for these axes.
+     */
+    int setRadialDeadzone(size_t xAxis, size_t yAxis, float deadzone, float saturation = 1.0f);
+
+    /**
+     *  @brief Removes every radial deadzone.
+     */
+    void clearRadialDeadzones();
+
+    /**
+     *  @brief Forces every axis to be recomputed by the next process() call.
+     */
+    void invalidate();
+
+    /**
+     *  @brief Recomputes the axes that changed.
+     *  @param state The state holding the raw axis values
+     *  @param changes The axes that changed since the last call
+     */
+    void process(const GamepadState &state, const BitMask<GamepadState::MAX_AXES> &changes);
+
+    /**
+     *  @brief Gives the processed value of one axis.
+     *  @param axis The index of the axis, must be below GamepadState::MAX_AXES
+     *  @return The value in [-1, 1]
+     */
+    float get(size_t axis) const
+    {
+        return this->values[axis];
+    }
+
+    /**
+     *  @brief Gives every processed axis value.
+     *  @return The values in [-1, 1], indexed by axis
+     */
+    const std::array<float, GamepadState::MAX_AXES> &getValues() const
+    {
+        return this->values;
+    }
+
+private:
+    static constexpr size_t BLOCKS = GamepadState::MAX_AXES / LANES;
+
+    struct RadialPair
+    {
+        uint8_t xAxis;
+        uint8_t yAxis;
+        float deadzone;
+        float scale; /* 1 / (saturation - deadzone) */
+    };
+
+    // Structure of arrays, indexed by axis, each 16 byte aligned for vector loads
+    alignas(64) std::array<float, GamepadState::MAX_AXES> center;
+    alignas(64) std::array<float, GamepadState::MAX_AXES> positiveScale;
+    alignas(64) std::array<float, GamepadState::MAX_AXES> negativeScale;
+    alignas(64) std::array<float, GamepadState::MAX_AXES> deadzone;
+    alignas(64) std::array<float, GamepadState::MAX_AXES> deadzoneScale;
+    alignas(64) std::array<float, GamepadState::MAX_AXES> curve;
+    alignas(64) std::array<float, GamepadState::MAX_AXES> gain;
+    alignas(64) std::array<float, GamepadState::MAX_AXES> normalized;
+    alignas(64) std::array<float, GamepadState::MAX_AXES> values;
+    std::array<AxisCalibration, GamepadState::MAX_AXES> calibrations;
+    std::array<RadialPair, MAX_RADIAL_PAIRS> pairs;
+    size_t pairCount;
+    bool stale;
+
+    /**
+     *  @brief Centers, scales and clamps four raw axes into normalized.
+     *  @param raw Pointer to the first raw value of the block
+     *  @param first The index of the first axis in the block
+     */
+    void normalizeBlock(const short *raw, size_t first);
+
+    /**
+     *  @brief Applies deadzone, curve and inversion to four normalized axes.
+     *  @param first The index of the first axis in the block
+     */
+    void shapeBlock(size_t first);
+
+    /**
+     *  @brief Rescales one radial pair inside normalized.
+     *  @param pair The pair
+     */
+    void applyRadial(const RadialPair &pair);
+
+    /**
+     *  @brief Gives the blocks holding the axes of a radial pair.
+     *  @param pair The pair
+     *  @return One bit per block of LANES axes
+     */
+    static uint64_t pairBlocks(const RadialPair &pair)
+    {
+        return uint64_t(1) << (pair.xAxis / LANES) | uint64_t(1) << (pair.yAxis / LANES);
+    }
+};
+
+#endif // AXISPROCESSOR_H
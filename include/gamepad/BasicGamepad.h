@@ -0,0 +1,97 @@
+#ifndef BASICGAMEPAD_H
+#define BASICGAMEPAD_H
+
+#include <cstring>
+#include "Gamepad.h"
+#include "GamepadLayout.h"
+
+/**
+ *  @brief A Gamepad whose controls are known at compile time.
+ *  @details Named accessors like get<XboxLayout::Button::A>() are checked against the layout
+ *  @details by static_assert and compile to a single load, without the runtime bounds checks
+ *  @details of getButton(int). Everything else behaves exactly like Gamepad.
+ */
+template <typename Layout>
+class BasicGamepad : public Gamepad
+{
+public:
+    using Axis = typename Layout::Axis;
+    using Button = typename Layout::Button;
+
+    static_assert(Layout::AXES <= GamepadState::MAX_AXES, "layout has more axes than joydev can report");
+    static_assert(Layout::BUTTONS <= GamepadState::MAX_BUTTONS, "layout has more buttons than joydev can report");
+
+    using Gamepad::Gamepad;
+
+    /**
+     *  @brief Gives the most up-to-date value of a button of the layout.
+     *  @return The current value of the button, 0 if the device doesn't report it
+     */
+    template <Button B>
+    short get() const
+    {
+        static_assert((size_t)B < Layout::BUTTONS, "button is not part of the layout");
+        return this->cachedState().buttons[(size_t)B];
+    }
+
+    /**
+     *  @brief Gives the most up-to-date value of an axis of the layout.
+     *  @return The current value of the axis, 0 if the device doesn't report it
+     */
+    template <Axis A>
+    short get() const
+    {
+        static_assert((size_t)A < Layout::AXES, "axis is not part of the layout");
+        return this->cachedState().axes[(size_t)A];
+    }
+
+    /**
+     *  @brief Checks whether a button of the layout was pressed during the last refresh().
+     *  @return true if pressed since the previous refresh()
+     */
+    template <Button B>
+    bool wasPressed() const
+    {
+        static_assert((size_t)B < Layout::BUTTONS, "button is not part of the layout");
+        return this->pressedButtons().test((size_t)B);
+    }
+
+    /**
+     *  @brief Checks whether a button of the layout was released during the last refresh().
+     *  @return true if released since the previous refresh()
+     */
+    template <Button B>
+    bool wasReleased() const
+    {
+        static_assert((size_t)B < Layout::BUTTONS, "button is not part of the layout");
+        return this->releasedButtons().test((size_t)B);
+    }
+
+    /**
+     *  @brief Checks whether the open device reports at least every control of the layout.
+     *  @return true if the axis and button counts cover the layout
+     */
+    bool matchesLayout()
+    {
+        return (size_t)this->getAxisCount() >= Layout::AXES && (size_t)this->getButtonCount() >= Layout::BUTTONS;
+    }
+
+    /**
+     *  @brief Gives a consistent copy of the layout's axes and buttons as of the last refresh().
+     *  @return The LayoutState, safe to call from any thread like snapshot()
+     */
+    LayoutState<Layout> layoutSnapshot() const
+    {
+        GamepadState full = this->snapshot();
+        LayoutState<Layout> state;
+        std::memcpy(state.axes.data(), full.axes.data(), sizeof(state.axes));
+        std::memcpy(state.buttons.data(), full.buttons.data(), sizeof(state.buttons));
+        return state;
+    }
+};
+
+using XboxGamepad = BasicGamepad<XboxLayout>;
+using DualShockGamepad = BasicGamepad<DualShockLayout>;
+using GenericGamepad = BasicGamepad<DynamicLayout>;
+
+#endif // BASICGAMEPAD_H
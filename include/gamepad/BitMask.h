@@ -0,0 +1,147 @@
+#ifndef BITMASK_H
+#define BITMASK_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ *  @brief Fixed-size bit set that iterates over its set bits in index order.
+ *  @details Iteration costs one step per set bit plus one per 64-bit word.
+ */
+template <size_t Bits>
+class BitMask
+{
+public:
+    static constexpr size_t WORDS = (Bits + 63) / 64;
+
+    class iterator
+    {
+    public:
+        iterator(const std::array<uint64_t, WORDS> *words, size_t word) : words(words), word(word), bits(0)
+        {
+            if (this->word < WORDS)
+            {
+                this->bits = (*this->words)[this->word];
+                this->skipEmpty();
+            }
+        }
+
+        size_t operator*() const
+        {
+            return this->word * 64 + __builtin_ctzll(this->bits);
+        }
+
+        iterator &operator++()
+        {
+            // Clear lowest set bit
+            this->bits &= this->bits - 1;
+            this->skipEmpty();
+            return *this;
+        }
+
+        bool operator!=(const iterator &other) const
+        {
+            return this->word != other.word || this->bits != other.bits;
+        }
+
+    private:
+        const std::array<uint64_t, WORDS> *words;
+        size_t word;
+        uint64_t bits;
+
+        void skipEmpty()
+        {
+            while (this->bits == 0 && ++this->word < WORDS)
+                this->bits = (*this->words)[this->word];
+            if (this->word >= WORDS)
+                this->word = WORDS;
+        }
+    };
+
+    /**
+     *  @brief Sets a bit.
+     *  @param index The index of the bit, must be less than Bits
+     */
+    void set(size_t index)
+    {
+        this->words[index >> 6] |= uint64_t(1) << (index & 63);
+    }
+
+    /**
+     *  @brief Clears a bit.
+     *  @param index The index of the bit, must be less than Bits
+     */
+    void reset(size_t index)
+    {
+        this->words[index >> 6] &= ~(uint64_t(1) << (index & 63));
+    }
+
+    /**
+     *  @brief Checks a bit.
+     *  @param index The index of the bit
+     *  @return true if set, false if unset or out of range
+     */
+    bool test(size_t index) const
+    {
+        return index < Bits && ((this->words[index >> 6] >> (index & 63)) & 1);
+    }
+
+    /**
+     *  @brief Clears all bits.
+     */
+    void clear()
+    {
+        this->words.fill(0);
+    }
+
+    /**
+     *  @brief Checks whether any bit is set.
+     *  @return true if at least one bit is set
+     */
+    bool any() const
+    {
+        for (uint64_t word : this->words)
+        {
+            if (word)
+                return true;
+        }
+        return false;
+    }
+
+    /**
+     *  @brief Counts the set bits.
+     *  @return The number of set bits
+     */
+    size_t count() const
+    {
+        size_t total = 0;
+        for (uint64_t word : this->words)
+            total += __builtin_popcountll(word);
+        return total;
+    }
+
+    /**
+     *  @brief Gives the raw 64-bit words, bit i lives in word i / 64.
+     *  @return The words
+     */
+    const std::array<uint64_t, WORDS> &data() const
+    {
+        return this->words;
+    }
+
+    iterator begin() const
+    {
+        return iterator(&this->words, 0);
+    }
+
+    iterator end() const
+    {
+        return iterator(&this->words, WORDS);
+    }
+
+private:
+    std::array<uint64_t, WORDS> words{};
+};
+
+#endif // BITMASK_H
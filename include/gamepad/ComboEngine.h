@@ -0,0 +1,252 @@
+#ifndef COMBOENGINE_H
+#define COMBOENGINE_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+#include "JSEvent.h"
+#include "GamepadState.h"
+#include "BitMask.h"
+
+enum class ComboType : uint8_t
+{
+    CHORD,    /* every button held at once */
+    SEQUENCE, /* buttons pressed in order, each within a gap of the previous one */
+    HOLD,     /* a button held for a duration */
+    FLICK     /* an axis moved from rest past a threshold within a duration */
+};
+
+/**
+ *  @brief Detects chords, sequences, double taps, holds and stick flicks in a JSEvent stream.
+ *  @details Patterns are compiled into per-control lists, so each event only advances the
+ *  @details little state machines of the patterns that mention its button or axis: cost
+ *  @details follows the event rate, not the number of registered patterns. Times are the
+ *  @details events' own millisecond timestamps. Presses of buttons a pattern doesn't use
+ *  @details neither advance nor break it.
+ */
+class ComboEngine
+{
+public:
+    /**
+     *  @brief Plain function pointer invoked when a pattern matches.
+     *  @param context The context pointer given at registration
+     *  @param combo The id returned when the pattern was added
+     *  @param time Timestamp of the event (or update()) completing the pattern, in ms
+     */
+    using MatchHandler = void (*)(void *context, int combo, uint32_t time);
+
+    /**
+     *  @brief Most patterns an engine can hold.
+     */
+    static constexpr size_t MAX_COMBOS = 1024;
+
+    /**
+     *  @brief Initializes a ComboEngine without patterns.
+     *  @return The created ComboEngine object
+     */
+    ComboEngine();
+
+    /**
+     *  @brief Adds a pattern matching when every button is held at once.
+     *  @param buttons The buttons, at most 64
+     *  @param window Longest time between the first and last press, 0 for any
+     *  @return The combo id, -1 if the pattern is invalid or the engine is full
+     *  @details Matches once per chord, again only after one of its buttons was released.
+     */
+    int addChord(std::initializer_list<uint8_t> buttons, std::chrono::milliseconds window = std::chrono::milliseconds(0));
+
+    /**
+     *  @brief Adds a pattern matching buttons pressed in order.
+     *  @param buttons The buttons, at most 64
+     *  @param maxGap Longest time between two consecutive presses
+     *  @return The combo id, -1 if the pattern is invalid or the engine is full
+     */
+    int addSequence(std::initializer_list<uint8_t> buttons, std::chrono::milliseconds maxGap);
+
+    /**
+     *  @brief Adds a pattern matching two presses of the same button.
+     *  @param button The button
+     *  @param window Longest time between the two presses
+     *  @return The combo id, -1 if the engine is full
+     */
+    int addDoubleTap(uint8_t button, std::chrono::milliseconds window);
+
+    /**
+     *  @brief Adds a pattern matching a button held for a duration.
+     *  @param button The button
+     *  @param duration How long it must be held
+     *  @return The combo id, -1 if the engine is full
+     *  @details Matches on the first event or update() at least duration after the press.
+     */
+    int addHold(uint8_t button, std::chrono::milliseconds duration);
+
+    /**
+     *  @brief Adds a pattern matching an axis flicked from rest past a threshold.
+     *  @param axis The axis
+     *  @param threshold Value to reach, its sign gives the direction
+     *  @param within Longest time from leaving rest to reaching the threshold
+     *  @return The combo id, -1 if the threshold is 0 or the engine is full
+     *  @details Rest is within a quarter of the threshold around the center.
+     */
+    int addFlick(uint8_t axis, short threshold, std::chrono::milliseconds within);
+
+    /**
+     *  @brief Sets the handler called for every match, replacing any previous one.
+     *  @param handler The handler, nullptr to remove
+     *  @param context Passed back to the handler
+     */
+    void onMatch(MatchHandler handler, void *context = nullptr);
+
+    /**
+     *  @brief Registers a callable for every match without copying it.
+     *  @param callable Invoked as callable(combo, time), must outlive the registration
+     */
+    template <typename F>
+    void onMatch(F &callable)
+    {
+        this->onMatch(&ComboEngine::invoke<F>, &callable);
+    }
+
+    /**
+     *  @brief Advances the patterns using the event's button or axis.
+     *  @param event The decoded event, init events only update the held buttons
+     */
+    void feed(const JSEvent &event);
+
+    /**
+     *  @brief Advances the patterns for a batch of events.
+     *  @param events Pointer to the first event
+     *  @param count The number of events
+     */
+    void feed(const JSEvent *events, size_t count);
+
+    /**
+     *  @brief Lets holds match without waiting for another event.
+     *  @param time The current time on the events' clock, in ms
+     */
+    void update(uint32_t time);
+
+    /**
+     *  @brief Feeds one event, so the engine can be registered with Gamepad::onAny().
+     *  @param event The decoded event
+     */
+    void operator()(const JSEvent &event)
+    {
+        this->feed(event);
+    }
+
+    /**
+     *  @brief Gives the combos matched since the last clearMatches().
+     *  @return A mask indexed by combo id
+     */
+    const BitMask<MAX_COMBOS> &matches() const
+    {
+        return this->matched;
+    }
+
+    /**
+     *  @brief Checks whether a combo matched since the last clearMatches().
+     *  @param combo The combo id
+     *  @return true if it matched
+     */
+    bool wasMatched(int combo) const
+    {
+        return combo >= 0 && this->matched.test(combo);
+    }
+
+    /**
+     *  @brief Forgets the matches reported so far, e.g. once per frame.
+     */
+    void clearMatches();
+
+    /**
+     *  @brief Drops the progress of every pattern, e.g. after a reconnect.
+     */
+    void reset();
+
+private:
+    struct Pattern
+    {
+        ComboType type;
+        uint8_t control;   /* button or axis for HOLD / FLICK */
+        uint8_t length;    /* number of steps for CHORD / SEQUENCE */
+        uint8_t progress;  /* steps matched, or 1 while a hold / flick / chord is armed */
+        uint16_t first;    /* index of the first step in steps */
+        short threshold;   /* FLICK target, sign gives the direction */
+        uint32_t windowMs; /* chord window, sequence gap, hold duration or flick time */
+        uint32_t lastMs;   /* time of the last step, press or rest */
+    };
+
+    std::vector<Pattern> patterns;
+    std::vector<uint8_t> steps;
+    // Per SEQUENCE step, the longest proper prefix that also ends there (the KMP failure function)
+    std::vector<uint8_t> fallback;
+    // Compiled index: the patterns to evaluate for each control, in CSR form
+    std::array<uint32_t, GamepadState::MAX_BUTTONS + 1> buttonOffsets{};
+    std::array<uint32_t, GamepadState::MAX_AXES + 1> axisOffsets{};
+    std::vector<uint16_t> buttonIndex;
+    std::vector<uint16_t> axisIndex;
+    std::vector<uint16_t> armedHolds;
+    bool compiled;
+    BitMask<GamepadState::MAX_BUTTONS> held;
+    std::array<uint32_t, GamepadState::MAX_BUTTONS> pressMs{};
+    BitMask<MAX_COMBOS> matched;
+    MatchHandler handler;
+    void *context;
+
+    /**
+     *  @brief Trampoline from MatchHandler to a registered callable.
+     */
+    template <typename F>
+    static void invoke(void *context, int combo, uint32_t time)
+    {
+        (*static_cast<F *>(context))(combo, time);
+    }
+
+    /**
+     *  @brief Appends a pattern and marks the index stale.
+     *  @param pattern The pattern
+     *  @param buttons Its steps
+     *  @return The combo id, -1 if the engine is full
+     */
+    int addPattern(Pattern pattern, std::initializer_list<uint8_t> buttons);
+
+    /**
+     *  @brief Rebuilds the per-control index from the registered patterns.
+     */
+    void compile();
+
+    /**
+     *  @brief Computes the fallback entries of a sequence.
+     *  @param pattern The SEQUENCE pattern
+     */
+    void compileFallback(const Pattern &pattern);
+
+    /**
+     *  @brief Advances the patterns using a button.
+     *  @param button The button
+     *  @param pressed Whether it went down
+     *  @param time The event time in ms
+     */
+    void feedButton(uint8_t button, bool pressed, uint32_t time);
+
+    /**
+     *  @brief Advances the patterns using an axis.
+     *  @param axis The axis
+     *  @param value The new value
+     *  @param time The event time in ms
+     */
+    void feedAxis(uint8_t axis, short value, uint32_t time);
+
+    /**
+     *  @brief Records and reports a match.
+     *  @param combo The combo id
+     *  @param time The time of the completing event
+     */
+    void match(size_t combo, uint32_t time);
+};
+
+#endif // COMBOENGINE_H
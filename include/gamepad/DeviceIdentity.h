@@ -0,0 +1,59 @@
+#ifndef DEVICEIDENTITY_H
+#define DEVICEIDENTITY_H
+
+#include <string>
+#include <cstdint>
+
+/**
+ *  @brief What identifies a physical controller across reconnections.
+ *  @details Queried once when a Gamepad first opens its device, then used to reopen the
+ *  @details same controller through its /dev/input/by-id link and to reject a different
+ *  @details controller that was enumerated under the old 'jsX' name.
+ */
+struct DeviceIdentity
+{
+    std::string name;       /* JSIOCGNAME / EVIOCGNAME, empty if the node is not an input device */
+    uint16_t busType = 0;   /* BUS_USB, BUS_BLUETOOTH, ... */
+    uint16_t vendor = 0;    /* USB / Bluetooth vendor id */
+    uint16_t product = 0;   /* USB / Bluetooth product id */
+    uint16_t version = 0;   /* hardware revision */
+    std::string stablePath; /* /dev/input/by-id link resolving to the node, empty if none */
+
+    /**
+     *  @brief Checks whether anything could be learned about the device.
+     *  @return true if the node reported a name
+     */
+    bool valid() const
+    {
+        return !this->name.empty();
+    }
+
+    /**
+     *  @brief Checks whether two identities describe the same controller model.
+     *  @param other The identity to compare with
+     *  @return true if name, bus, vendor and product are equal
+     */
+    bool matches(const DeviceIdentity &other) const
+    {
+        return this->name == other.name && this->busType == other.busType &&
+               this->vendor == other.vendor && this->product == other.product;
+    }
+
+    /**
+     *  @brief Reads the identity of an open device node.
+     *  @param fd The file descriptor of a 'jsX' or 'eventX' node
+     *  @return The identity without stablePath, invalid if the node answers neither API
+     *  @details Ids come from EVIOCGID on evdev nodes and from sysfs for joydev nodes.
+     */
+    static DeviceIdentity query(int fd);
+
+    /**
+     *  @brief Finds the /dev/input/by-id link pointing at a device node.
+     *  @param path The path to the node
+     *  @return The link, empty if there is none (e.g. most Bluetooth pads)
+     *  @details Only reads links, no device node is opened.
+     */
+    static std::string findStablePath(const std::string &path);
+};
+
+#endif // DEVICEIDENTITY_H
@@ -0,0 +1,129 @@
+#ifndef EVDEVSOURCE_H
+#define EVDEVSOURCE_H
+
+#include <array>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <sys/types.h>
+#include <linux/input.h>
+#include "JSEvent.h"
+#include "GamepadState.h"
+
+class EvdevSource
+{
+public:
+    /**
+     *  @brief Initializes an EvdevSource without an open device.
+     *  @return The created EvdevSource object
+     */
+    EvdevSource();
+
+    /**
+     *  @brief Takes ownership of an open '/dev/input/eventX' file descriptor.
+     *  @param fd The file descriptor
+     *  @details Numbers axes and buttons the same way joydev does, so indices match the 'jsX' node,
+     *  @details and queues init events describing the current state.
+     */
+    void adopt(int fd);
+
+    /**
+     *  @brief Reads input_events and translates them into JSEvents.
+     *  @param buf A buffer to read JSEvents into
+     *  @param size The size of the buffer in bytes
+     *  @return The number of bytes of JSEvents produced, or -1 with errno set
+     *  @details Axes are rescaled from the device's range to [-32767, 32767].
+     *  @details Every SYN_REPORT closing a report with mapped events becomes an EVENT_SYNC.
+     *  @details After SYN_DROPPED the events up to the next SYN_REPORT are discarded and
+     *  @details replaced by init events describing the device state at that point.
+     */
+    ssize_t read(void *buf, size_t size);
+
+    /**
+     *  @brief Gives the full-precision timestamp of an event produced by the last read().
+     *  @param index The position of the event in the buffer passed to read()
+     *  @return CLOCK_MONOTONIC time in microseconds, JSEvent::time only keeps milliseconds
+     */
+    uint64_t getTimeUs(size_t index);
+
+    /**
+     *  @brief Checks whether translated events are buffered, which the fd won't signal.
+     *  @return true if init events or input_events left over by the last read() are waiting
+     */
+    bool hasPending();
+
+    /**
+     *  @brief Closes the device.
+     *  @return The output of the close() system call, 0 if it was not open
+     */
+    int close();
+
+    /**
+     *  @brief Gives the device file descriptor.
+     *  @return The file descriptor, -1 if not open
+     */
+    int getFd();
+
+    /**
+     *  @brief Gives the number of absolute axes on the device.
+     *  @return The axis count
+     */
+    uint16_t getAxisCount();
+
+    /**
+     *  @brief Gives the number of buttons on the device.
+     *  @return The button count
+     */
+    uint16_t getButtonCount();
+
+private:
+    // Marks a code the device does not have
+    static constexpr uint16_t UNMAPPED = 0xFFFF;
+
+    struct AxisRange
+    {
+        int32_t minimum;
+        int32_t maximum;
+    };
+
+    int fd;
+    uint16_t axisCount;
+    uint16_t buttonCount;
+    std::array<uint16_t, ABS_CNT> axisMap;
+    std::array<AxisRange, GamepadState::MAX_AXES> ranges;
+    std::array<uint16_t, KEY_CNT - BTN_MISC> buttonMap;
+    std::vector<JSEvent> pending;
+    uint64_t pendingTimeUs;
+    size_t pendingPosition;
+    std::vector<uint64_t> timesUs;
+    // input_events read but not yet translated, because init events filled the buffer
+    std::array<struct input_event, 64> stash;
+    size_t stashPosition;
+    size_t stashCount;
+    bool frameOpen;
+    bool dropping;
+
+    /**
+     *  @brief Queues init events for the current state of every axis and button.
+     *  @param timeUs Timestamp for the events, in microseconds
+     */
+    void queueState(uint64_t timeUs);
+
+    /**
+     *  @brief Copies queued init events into a read() buffer.
+     *  @param out The buffer
+     *  @param produced Events already in the buffer, updated
+     *  @param wanted Capacity of the buffer in events
+     */
+    void emitPending(JSEvent *out, size_t &produced, size_t wanted);
+
+    /**
+     *  @brief Rescales a raw axis value to the joystick API range.
+     *  @param axis The axis index
+     *  @param value The raw value
+     *  @return The scaled value
+     */
+    short scale(uint16_t axis, int32_t value);
+};
+
+#endif // EVDEVSOURCE_H
@@ -0,0 +1,114 @@
+#ifndef EVENTHISTORY_H
+#define EVENTHISTORY_H
+
+#include <array>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include "JSEvent.h"
+
+/**
+ *  @brief Fixed-size history of the most recent events, oldest entries are overwritten.
+ *  @details Appending is O(1). Not thread-safe, owned by the thread applying events.
+ *  @details Times are the kernel's millisecond timestamps and are compared wrap-safely.
+ */
+template <size_t Capacity>
+class EventHistory
+{
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "EventHistory capacity must be a power of two");
+
+public:
+    /**
+     *  @brief Appends an event, overwriting the oldest one when full.
+     *  @param event The event to record
+     */
+    void push(const JSEvent &event)
+    {
+        this->buffer[this->total & (Capacity - 1)] = event;
+        this->total++;
+    }
+
+    /**
+     *  @brief Gives the number of events currently held.
+     *  @return The event count, at most Capacity
+     */
+    size_t size() const
+    {
+        return this->total < Capacity ? (size_t)this->total : Capacity;
+    }
+
+    /**
+     *  @brief Gives the number of events appended since the last clear(), including overwritten ones.
+     *  @return The running count, lets a consumer find the events added since it last looked
+     */
+    uint64_t pushed() const
+    {
+        return this->total;
+    }
+
+    /**
+     *  @brief Gives a held event by age.
+     *  @param index 0 for the oldest held event, size() - 1 for the newest
+     *  @return The event
+     */
+    const JSEvent &at(size_t index) const
+    {
+        return this->buffer[(this->total - this->size() + index) & (Capacity - 1)];
+    }
+
+    /**
+     *  @brief Copies the events with a timestamp at or after the given time.
+     *  @param time Kernel timestamp in milliseconds
+     *  @param out Buffer to copy into, oldest first
+     *  @param max Size of out, only the newest max events are copied if there are more
+     *  @return The number of events copied
+     */
+    size_t since(uint time, JSEvent *out, size_t max) const
+    {
+        size_t held = this->size();
+        size_t matching = 0;
+        // Events are recorded in kernel order, stop at the first older one
+        while (matching < held && (int32_t)(this->at(held - 1 - matching).time - time) >= 0)
+            matching++;
+        size_t count = std::min(matching, max);
+        for (size_t i = 0; i < count; i++)
+            out[i] = this->at(held - count + i);
+        return count;
+    }
+
+    /**
+     *  @brief Copies the most recent events for one control.
+     *  @param type EVENT_BUTTON or EVENT_AXIS, init events are included
+     *  @param number The index of the button or axis
+     *  @param out Buffer to copy into, oldest first
+     *  @param max Size of out and the number of events wanted
+     *  @return The number of events copied
+     */
+    size_t last(uint8_t type, uint8_t number, JSEvent *out, size_t max) const
+    {
+        size_t held = this->size();
+        size_t count = 0;
+        for (size_t i = held; i > 0 && count < max; i--)
+        {
+            const JSEvent &event = this->at(i - 1);
+            if ((event.type & ~EVENT_INIT) == type && event.number == number)
+                out[count++] = event;
+        }
+        std::reverse(out, out + count);
+        return count;
+    }
+
+    /**
+     *  @brief Drops all held events.
+     */
+    void clear()
+    {
+        this->total = 0;
+    }
+
+private:
+    std::array<JSEvent, Capacity> buffer{};
+    uint64_t total = 0;
+};
+
+#endif // EVENTHISTORY_H
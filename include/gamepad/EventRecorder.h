@@ -0,0 +1,127 @@
+#ifndef EVENTRECORDER_H
+#define EVENTRECORDER_H
+
+#include <string>
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include "JSEvent.h"
+
+/**
+ *  @brief Header at the start of every recording.
+ *  @details Followed by native-endian JSEvent records, 8 bytes each, in read order.
+ */
+struct RecordingHeader
+{
+    static constexpr uint32_t MAGIC = 0x56455047; /* "GPEV" */
+    static constexpr uint16_t VERSION = 1;
+
+    uint32_t magic = MAGIC;
+    uint16_t version = VERSION;
+    uint16_t recordSize = sizeof(JSEvent);
+    uint16_t axisCount = 0;   /* axes reported by the recorded device */
+    uint16_t buttonCount = 0; /* buttons reported by the recorded device */
+    uint32_t reserved = 0;
+};
+
+/**
+ *  @brief Appends events to a recording file without blocking the recording thread on disk I/O.
+ *  @details Events fill one of BUFFER_COUNT buffers, a full buffer is handed to a writer
+ *  @details thread. append() only waits if the disk falls a whole ring of buffers behind.
+ */
+class EventRecorder
+{
+public:
+    /**
+     *  @brief Number of events per buffer handed to the writer thread.
+     */
+    static constexpr size_t BUFFER_SIZE = 4096;
+
+    /**
+     *  @brief Number of buffers, one being filled while the others wait for or are being written.
+     */
+    static constexpr size_t BUFFER_COUNT = 4;
+
+    /**
+     *  @brief Initializes an EventRecorder without an open file.
+     *  @return The created EventRecorder object
+     */
+    EventRecorder();
+
+    /**
+     *  @brief Destructor for EventRecorder object, flushes and closes the file
+     */
+    ~EventRecorder();
+
+    EventRecorder(const EventRecorder &) = delete;
+    EventRecorder &operator=(const EventRecorder &) = delete;
+
+    /**
+     *  @brief Creates or truncates a recording and writes its header.
+     *  @param path The path to the recording file
+     *  @param axisCount Axes reported by the device being recorded
+     *  @param buttonCount Buttons reported by the device being recorded
+     *  @return 0 on success, -1 on failure with errno set
+     */
+    int open(const std::string &path, uint16_t axisCount, uint16_t buttonCount);
+
+    /**
+     *  @brief Buffers one event, handing the buffer to the writer thread when it fills up.
+     *  @param event The event to record
+     */
+    void append(const JSEvent &event)
+    {
+        this->buffers[this->tail % BUFFER_COUNT][this->buffered++] = event;
+        if (this->buffered == BUFFER_SIZE)
+            this->handOff();
+    }
+
+    /**
+     *  @brief Writes all buffered events to the file and waits until they are written.
+     *  @return 0 on success, -1 on failure with errno set, including earlier failed writes
+     */
+    int flush();
+
+    /**
+     *  @brief Flushes and closes the file.
+     *  @return 0 on success, -1 on failure with errno set
+     */
+    int close();
+
+    /**
+     *  @brief Gives the number of events recorded so far.
+     *  @return The event count
+     */
+    uint64_t getCount();
+
+private:
+    int fd;
+    // Events in the buffer being filled, which is buffers[tail % BUFFER_COUNT]
+    size_t buffered;
+    uint64_t flushed;
+    std::array<std::array<JSEvent, BUFFER_SIZE>, BUFFER_COUNT> buffers;
+    std::array<size_t, BUFFER_COUNT> counts{};
+    // Buffers head to tail - 1 are queued for the writer, guarded by mutex
+    size_t head;
+    size_t tail;
+    int writeErrno;
+    bool stopping;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::thread writerThread;
+
+    /**
+     *  @brief Queues the buffer being filled and moves on to the next one.
+     */
+    void handOff();
+
+    /**
+     *  @brief Body of the writer thread.
+     */
+    void writerLoop();
+};
+
+#endif // EVENTRECORDER_H
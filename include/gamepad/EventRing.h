@@ -0,0 +1,83 @@
+#ifndef EVENTRING_H
+#define EVENTRING_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+/**
+ *  @brief Lock-free single-producer/single-consumer ring buffer.
+ *  @details Exactly one thread may push and exactly one other thread may pop.
+ *  @details Capacity must be a power of two.
+ */
+template <typename T, size_t Capacity>
+class EventRing
+{
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "EventRing capacity must be a power of two");
+
+public:
+    /**
+     *  @brief Pushes one element. Producer side only.
+     *  @param item The element to push
+     *  @return true if pushed, false if the ring is full
+     */
+    bool push(const T &item)
+    {
+        size_t tail = this->tail.load(std::memory_order_relaxed);
+        if (tail - this->head.load(std::memory_order_acquire) == Capacity)
+            return false;
+        this->buffer[tail & (Capacity - 1)] = item;
+        this->tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     *  @brief Pops one element. Consumer side only.
+     *  @param item Reference to write the popped element into
+     *  @return true if an element was popped, false if the ring is empty
+     */
+    bool pop(T &item)
+    {
+        size_t head = this->head.load(std::memory_order_relaxed);
+        if (head == this->tail.load(std::memory_order_acquire))
+            return false;
+        item = this->buffer[head & (Capacity - 1)];
+        this->head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     *  @brief Gives how many elements can be pushed without failing. Producer side only.
+     *  @return The free slot count
+     */
+    size_t freeSpace() const
+    {
+        return Capacity - (this->tail.load(std::memory_order_relaxed) - this->head.load(std::memory_order_acquire));
+    }
+
+    /**
+     *  @brief Checks whether there is anything to pop. Consumer side only.
+     *  @return true if the ring is empty
+     */
+    bool empty() const
+    {
+        return this->head.load(std::memory_order_relaxed) == this->tail.load(std::memory_order_acquire);
+    }
+
+    /**
+     *  @brief Gives the total capacity of the ring.
+     *  @return The capacity
+     */
+    static constexpr size_t capacity()
+    {
+        return Capacity;
+    }
+
+private:
+    // Producer and consumer indices live on separate cache lines to avoid false sharing
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+    alignas(64) std::array<T, Capacity> buffer{};
+};
+
+#endif // EVENTRING_H
@@ -6,14 +6,59 @@
 #include <thread>
 #include <atomic>
 #include <mutex>
+#include <chrono>
+#include <memory>
+#include <functional>
 #include "GamepadStatus.h"
+#include "JSEvent.h"
+#include "EventRing.h"
+#include "GamepadState.h"
+#include "Seqlock.h"
+#include "BitMask.h"
+#include "EventHistory.h"
+#include "GamepadStats.h"
+#include "EventRecorder.h"
+#include "InputSource.h"
+#include "AxisProcessor.h"
+#include "AxisCoalescer.h"
+#include "DeviceIdentity.h"
+#include "RumbleWriter.h"
+#include "StateCodec.h"
+#include "ThreadConfig.h"
 
 class Gamepad
 {
 public:
+    /**
+     *  @brief Plain function pointer invoked for a decoded event.
+     *  @param context The context pointer given at registration
+     *  @param event The decoded event, with the INIT bit still set for init events
+     */
+    using EventHandler = void (*)(void *context, const JSEvent &event);
+
+    /**
+     *  @brief Upper bound on the number of events drained by a single read() call.
+     */
+    static constexpr size_t MAX_BATCH_SIZE = 128;
+
+    /**
+     *  @brief Number of events the background reader can queue ahead of the consumer.
+     */
+    static constexpr size_t READER_RING_SIZE = 1024;
+
+    /**
+     *  @brief Number of past events kept when history is enabled.
+     */
+    static constexpr size_t HISTORY_SIZE = 1024;
+
+    /**
+     *  @brief Most events staged for one frame, a larger report is committed in pieces.
+     */
+    static constexpr size_t MAX_FRAME_EVENTS = GamepadState::MAX_AXES + GamepadState::MAX_BUTTONS + 1;
+
     /**
      *  @brief Initializes a Gamepad object.
-     *  @param path The path to the 'jsX' input file stream as a string
+     *  @param path The path to the 'jsX' or 'eventX' input file stream as a string
      *  @return The created Gamepad object
      */
     Gamepad(const std::string &path);
@@ -30,13 +75,128 @@ public:
      */
     ~Gamepad();
 
+    Gamepad(const Gamepad &) = delete;
+    Gamepad &operator=(const Gamepad &) = delete;
+
+    /**
+     *  @brief Takes over the open device, cached state and threads of another Gamepad.
+     *  @param other The Gamepad to move from, left closed
+     *  @return The created Gamepad object
+     *  @details The fd changes hands without being reopened, so no init events are replayed.
+     *  @details A running reader or reconnection is restarted on the new object. Must be called
+     *  @details from other's consumer thread. Pointers to other (e.g. in a GamepadManager) are
+     *  @details not updated.
+     */
+    Gamepad(Gamepad &&other);
+
+    /**
+     *  @brief Closes this Gamepad and takes over the open device, cached state and threads of another.
+     *  @param other The Gamepad to move from, left closed
+     *  @return This Gamepad
+     *  @details Must be called from the consumer thread of both Gamepads.
+     */
+    Gamepad &operator=(Gamepad &&other);
+
     /**
      *  @brief Updates the state of the Gamepad, including errors.
      *  @details If you wish to interact with the Gamepad iteratively or periodically,
      *  @details call this before any logic.
+     *  @details While connected this takes no locks: the stream then belongs to the refreshing
+     *  @details thread, so open/close calls must not race with it from other threads.
      */
     void refresh();
 
+    /**
+     *  @brief Sleeps until the device has input or the timeout expires, then refreshes.
+     *  @param timeout Maximum time to wait, negative to wait indefinitely
+     *  @return true if the device had input ready, was reopened or held-back axis values came due, false on timeout or interruption
+     *  @details Replaces spinning on refresh(), the thread sleeps in ppoll() while idle,
+     *  @details waking early when a value held back by setAxisCoalescing() is due. While
+     *  @details disconnected it sleeps until the device is reopened.
+     */
+    bool waitForEvent(std::chrono::microseconds timeout = std::chrono::microseconds(-1));
+
+    /**
+     *  @brief Gives the file descriptor of the device stream.
+     *  @return The file descriptor, negative if the stream is closed
+     *  @details Useful for registering the device with an external poll/epoll loop.
+     */
+    int getFd();
+
+    /**
+     *  @brief Gives an eventfd signalled each time the HotplugMonitor reopens the device.
+     *  @return The file descriptor, negative if it could not be created
+     *  @details Lets an external poll/epoll loop notice a reconnection, after which getFd()
+     *  @details is a new descriptor. Read it to clear it. Not for use while the reader runs,
+     *  @details which consumes it itself.
+     */
+    int getReconnectFd();
+
+    /**
+     *  @brief Gives an eventfd the background reader signals after queueing events.
+     *  @return The file descriptor, negative if it could not be created
+     *  @details Lets an external poll/epoll loop sleep while the reader owns the device fd.
+     *  @details Read it to clear it before calling refresh(). The reader only signals it once
+     *  @details this was called.
+     */
+    int getReadyFd();
+
+    /**
+     *  @brief Starts the background reader thread.
+     *  @details The reader drains the fd into a lock-free ring of TimedEvents and starts
+     *  @details reconnection on errors. refresh() and popEvent() then only pop from the ring,
+     *  @details with no syscalls or locks. Only one consumer thread may call them.
+     *  @return 0 on success, -1 with errno set if the setThreadConfig() options could not be applied, the reader still runs then
+     */
+    int startReader();
+
+    /**
+     *  @brief Stops the background reader thread and applies any events still queued.
+     *  @details Must be called from the consumer thread.
+     */
+    void stopReader();
+
+    /**
+     *  @brief Sets the CPU affinity, priority and memory locking of the background reader.
+     *  @param config The options, applied right away to a running reader and to later ones
+     *  @return 0 on success, -1 on failure with errno set, e.g. EPERM without CAP_SYS_NICE
+     *  @details Reconnection runs on the shared HotplugMonitor thread, configure it there.
+     */
+    int setThreadConfig(const ThreadConfig &config);
+
+    /**
+     *  @brief Allocates everything the hot path may need up front.
+     *  @details Creates the reader ring and wake eventfd and the history buffer (recording
+     *  @details stays off), so startReader() and enableHistory() won't allocate or fault
+     *  @details later. Combine with ThreadConfig::lockMemory to keep the pages resident.
+     */
+    void preallocate();
+
+    /**
+     *  @brief Checks whether the background reader thread is running.
+     *  @return true if the reader is active
+     */
+    bool isReaderActive();
+
+    /**
+     *  @brief Checks whether the Gamepad waits for its device node to reappear.
+     *  @return true while reconnecting, getReconnectFd() is signalled once it is reopened
+     */
+    bool isReconnecting();
+
+    /**
+     *  @brief Pops the oldest queued event from the background reader and applies it.
+     *  @param event Reference to write the popped event into
+     *  @return true if an event was popped, false if none are queued or the reader is inactive
+     */
+    bool popEvent(TimedEvent &event);
+
+    /**
+     *  @brief Gives the source timestamp of the newest event applied so far.
+     *  @return The time in microseconds, full precision for evdev nodes, 0 before any event
+     */
+    uint64_t getLastEventTimeUs();
+
     /**
      *  @brief Gives the most up-to-date value of the given axis.
      *  @param index The index of the desired axis
@@ -51,6 +211,278 @@ public:
      */
     short getButton(int index);
 
+    /**
+     *  @brief Gives the calibrated value of the given axis.
+     *  @param index The index of the desired axis
+     *  @return The value in [-1, 1], the raw value scaled by 1/32767 if no calibration is set
+     */
+    float getAxisValue(int index);
+
+    /**
+     *  @brief Sets the deadzone, range and response of one axis, enabling axis processing.
+     *  @param index The index of the axis
+     *  @param calibration The calibration
+     *  @return 0 on success, -1 if the index is out of range
+     *  @details Changed axes are recomputed once per refresh(), four at a time with SSE2/NEON.
+     *  @details Must be called from the thread calling refresh().
+     */
+    int setAxisCalibration(int index, const AxisCalibration &calibration);
+
+    /**
+     *  @brief Gives a circular deadzone to a pair of axes, enabling axis processing.
+     *  @param xIndex The index of the horizontal axis
+     *  @param yIndex The index of the vertical axis
+     *  @param deadzone Radius reported as the center, as a fraction of travel
+     *  @param saturation Radius reported as full deflection, as a fraction of travel
+     *  @return 0 on success, -1 if an index is out of range or too many pairs are set
+     */
+    int setRadialDeadzone(int xIndex, int yIndex, float deadzone, float saturation = 1.0f);
+
+    /**
+     *  @brief Drops every calibration and radial deadzone.
+     */
+    void disableAxisProcessing();
+
+    /**
+     *  @brief Collapses bursts of events on one axis, enabling coalescing.
+     *  @param index The index of the axis
+     *  @param options The rate limit and hysteresis threshold
+     *  @return 0 on success, -1 if the index is out of range
+     *  @details Superseded events never reach the state, handlers, history or recording.
+     *  @details Held-back values are applied by a later refresh(). waitForEvent(), GamepadManager,
+     *  @details GamepadPool and GamepadAsync wake up for them, loops of your own can wait for at most
+     *  @details getHeldDueNs(). popEvent() and the events applied by stopReader() are not coalesced.
+     */
+    int setAxisCoalescing(int index, const AxisCoalescing &options);
+
+    /**
+     *  @brief Collapses bursts of events on every axis, enabling coalescing.
+     *  @param options The rate limit and hysteresis threshold
+     */
+    void setAxisCoalescing(const AxisCoalescing &options);
+
+    /**
+     *  @brief Applies every axis event again, held-back values are dropped.
+     */
+    void disableAxisCoalescing();
+
+    /**
+     *  @brief Gives how long until refresh() has held-back axis values to apply without new input.
+     *  @return Nanoseconds until the earliest one is due, 0 if one is due now, -1 if none is held
+     *  @details An fd only signals new input, so a loop sleeping on it alone would keep the final
+     *  @details value of a burst held back. Call from the refreshing thread.
+     */
+    int64_t getHeldDueNs();
+
+    /**
+     *  @brief Gives a consistent copy of all axes and buttons as of the last refresh().
+     *  @return The published GamepadState
+     *  @details Safe to call from any number of threads concurrently with refresh(),
+     *  @details never blocks the refreshing thread and never returns a torn state.
+     */
+    GamepadState snapshot() const;
+
+    /**
+     *  @brief Gives how many times refresh() published a new state.
+     *  @return The publication count, changes whenever snapshot() may return something new
+     *  @details Safe to call from any thread, lets consumers skip copying an unchanged state.
+     */
+    uint32_t getStateVersion() const;
+
+    /**
+     *  @brief Checks whether the button went from released to pressed during the last refresh().
+     *  @param index The index of the button
+     *  @return true if pressed since the previous refresh()
+     */
+    bool wasPressed(int index);
+
+    /**
+     *  @brief Checks whether the button went from pressed to released during the last refresh().
+     *  @param index The index of the button
+     *  @return true if released since the previous refresh()
+     */
+    bool wasReleased(int index);
+
+    /**
+     *  @brief Gives the axes whose value changed during the last refresh().
+     *  @return A mask that can be iterated for the changed indices
+     */
+    const BitMask<GamepadState::MAX_AXES> &changedAxes();
+
+    /**
+     *  @brief Gives the buttons whose value changed during the last refresh().
+     *  @return A mask that can be iterated for the changed indices
+     */
+    const BitMask<GamepadState::MAX_BUTTONS> &changedButtons();
+
+    /**
+     *  @brief Encodes what the last refresh() changed into a packet for a remote StateDecoder.
+     *  @param encoder The encoder paired with the remote decoder
+     *  @param out Buffer of at least StatePacket::MAX_SIZE bytes
+     *  @return The packet size, 0 if nothing changed
+     *  @details Only the changed controls are compared, so call it after every refresh().
+     */
+    size_t encodeChanges(StateEncoder &encoder, uint8_t *out);
+
+    /**
+     *  @brief Starts recording every applied event into a fixed-size history.
+     *  @details The history buffer is allocated once, on first use.
+     */
+    void enableHistory();
+
+    /**
+     *  @brief Stops recording events. The recorded history is kept.
+     */
+    void disableHistory();
+
+    /**
+     *  @brief Gives the recorded event history for latency and timing queries.
+     *  @return The history, nullptr if it was never enabled
+     */
+    const EventHistory<HISTORY_SIZE> *getHistory();
+
+    /**
+     *  @brief Registers the handler for one button, replacing any previous one.
+     *  @param index The index of the button
+     *  @param handler The handler, nullptr to remove
+     *  @param context Passed back to the handler
+     *  @details Handlers run on the thread calling refresh() as each event is applied.
+     */
+    void onButton(int index, EventHandler handler, void *context = nullptr);
+
+    /**
+     *  @brief Registers the handler for one axis, replacing any previous one.
+     *  @param index The index of the axis
+     *  @param handler The handler, nullptr to remove
+     *  @param context Passed back to the handler
+     */
+    void onAxis(int index, EventHandler handler, void *context = nullptr);
+
+    /**
+     *  @brief Registers the handler for every button and axis event, replacing any previous one.
+     *  @param handler The handler, nullptr to remove
+     *  @param context Passed back to the handler
+     */
+    void onAny(EventHandler handler, void *context = nullptr);
+
+    /**
+     *  @brief Registers the handler called once per committed frame, replacing any previous one.
+     *  @param handler The handler, nullptr to remove
+     *  @param context Passed back to the handler
+     *  @details Receives the frame's last event (its EVENT_SYNC for evdev) after the whole frame
+     *  @details was applied. Only called while frame coherent updates are enabled.
+     */
+    void onFrame(EventHandler handler, void *context = nullptr);
+
+    /**
+     *  @brief Registers a handler for every applied button and axis event, apart from onAny().
+     *  @param handler The handler, nullptr to remove
+     *  @param context Passed back to the handler
+     *  @details For adapters such as GamepadAsync, which then leave the user's handlers alone.
+     */
+    void setEventTap(EventHandler handler, void *context = nullptr);
+
+    /**
+     *  @brief Registers a callable for one button without copying it.
+     *  @param index The index of the button
+     *  @param callable Invoked as callable(event), must outlive the registration
+     */
+    template <typename F>
+    void onButton(int index, F &callable)
+    {
+        this->onButton(index, &Gamepad::invoke<F>, &callable);
+    }
+
+    /**
+     *  @brief Registers a callable for one axis without copying it.
+     *  @param index The index of the axis
+     *  @param callable Invoked as callable(event), must outlive the registration
+     */
+    template <typename F>
+    void onAxis(int index, F &callable)
+    {
+        this->onAxis(index, &Gamepad::invoke<F>, &callable);
+    }
+
+    /**
+     *  @brief Registers a callable for every event without copying it.
+     *  @param callable Invoked as callable(event), must outlive the registration
+     */
+    template <typename F>
+    void onAny(F &callable)
+    {
+        this->onAny(&Gamepad::invoke<F>, &callable);
+    }
+
+    /**
+     *  @brief Registers a callable for every committed frame without copying it.
+     *  @param callable Invoked as callable(event), must outlive the registration
+     */
+    template <typename F>
+    void onFrame(F &callable)
+    {
+        this->onFrame(&Gamepad::invoke<F>, &callable);
+    }
+
+    /**
+     *  @brief Applies whole hardware reports at once instead of one event at a time.
+     *  @param enabled true to stage events until their frame is complete
+     *  @details A frame ends at each EVENT_SYNC for sources that report boundaries (evdev), and
+     *  @details at the end of every refresh() otherwise. getAxis(), snapshot() and the change masks
+     *  @details then never mix two reports. Must be called from the thread calling refresh().
+     */
+    void setFrameCoherent(bool enabled);
+
+    /**
+     *  @brief Checks whether frame coherent updates are enabled.
+     *  @return true if enabled
+     */
+    bool isFrameCoherent();
+
+    /**
+     *  @brief Gives the number of axes reported by the device (JSIOCGAXES).
+     *  @return The axis count
+     */
+    int getAxisCount();
+
+    /**
+     *  @brief Gives the number of buttons reported by the device (JSIOCGBUTTONS).
+     *  @return The button count
+     */
+    int getButtonCount();
+
+    /**
+     *  @brief Sets how many events refresh() requests per read() call.
+     *  @param size The batch size, clamped to [1, MAX_BATCH_SIZE]
+     */
+    void setBatchSize(size_t size);
+
+    /**
+     *  @brief Gets how many events refresh() requests per read() call.
+     *  @return The current batch size
+     */
+    size_t getBatchSize();
+
+    /**
+     *  @brief Checks whether the cached state reflects the device since it was last (re)opened.
+     *  @return true once the kernel's initial state events have been applied
+     */
+    bool isPrimed();
+
+    /**
+     *  @brief Sets a callback invoked once the state is primed after each open or reconnect.
+     *  @param callback The callback, called from the thread running refresh()
+     *  @details If the state is primed already, e.g. by the constructor's refresh(), it is also
+     *  @details invoked right away, so call this from that same thread.
+     */
+    void setPrimedCallback(std::function<void(Gamepad &)> callback);
+
+    /**
+     *  @brief Gives a copy of the hot-path counters, safe to call from any thread.
+     *  @return The current GamepadStats, all zero when built with GAMEPAD_ENABLE_STATS=0
+     */
+    GamepadStats getStats() const;
+
     /**
      *  @brief Gets current status of Gamepad.
      *  @returns Current GamepadStatus enum value
@@ -64,7 +496,7 @@ public:
     bool getErr();
 
     /**
-     *  @brief Opens the stream of a given path to a 'jsX' file.
+     *  @brief Opens the stream of a given path to a 'jsX' or 'eventX' file.
      *  @param path The path to the file as a string
      *  @return The file descriptor of the stream
      *  @details If the operation was successful, return positive integer
@@ -72,21 +504,273 @@ public:
      */
     int openStream(const std::string &path);
 
+    /**
+     *  @brief Replaces the device with a recording made by startRecording().
+     *  @param path The path to the recording file
+     *  @param realtime true to deliver events with their original spacing, false for as fast as possible
+     *  @return 0 on success, -1 on failure with errno set
+     *  @details Events then flow through refresh() exactly as if read from the device.
+     *  @details Calling openStream() switches back to a device.
+     */
+    int openReplay(const std::string &path, bool realtime = true);
+
+    /**
+     *  @brief Replaces the device with an in-memory buffer of events.
+     *  @param events Pointer to the first event, copied
+     *  @param count The number of events
+     *  @param axisCount Axes the simulated device reports
+     *  @param buttonCount Buttons the simulated device reports
+     *  @details Calling openStream() switches back to a device.
+     */
+    void openMemory(const JSEvent *events, size_t count, uint16_t axisCount, uint16_t buttonCount);
+
+    /**
+     *  @brief Checks whether an open replay or memory buffer has delivered all of its events.
+     *  @return true if one is open and finished
+     */
+    bool isReplayFinished();
+
+    /**
+     *  @brief Gives the kind of source events are currently read from.
+     *  @return The InputSourceType
+     */
+    InputSourceType getSourceType();
+
+    /**
+     *  @brief Gives the identity of the controller, cached when the stream was first opened.
+     *  @return The DeviceIdentity, invalid for pipes, files and replays
+     *  @details Reconnection reopens the controller through identity.stablePath when there is
+     *  @details one, and never adopts a node whose identity differs.
+     */
+    DeviceIdentity getIdentity();
+
+    /**
+     *  @brief Opens the controller's evdev node for force feedback and starts the rumble writer.
+     *  @return 0 on success, -1 on failure with errno set
+     *  @details All rumble calls below only queue work for the writer thread, they never block
+     *  @details on the device. Rapid updates are coalesced so only the latest one is written.
+     */
+    int enableRumble();
+
+    /**
+     *  @brief Stops the rumble writer, the kernel stops and erases its effects.
+     */
+    void disableRumble();
+
+    /**
+     *  @brief Sets the rumble motors, replacing the previous magnitude.
+     *  @param strong Low frequency motor in [0, 1]
+     *  @param weak High frequency motor in [0, 1]
+     *  @param duration How long to play, 0 to play until changed or stopped
+     */
+    void setRumble(float strong, float weak, std::chrono::milliseconds duration = std::chrono::milliseconds(0));
+
+    /**
+     *  @brief Stops the rumble motors.
+     */
+    void stopRumble();
+
+    /**
+     *  @brief Queues a force feedback effect for upload.
+     *  @param effect The effect, its id is ignored
+     *  @return A handle for the calls below, -1 if rumble is disabled or all slots are in use
+     */
+    int uploadEffect(const struct ff_effect &effect);
+
+    /**
+     *  @brief Queues a replacement for an uploaded effect.
+     *  @param handle The handle given by uploadEffect()
+     *  @param effect The new effect
+     */
+    void updateEffect(int handle, const struct ff_effect &effect);
+
+    /**
+     *  @brief Queues playback of an uploaded effect.
+     *  @param handle The handle given by uploadEffect()
+     *  @param count Number of repetitions
+     */
+    void playEffect(int handle, int count = 1);
+
+    /**
+     *  @brief Queues stopping an uploaded effect.
+     *  @param handle The handle given by uploadEffect()
+     */
+    void stopEffect(int handle);
+
+    /**
+     *  @brief Queues removal of an uploaded effect, freeing its handle.
+     *  @param handle The handle given by uploadEffect()
+     */
+    void eraseEffect(int handle);
+
+    /**
+     *  @brief Starts appending every event read from the device to a recording file.
+     *  @param path The path to the recording file, truncated if it exists
+     *  @return 0 on success, -1 on failure with errno set
+     *  @details Events are buffered and written in large blocks by a writer thread, refresh() only
+     *  @details waits for the disk if it falls several blocks behind.
+     *  @details Events are recorded as applied, axis events dropped by setAxisCoalescing() are not.
+     */
+    int startRecording(const std::string &path);
+
+    /**
+     *  @brief Flushes and closes the recording file.
+     */
+    void stopRecording();
+
     /**
      *  @brief Closes the file stream. Sets device to error state.
      *  @return The output of the close() system call
      */
     int closeStream();
 
+protected:
+    /**
+     *  @brief Gives the cached state without bounds checks, for layout-aware accessors.
+     *  @return The state as of the last refresh(), only valid on the refreshing thread
+     */
+    const GamepadState &cachedState() const
+    {
+        return this->state;
+    }
+
+    /**
+     *  @brief Gives the buttons pressed during the last refresh().
+     *  @return The press mask
+     */
+    const BitMask<GamepadState::MAX_BUTTONS> &pressedButtons() const
+    {
+        return this->buttonPresses;
+    }
+
+    /**
+     *  @brief Gives the buttons released during the last refresh().
+     *  @return The release mask
+     */
+    const BitMask<GamepadState::MAX_BUTTONS> &releasedButtons() const
+    {
+        return this->buttonReleases;
+    }
+
 private:
+    struct HandlerSlot
+    {
+        EventHandler handler;
+        void *context;
+    };
+
     std::string path;
-    int fd;
+    InputSource source;
+    DeviceIdentity identity;
     std::mutex fdMutex;
     std::atomic<bool> reconnecting;
-    std::thread reconnectionThread;
-    GamepadStatus status;
-    std::array<short, 6> axes{};
-    std::array<short, 15> buttons{};
+    std::atomic<GamepadStatus> status;
+    GamepadState state;
+    Seqlock<GamepadState> published;
+    BitMask<GamepadState::MAX_AXES> axisChanges;
+    BitMask<GamepadState::MAX_BUTTONS> buttonChanges;
+    BitMask<GamepadState::MAX_BUTTONS> buttonPresses;
+    BitMask<GamepadState::MAX_BUTTONS> buttonReleases;
+    std::array<HandlerSlot, GamepadState::MAX_AXES> axisHandlers{};
+    std::array<HandlerSlot, GamepadState::MAX_BUTTONS> buttonHandlers{};
+    HandlerSlot anyHandler{};
+    HandlerSlot frameHandler{};
+    HandlerSlot tapHandler{};
+    bool frameCoherent = false;
+    bool sourceFramed = false;
+    size_t frameSize = 0;
+    std::array<JSEvent, MAX_FRAME_EVENTS> frameEvents{};
+    std::unique_ptr<EventHistory<HISTORY_SIZE>> history;
+    bool recordHistory = false;
+    GamepadCounters counters;
+    std::unique_ptr<EventRecorder> recorder;
+    std::unique_ptr<AxisProcessor> processor;
+    std::unique_ptr<AxisCoalescer> coalescer;
+    std::unique_ptr<RumbleWriter> rumble;
+    std::atomic<uint32_t> openGeneration;
+    std::atomic<uint32_t> openedCounts;
+    uint32_t appliedGeneration;
+    bool primed;
+    uint32_t initEvents;
+    uint64_t lastEventUs;
+    std::function<void(Gamepad &)> primedCallback;
+    size_t batchSize = 64;
+    std::array<JSEvent, MAX_BATCH_SIZE> eventBuffer{};
+    std::atomic<bool> readerActive;
+    std::thread readerThread;
+    int readerWakeFd;
+    // Created by the consumer while the reader may run, hence atomic
+    std::atomic<int> readerReadyFd;
+    std::unique_ptr<EventRing<TimedEvent, READER_RING_SIZE>> ring;
+    ThreadConfig threadConfig;
+
+    /**
+     *  @brief Trampoline from EventHandler to a registered callable.
+     */
+    template <typename F>
+    static void invoke(void *context, const JSEvent &event)
+    {
+        (*static_cast<F *>(context))(event);
+    }
+
+    /**
+     *  @brief Resets the per-refresh change masks.
+     */
+    void clearChanges();
+
+    /**
+     *  @brief Picks up axis/button counts after the stream was (re)opened.
+     *  @return true if the device was reopened since the last call
+     */
+    bool syncOpened();
+
+    /**
+     *  @brief Applies a single decoded event to the cached state.
+     *  @param event The event to apply
+     */
+    void applyEvent(const JSEvent &event);
+
+    /**
+     *  @brief Applies a batch of decoded events to the cached state.
+     *  @param events Pointer to the first event
+     *  @param count The number of events to apply
+     */
+    void applyEvents(const JSEvent *events, size_t count);
+
+    /**
+     *  @brief Coalesces the first events of eventBuffer and applies what is left.
+     *  @param count The number of events in eventBuffer
+     *  @param nowNs CLOCK_MONOTONIC time of the refresh
+     */
+    void applyCoalesced(size_t count, uint64_t nowNs);
+
+    /**
+     *  @brief Applies the held-back axis values that are due.
+     *  @param nowNs CLOCK_MONOTONIC time of the refresh
+     *  @return true if any value was applied
+     */
+    bool flushCoalesced(uint64_t nowNs);
+
+    /**
+     *  @brief Applies the staged frame to the cached state and notifies the frame handler.
+     */
+    void commitFrame();
+
+    /**
+     *  @brief Commits a partial frame at the end of a batch, for sources without report boundaries.
+     */
+    void endBatch();
+
+    /**
+     *  @brief Publishes the cached state for snapshot() readers.
+     */
+    void publishState();
+
+    /**
+     *  @brief Invokes the primed callback if the state just became primed.
+     *  @param wasPrimed Whether the state was primed before the update
+     */
+    void notifyPrimed(bool wasPrimed);
 
     /**
      *  @brief Updates the status based on the current 'errno' status,
@@ -101,14 +785,26 @@ private:
     int reconnect();
 
     /**
-     *  @brief Asynchronously attempt reconnection every ~250ms.
+     *  @brief Gives the path reconnection should reopen.
+     *  @return The cached by-id link if there is one, the opened path otherwise
+     */
+    std::string reconnectPath();
+
+    /**
+     *  @brief Asynchronously reconnect as soon as the device node reappears.
+     *  @details Registers with the shared HotplugMonitor, no thread is spawned per device.
+     */
+    void startReconnection();
+
+    /**
+     *  @brief Stop waiting for the device node to reappear.
      */
-    void startReconnectionThread();
+    void stopReconnection();
 
     /**
-     *  @brief Stop reconnection thread.
+     *  @brief Body of the background reader thread.
      */
-    void stopReconnectionThread();
+    void readerLoop();
 
     /**
      *  @brief Provides a safe mutex lock around the read syscall.
@@ -118,6 +814,14 @@ private:
      */
     ssize_t safeRead(void *buf, size_t size);
 
+    /**
+     *  @brief Reads from the source without fdMutex, for refresh() while not reconnecting.
+     *  @param buf A reference to a buffer to read into
+     *  @param size The size of the buffer / how many bytes to read
+     *  @return The amount of bytes read as a ssize_t
+     */
+    ssize_t ownedRead(void *buf, size_t size);
+
     /**
      *  @brief Provides a safe mutex lock around the open syscall while closing already open file descriptors.
      *  @param path A string of the file path to the device
@@ -130,6 +834,18 @@ private:
      *  @return An int representing the outcome of close()
      */
     int safeClose();
+
+    /**
+     *  @brief Moves everything from other into this Gamepad, which must have nothing open.
+     *  @param other The Gamepad to move from, left closed
+     */
+    void moveFrom(Gamepad &other);
+
+    /**
+     *  @brief Hands the source's axis/button counts to the refreshing thread.
+     *  @details Must be called with fdMutex held, right after the source was (re)opened.
+     */
+    void announceOpened();
 };
 
 #endif // GAMEPAD_H
\ No newline at end of file
@@ -0,0 +1,233 @@
+#ifndef GAMEPADASYNC_H
+#define GAMEPADASYNC_H
+
+// Coroutine support is optional, the rest of the library stays C++17
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#define GAMEPAD_HAS_COROUTINES 1
+
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <vector>
+#include "Gamepad.h"
+#include "JSEvent.h"
+
+/**
+ *  @brief Awaitable operations on a Gamepad for C++20 coroutines, driven by an external executor.
+ *  @details The executor watches getFd() for readability, a single epoll descriptor that
+ *  @details stays valid across reconnections, and calls dispatch() when it fires. dispatch()
+ *  @details refreshes the Gamepad and resumes the coroutines waiting on each event, inline and
+ *  @details in order. No thread is spawned: reconnection stays with the shared HotplugMonitor.
+ *  @details Owned by the executor's thread, the Gamepad must not be refreshed elsewhere and
+ *  @details must not run its background reader.
+ */
+class GamepadAsync
+{
+public:
+    class EventAwaiter;
+    class ConnectedAwaiter;
+
+    /**
+     *  @brief Initializes a GamepadAsync for a Gamepad.
+     *  @param gamepad The Gamepad, must outlive this object
+     *  @return The created GamepadAsync object, check getFd() for failure
+     *  @details Takes the Gamepad's event tap, where dispatch() collects the applied events.
+     */
+    GamepadAsync(Gamepad &gamepad);
+
+    /**
+     *  @brief Destructor for GamepadAsync object, releases the event tap and closes the epoll and timer descriptors
+     *  @details Suspended coroutines are not resumed, destroy them first.
+     */
+    ~GamepadAsync();
+
+    GamepadAsync(const GamepadAsync &) = delete;
+    GamepadAsync &operator=(const GamepadAsync &) = delete;
+
+    /**
+     *  @brief Gives the descriptor for the executor to watch.
+     *  @return An epoll fd readable whenever dispatch() has work, negative on failure
+     */
+    int getFd();
+
+    /**
+     *  @brief Refreshes the Gamepad and resumes the coroutines its events complete.
+     *  @return The number of coroutines resumed
+     *  @details Call when getFd() is readable; spurious calls are harmless.
+     */
+    size_t dispatch();
+
+    /**
+     *  @brief Waits on getFd() and dispatches, for callers without an executor.
+     *  @param timeout Maximum time to wait, negative to wait indefinitely
+     *  @return The number of coroutines resumed, -1 on error with errno set
+     */
+    int poll(std::chrono::milliseconds timeout = std::chrono::milliseconds(-1));
+
+    /**
+     *  @brief Awaits the next event, axis or button.
+     *  @return Awaitable resuming with the event, init events included
+     */
+    EventAwaiter nextEvent();
+
+    /**
+     *  @brief Awaits the next event of one control.
+     *  @param type EVENT_BUTTON or EVENT_AXIS, init events are included
+     *  @param number The index of the button or axis
+     *  @return Awaitable resuming with the event
+     */
+    EventAwaiter nextEvent(uint8_t type, uint8_t number);
+
+    /**
+     *  @brief Awaits the next press of a button, ignoring its init event.
+     *  @param index The index of the button
+     *  @return Awaitable resuming with the press event
+     */
+    EventAwaiter buttonPressed(uint8_t index);
+
+    /**
+     *  @brief Awaits the next release of a button, ignoring its init event.
+     *  @param index The index of the button
+     *  @return Awaitable resuming with the release event
+     */
+    EventAwaiter buttonReleased(uint8_t index);
+
+    /**
+     *  @brief Awaits the device being connected, completes right away if it is.
+     *  @return Awaitable resuming once the stream is open without error
+     */
+    ConnectedAwaiter reconnected();
+
+    /**
+     *  @brief Suspension state of a coroutine waiting for an event, kept in its frame.
+     */
+    class EventAwaiter
+    {
+    public:
+        EventAwaiter(GamepadAsync &owner, uint8_t type, int number, int edge);
+        ~EventAwaiter();
+        EventAwaiter(const EventAwaiter &) = delete;
+        EventAwaiter &operator=(const EventAwaiter &) = delete;
+
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle);
+
+        JSEvent await_resume() const noexcept
+        {
+            return this->event;
+        }
+
+    private:
+        friend class GamepadAsync;
+
+        GamepadAsync &owner;
+        std::coroutine_handle<> handle;
+        EventAwaiter *next;
+        bool queued;
+        uint8_t type;      /* 0 for any event */
+        int number;        /* -1 for any control */
+        int edge;          /* -1 any value, 0 releases, 1 presses */
+        JSEvent event;
+
+        /**
+         *  @brief Checks whether an event completes this wait.
+         *  @param event The applied event
+         *  @return true if it matches the filter
+         */
+        bool matches(const JSEvent &event) const;
+    };
+
+    /**
+     *  @brief Suspension state of a coroutine waiting for the device, kept in its frame.
+     */
+    class ConnectedAwaiter
+    {
+    public:
+        ConnectedAwaiter(GamepadAsync &owner);
+        ~ConnectedAwaiter();
+        ConnectedAwaiter(const ConnectedAwaiter &) = delete;
+        ConnectedAwaiter &operator=(const ConnectedAwaiter &) = delete;
+
+        bool await_ready() const;
+
+        void await_suspend(std::coroutine_handle<> handle);
+
+        void await_resume() const noexcept
+        {
+        }
+
+    private:
+        friend class GamepadAsync;
+
+        GamepadAsync &owner;
+        std::coroutine_handle<> handle;
+        ConnectedAwaiter *next;
+        bool queued;
+    };
+
+private:
+    Gamepad &gamepad;
+    int epollFd;
+    int reconnectFd;
+    int deviceFd;
+    // timerfd firing when the Gamepad's held-back axis values are due
+    int heldFd;
+    // Events applied since the last dispatch(), grows to the largest refresh once
+    std::vector<JSEvent> applied;
+    // Intrusive FIFO lists of suspended coroutines, the nodes live in their frames
+    EventAwaiter *eventHead;
+    EventAwaiter *eventTail;
+    ConnectedAwaiter *connectedHead;
+
+    /**
+     *  @brief Checks whether the Gamepad has an open stream without error.
+     *  @return true if connected
+     */
+    bool connected();
+
+    /**
+     *  @brief Moves the epoll registration to the Gamepad's current device fd.
+     *  @param force Register again even if the fd number is unchanged, after a reopen
+     *  @details A failed device is left out until it reconnects, its hung-up fd would
+     *  @details otherwise keep the epoll fd readable.
+     */
+    void trackDevice(bool force);
+
+    /**
+     *  @brief Arms the held-back value timer for the Gamepad's next due value, or disarms it.
+     */
+    void armHeld();
+
+    /**
+     *  @brief Resumes the coroutines waiting for an event it matches.
+     *  @param event The applied event
+     *  @return The number of coroutines resumed
+     */
+    size_t resumeEvent(const JSEvent &event);
+
+    /**
+     *  @brief Resumes the coroutines waiting for the device.
+     *  @return The number of coroutines resumed
+     */
+    size_t resumeConnected();
+
+    /**
+     *  @brief Removes a wait from the event list.
+     *  @param awaiter The wait, must be queued
+     */
+    void unlink(EventAwaiter *awaiter);
+
+    /**
+     *  @brief Removes a wait from the connection list.
+     *  @param awaiter The wait, must be queued
+     */
+    void unlink(ConnectedAwaiter *awaiter);
+};
+
+#endif // coroutines
+
+#endif // GAMEPADASYNC_H
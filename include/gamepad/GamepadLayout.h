@@ -0,0 +1,131 @@
+#ifndef GAMEPADLAYOUT_H
+#define GAMEPADLAYOUT_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "GamepadState.h"
+
+/**
+ *  @brief Layouts describe a controller model for BasicGamepad.
+ *  @details A layout declares AXES and BUTTONS counts, Axis and Button enums giving the joydev
+ *  @details index of each control, and AXIS_NAMES / BUTTON_NAMES in index order.
+ */
+
+/**
+ *  @brief Xbox 360 / One / Series pads as numbered by the xpad driver.
+ */
+struct XboxLayout
+{
+    static constexpr size_t AXES = 8;
+    static constexpr size_t BUTTONS = 11;
+
+    enum class Axis : uint8_t
+    {
+        LEFT_X,
+        LEFT_Y,
+        LEFT_TRIGGER,
+        RIGHT_X,
+        RIGHT_Y,
+        RIGHT_TRIGGER,
+        DPAD_X,
+        DPAD_Y
+    };
+
+    enum class Button : uint8_t
+    {
+        A,
+        B,
+        X,
+        Y,
+        LB,
+        RB,
+        BACK,
+        START,
+        GUIDE,
+        LEFT_STICK,
+        RIGHT_STICK
+    };
+
+    static constexpr std::array<const char *, AXES> AXIS_NAMES{
+        "LX", "LY", "LT", "RX", "RY", "RT", "DPadX", "DPadY"};
+    static constexpr std::array<const char *, BUTTONS> BUTTON_NAMES{
+        "A", "B", "X", "Y", "LB", "RB", "Back", "Start", "Guide", "LS", "RS"};
+};
+
+/**
+ *  @brief DualShock 4 and DualSense pads as numbered by hid-sony / hid-playstation.
+ */
+struct DualShockLayout
+{
+    static constexpr size_t AXES = 8;
+    static constexpr size_t BUTTONS = 13;
+
+    enum class Axis : uint8_t
+    {
+        LEFT_X,
+        LEFT_Y,
+        L2,
+        RIGHT_X,
+        RIGHT_Y,
+        R2,
+        DPAD_X,
+        DPAD_Y
+    };
+
+    enum class Button : uint8_t
+    {
+        CROSS,
+        CIRCLE,
+        TRIANGLE,
+        SQUARE,
+        L1,
+        R1,
+        L2,
+        R2,
+        SHARE,
+        OPTIONS,
+        PS,
+        L3,
+        R3
+    };
+
+    static constexpr std::array<const char *, AXES> AXIS_NAMES{
+        "LX", "LY", "L2", "RX", "RY", "R2", "DPadX", "DPadY"};
+    static constexpr std::array<const char *, BUTTONS> BUTTON_NAMES{
+        "Cross", "Circle", "Triangle", "Square", "L1", "R1", "L2", "R2", "Share", "Options", "PS", "L3", "R3"};
+};
+
+/**
+ *  @brief Unknown devices, every index joydev can report and no names.
+ *  @details Controls are addressed by number, e.g. get<DynamicLayout::Button(7)>(), or through
+ *  @details the runtime-checked Gamepad accessors.
+ */
+struct DynamicLayout
+{
+    static constexpr size_t AXES = GamepadState::MAX_AXES;
+    static constexpr size_t BUTTONS = GamepadState::MAX_BUTTONS;
+
+    enum class Axis : uint8_t
+    {
+    };
+
+    enum class Button : uint8_t
+    {
+    };
+
+    static constexpr std::array<const char *, 0> AXIS_NAMES{};
+    static constexpr std::array<const char *, 0> BUTTON_NAMES{};
+};
+
+/**
+ *  @brief Copy of the state sized exactly for one layout.
+ */
+template <typename Layout>
+struct LayoutState
+{
+    std::array<short, Layout::AXES> axes{};
+    std::array<short, Layout::BUTTONS> buttons{};
+};
+
+#endif // GAMEPADLAYOUT_H
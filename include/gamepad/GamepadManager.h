@@ -0,0 +1,162 @@
+#ifndef GAMEPADMANAGER_H
+#define GAMEPADMANAGER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <functional>
+#include <utility>
+#include "Gamepad.h"
+#include "ThreadConfig.h"
+
+class GamepadManager
+{
+public:
+    /**
+     *  @brief Callback invoked when a device's status, axes or buttons changed.
+     *  @param id The id returned by add()
+     *  @param gamepad The device that changed
+     *  @details Runs without the manager's lock held, so it may call get(), size(), add() and setCallback().
+     */
+    using ChangeCallback = std::function<void(size_t id, Gamepad &gamepad)>;
+
+    /**
+     *  @brief Initializes a GamepadManager with an empty epoll set.
+     *  @return The created GamepadManager object
+     */
+    GamepadManager();
+
+    /**
+     *  @brief Destructor for GamepadManager object, stops the reactor and releases owned devices
+     */
+    ~GamepadManager();
+
+    GamepadManager(const GamepadManager &) = delete;
+    GamepadManager &operator=(const GamepadManager &) = delete;
+
+    /**
+     *  @brief Registers an existing Gamepad. The manager does not take ownership.
+     *  @param gamepad The Gamepad to register, must outlive the manager
+     *  @return The id of the device within the manager
+     */
+    size_t add(Gamepad &gamepad);
+
+    /**
+     *  @brief Creates and registers a Gamepad owned by the manager.
+     *  @param path The path to the 'jsX' input file stream as a string
+     *  @return The id of the device within the manager
+     */
+    size_t add(const std::string &path);
+
+    /**
+     *  @brief Gives the device registered under the given id.
+     *  @param id The id returned by add()
+     *  @return A reference to the Gamepad
+     */
+    Gamepad &get(size_t id);
+
+    /**
+     *  @brief Gives the number of registered devices.
+     *  @return The device count
+     */
+    size_t size();
+
+    /**
+     *  @brief Sets the callback invoked on per-device state changes.
+     *  @param callback The callback, called from whichever thread runs poll()
+     */
+    void setCallback(ChangeCallback callback);
+
+    /**
+     *  @brief Waits for input on any registered device and dispatches it.
+     *  @param timeout Maximum time to wait, negative to wait indefinitely
+     *  @return The number of devices dispatched, -1 on error
+     *  @details Can be driven from the caller's own loop instead of start().
+     */
+    int poll(std::chrono::milliseconds timeout = std::chrono::milliseconds(-1));
+
+    /**
+     *  @brief Runs poll() on a single background reactor thread.
+     *  @return 0 on success, -1 with errno set if the setThreadConfig() options could not be applied, the reactor still runs then
+     */
+    int start();
+
+    /**
+     *  @brief Stops the reactor thread.
+     */
+    void stop();
+
+    /**
+     *  @brief Sets the CPU affinity, priority and memory locking of the reactor thread.
+     *  @param config The options, applied right away if the reactor runs, or by start()
+     *  @return 0 on success, -1 on failure with errno set
+     */
+    int setThreadConfig(const ThreadConfig &config);
+
+private:
+    struct Device
+    {
+        Gamepad *gamepad;
+        std::unique_ptr<Gamepad> owned;
+        int registeredFd;
+        int reconnectFd;
+        bool pending;
+        GamepadStatus lastStatus;
+        bool notify;
+    };
+
+    int epollFd;
+    int wakeFd;
+    std::vector<std::unique_ptr<Device>> devices;
+    std::mutex devicesMutex;
+    std::atomic<size_t> pendingCount;
+    std::atomic<bool> running;
+    std::thread reactorThread;
+    ThreadConfig threadConfig;
+    // Shared so poll() can keep it across the unlocked calls without copying the std::function
+    std::shared_ptr<const ChangeCallback> callback;
+    // Devices to report once poll() has released devicesMutex, only touched by the polling thread
+    std::vector<std::pair<size_t, Gamepad *>> notifications;
+
+    /**
+     *  @brief Registers a device entry and wakes the reactor to pick it up.
+     *  @param device The device entry
+     *  @return The id of the device within the manager
+     */
+    size_t addDevice(std::unique_ptr<Device> device);
+
+    /**
+     *  @brief Refreshes a ready device and queues a report if it changed.
+     *  @param id The id of the device
+     */
+    void dispatch(size_t id);
+
+    /**
+     *  @brief Queues a report if the last refresh() of a device changed its state or status.
+     *  @param id The id of the device
+     */
+    void reportChanges(size_t id);
+
+    /**
+     *  @brief Queues a device for the callback, once per poll().
+     *  @param id The id of the device
+     */
+    void queueNotification(size_t id);
+
+    /**
+     *  @brief Re-registers pending devices whose fd changed (new or reconnected).
+     */
+    void syncPending();
+
+    /**
+     *  @brief Removes a device's fd from the epoll set and marks it pending.
+     *  @param device The device entry
+     */
+    void unregister(Device &device);
+};
+
+#endif // GAMEPADMANAGER_H
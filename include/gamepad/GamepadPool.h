@@ -0,0 +1,242 @@
+#ifndef GAMEPADPOOL_H
+#define GAMEPADPOOL_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Gamepad.h"
+#include "GamepadState.h"
+#include "BitMask.h"
+
+/**
+ *  @brief Many controllers refreshed together, with their controls stored as structure of arrays.
+ *  @details Each axis is a contiguous, aligned column holding that axis for every pad, and
+ *  @details each button is a mask with one bit per pad. One poll() over all fds picks the pads
+ *  @details that need a refresh, and whole-pool questions ("did any pad press Start") or the
+ *  @details deadzone pass touch a handful of cache lines instead of every Gamepad object.
+ *  @details Not thread-safe, refresh() and the accessors belong to a single thread.
+ */
+class GamepadPool
+{
+public:
+    /**
+     *  @brief Most pads a pool can hold, one bit each in a button mask.
+     */
+    static constexpr size_t MAX_PADS = 64;
+
+    /**
+     *  @brief Number of pads processed per vector.
+     */
+    static constexpr size_t LANES = 4;
+
+    using PadMask = BitMask<MAX_PADS>;
+
+    /**
+     *  @brief Initializes an empty GamepadPool.
+     *  @return The created GamepadPool object
+     */
+    GamepadPool();
+
+    GamepadPool(const GamepadPool &) = delete;
+    GamepadPool &operator=(const GamepadPool &) = delete;
+
+    /**
+     *  @brief Opens a controller and adds it to the pool.
+     *  @param path The path to the 'jsX' or 'eventX' input file stream as a string
+     *  @return The index of the pad within the pool, -1 if the pool is full
+     */
+    int add(const std::string &path);
+
+    /**
+     *  @brief Adds an already opened controller to the pool, without reopening it.
+     *  @param gamepad The Gamepad to move into the pool
+     *  @return The index of the pad within the pool, -1 if the pool is full
+     */
+    int add(Gamepad &&gamepad);
+
+    /**
+     *  @brief Gives the pad at the given index.
+     *  @param pad The index returned by add()
+     *  @return A reference to the Gamepad, which stays at the same address for the pool's lifetime
+     *  @details Its own change masks only cover the refreshes the pool decided to make,
+     *  @details use the pool's accessors for per-tick changes.
+     */
+    Gamepad &get(size_t pad);
+
+    /**
+     *  @brief Gives the number of pads in the pool.
+     *  @return The pad count
+     */
+    size_t size() const;
+
+    /**
+     *  @brief Refreshes every pad with pending input in one batch.
+     *  @param timeout Maximum time to wait for input, negative to wait indefinitely
+     *  @return The number of pads that changed, -1 on error with errno set
+     *  @details A single poll() over all fds selects the pads to read. Background readers and
+     *  @details reconnecting pads are waited on through their getReadyFd() and getReconnectFd().
+     *  @details Pads without anything to wait on (in-memory or replay sources, a failed pad
+     *  @details that hasn't started reconnecting) are refreshed every time.
+     */
+    int refresh(std::chrono::milliseconds timeout = std::chrono::milliseconds(0));
+
+    /**
+     *  @brief Sets the axial deadzone applied to one axis of every pad.
+     *  @param axis The index of the axis
+     *  @param deadzone Fraction of travel around the center reported as 0
+     *  @param saturation Fraction of travel reported as full output
+     *  @return 0 on success, -1 if the index is out of range
+     */
+    int setDeadzone(size_t axis, float deadzone, float saturation = 1.0f);
+
+    /**
+     *  @brief Gives the raw value of one axis of one pad as of the last refresh().
+     *  @param pad The index of the pad, must be below MAX_PADS
+     *  @param axis The index of the axis, must be below GamepadState::MAX_AXES
+     *  @return The raw value
+     */
+    short getAxis(size_t pad, size_t axis) const
+    {
+        return this->axes[axis][pad];
+    }
+
+    /**
+     *  @brief Gives the deadzoned value of one axis of one pad as of the last refresh().
+     *  @param pad The index of the pad, must be below MAX_PADS
+     *  @param axis The index of the axis, must be below GamepadState::MAX_AXES
+     *  @return The value in [-1, 1]
+     */
+    float getAxisValue(size_t pad, size_t axis) const
+    {
+        return this->values[axis][pad];
+    }
+
+    /**
+     *  @brief Gives one axis of every pad.
+     *  @param axis The index of the axis, must be below GamepadState::MAX_AXES
+     *  @return MAX_PADS raw values indexed by pad, unused pads read 0
+     */
+    const std::array<short, MAX_PADS> &axisColumn(size_t axis) const
+    {
+        return this->axes[axis];
+    }
+
+    /**
+     *  @brief Gives the deadzoned values of one axis of every pad.
+     *  @param axis The index of the axis, must be below GamepadState::MAX_AXES
+     *  @return MAX_PADS values in [-1, 1] indexed by pad, unused pads read 0
+     */
+    const std::array<float, MAX_PADS> &valueColumn(size_t axis) const
+    {
+        return this->values[axis];
+    }
+
+    /**
+     *  @brief Checks whether one button of one pad is held.
+     *  @param pad The index of the pad
+     *  @param button The index of the button, must be below GamepadState::MAX_BUTTONS
+     *  @return true if the button is held
+     */
+    bool getButton(size_t pad, size_t button) const
+    {
+        return this->held[button].test(pad);
+    }
+
+    /**
+     *  @brief Gives the pads holding a button.
+     *  @param button The index of the button, must be below GamepadState::MAX_BUTTONS
+     *  @return One bit per pad
+     */
+    const PadMask &heldBy(size_t button) const
+    {
+        return this->held[button];
+    }
+
+    /**
+     *  @brief Gives the pads that pressed a button during the last refresh().
+     *  @param button The index of the button, must be below GamepadState::MAX_BUTTONS
+     *  @return One bit per pad
+     */
+    const PadMask &pressedBy(size_t button) const
+    {
+        return this->pressed[button];
+    }
+
+    /**
+     *  @brief Gives the pads that released a button during the last refresh().
+     *  @param button The index of the button, must be below GamepadState::MAX_BUTTONS
+     *  @return One bit per pad
+     */
+    const PadMask &releasedBy(size_t button) const
+    {
+        return this->released[button];
+    }
+
+    /**
+     *  @brief Checks whether any pad pressed a button during the last refresh().
+     *  @param button The index of the button, must be below GamepadState::MAX_BUTTONS
+     *  @return true if at least one pad pressed it
+     */
+    bool anyPressed(size_t button) const
+    {
+        return this->pressed[button].any();
+    }
+
+    /**
+     *  @brief Gives the pads whose state changed during the last refresh().
+     *  @return One bit per pad
+     */
+    const PadMask &changedPads() const
+    {
+        return this->changed;
+    }
+
+private:
+    static constexpr size_t BLOCKS = MAX_PADS / LANES;
+
+    // Column per control, indexed by pad, aligned for vector loads
+    alignas(64) std::array<std::array<short, MAX_PADS>, GamepadState::MAX_AXES> axes{};
+    alignas(64) std::array<std::array<float, MAX_PADS>, GamepadState::MAX_AXES> values{};
+    std::array<PadMask, GamepadState::MAX_BUTTONS> held{};
+    std::array<PadMask, GamepadState::MAX_BUTTONS> pressed{};
+    std::array<PadMask, GamepadState::MAX_BUTTONS> released{};
+    std::array<float, GamepadState::MAX_AXES> deadzone{};
+    std::array<float, GamepadState::MAX_AXES> deadzoneScale{};
+    BitMask<GamepadState::MAX_AXES> dirtyAxes;
+    BitMask<GamepadState::MAX_BUTTONS> edgeButtons; /* buttons with press/release bits to clear */
+    PadMask changed;
+    std::array<uint16_t, MAX_PADS> axisCounts{};
+    std::array<uint16_t, MAX_PADS> buttonCounts{};
+    std::vector<Gamepad> pads;
+    size_t axisColumns;
+
+    /**
+     *  @brief Copies the controls a pad changed in its last refresh into the columns.
+     *  @param pad The index of the pad
+     *  @return true if anything changed
+     */
+    bool gather(size_t pad);
+
+    /**
+     *  @brief Copies every control of a pad into the columns, after it was added.
+     *  @param pad The index of the pad
+     */
+    void gatherAll(size_t pad);
+
+    /**
+     *  @brief Recomputes the deadzoned values of every dirty axis column.
+     */
+    void processAxes();
+
+    /**
+     *  @brief Normalizes and deadzones four pads of one axis column.
+     *  @param axis The index of the axis
+     *  @param first The index of the first pad in the block
+     */
+    void processBlock(size_t axis, size_t first);
+};
+
+#endif // GAMEPADPOOL_H
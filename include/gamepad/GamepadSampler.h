@@ -0,0 +1,184 @@
+#ifndef GAMEPADSAMPLER_H
+#define GAMEPADSAMPLER_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include "Gamepad.h"
+#include "GamepadState.h"
+#include "BitMask.h"
+#include "EventRing.h"
+#include "ThreadConfig.h"
+
+/**
+ *  @brief The state of a Gamepad at one sampling tick.
+ */
+struct SampleTick
+{
+    GamepadState state;                           /* state as of the tick */
+    BitMask<GamepadState::MAX_AXES> changedAxes;  /* axes that changed since the previous tick */
+    BitMask<GamepadState::MAX_BUTTONS> pressed;   /* buttons pressed since the previous tick */
+    BitMask<GamepadState::MAX_BUTTONS> released;  /* buttons released since the previous tick */
+    uint64_t index = 0;                           /* ticks elapsed since open(), counting missed ones */
+    uint64_t deadlineNs = 0;                      /* CLOCK_MONOTONIC time the tick was due */
+    int64_t lateNs = 0;                           /* how long after the deadline it was taken */
+    uint32_t missed = 0;                          /* ticks skipped right before this one */
+};
+
+struct SamplerStats
+{
+    /* late bucket i counts ticks taken 2^(i-1) to 2^i - 1 us late, bucket 0 is < 1 us */
+    static constexpr size_t LATE_BUCKETS = 16;
+
+    uint64_t ticks = 0;         /* ticks delivered */
+    uint64_t missedTicks = 0;   /* ticks skipped because the previous one ran too long */
+    uint64_t queueOverruns = 0; /* ticks dropped because the queue was full */
+    uint64_t totalLateNs = 0;   /* sum of lateness over delivered ticks */
+    uint64_t maxLateNs = 0;     /* worst lateness of a delivered tick */
+    std::array<uint64_t, LATE_BUCKETS> lateHistogram{};
+};
+
+/**
+ *  @brief Samples a Gamepad at a fixed rate driven by a timerfd.
+ *  @details The timer and the device fd share one poll set: input is drained as it arrives,
+ *  @details and every timer expiration delivers one SampleTick to the callback and/or queue.
+ *  @details The timer is absolute, so ticks don't drift, and each tick records how far it
+ *  @details missed its deadline. The sampler becomes the Gamepad's refreshing thread, nothing
+ *  @details else may call refresh() on it meanwhile.
+ */
+class GamepadSampler
+{
+public:
+    /**
+     *  @brief Callback invoked for each tick.
+     *  @param tick The tick, only valid during the call
+     */
+    using TickCallback = std::function<void(const SampleTick &tick)>;
+
+    /**
+     *  @brief Number of ticks the queue holds before dropping new ones.
+     */
+    static constexpr size_t QUEUE_SIZE = 64;
+
+    /**
+     *  @brief Initializes a GamepadSampler for a Gamepad, without starting the timer.
+     *  @param gamepad The Gamepad to sample, must outlive the sampler
+     *  @return The created GamepadSampler object
+     */
+    GamepadSampler(Gamepad &gamepad);
+
+    /**
+     *  @brief Destructor for GamepadSampler object, stops sampling and closes the timer
+     */
+    ~GamepadSampler();
+
+    GamepadSampler(const GamepadSampler &) = delete;
+    GamepadSampler &operator=(const GamepadSampler &) = delete;
+
+    /**
+     *  @brief Arms the timer, the first tick is due one period from now.
+     *  @param period The sampling period, e.g. 1 ms for 1 kHz
+     *  @return 0 on success, -1 on failure with errno set
+     */
+    int open(std::chrono::nanoseconds period);
+
+    /**
+     *  @brief Stops sampling and disarms the timer.
+     */
+    void close();
+
+    /**
+     *  @brief Sets the callback invoked for each tick.
+     *  @param callback The callback, called from whichever thread runs poll()
+     *  @details Must not be changed while the background thread runs.
+     */
+    void setCallback(TickCallback callback);
+
+    /**
+     *  @brief Makes ticks available through popTick() as well.
+     *  @details Must not be called while the background thread runs.
+     */
+    void enableQueue();
+
+    /**
+     *  @brief Pops the oldest queued tick.
+     *  @param tick Reference to write the tick into
+     *  @return true if a tick was popped, false if none are queued or the queue is disabled
+     *  @details Only one consumer thread may call this.
+     */
+    bool popTick(SampleTick &tick);
+
+    /**
+     *  @brief Waits for input or the next tick and handles it.
+     *  @param timeout Maximum time to wait, negative to wait indefinitely
+     *  @return The number of ticks delivered (0 or 1), -1 on error with errno set
+     *  @details Can be driven from the caller's own loop instead of start().
+     */
+    int poll(std::chrono::milliseconds timeout = std::chrono::milliseconds(-1));
+
+    /**
+     *  @brief Runs poll() on a background sampling thread.
+     *  @return 0 on success, -1 with errno set to EBADF if open() was not called, or to the
+     *  @return setThreadConfig() failure (the thread still runs then)
+     */
+    int start();
+
+    /**
+     *  @brief Stops the background sampling thread.
+     */
+    void stop();
+
+    /**
+     *  @brief Sets the CPU affinity, priority and memory locking of the sampling thread.
+     *  @param config The options, applied right away if the thread runs, or by start()
+     *  @return 0 on success, -1 on failure with errno set
+     */
+    int setThreadConfig(const ThreadConfig &config);
+
+    /**
+     *  @brief Gives the tick and deadline statistics.
+     *  @return The values so far, safe to call from any thread
+     */
+    SamplerStats getStats() const;
+
+private:
+    Gamepad &gamepad;
+    int timerFd;
+    int wakeFd;
+    uint64_t periodNs;
+    uint64_t startNs;
+    uint64_t ticks;
+    SampleTick pending;
+    TickCallback callback;
+    std::unique_ptr<EventRing<SampleTick, QUEUE_SIZE>> queue;
+    std::atomic<bool> running;
+    std::thread samplerThread;
+    ThreadConfig threadConfig;
+
+    // Written by the sampling thread only, scraped by getStats()
+    std::atomic<uint64_t> statTicks{0};
+    std::atomic<uint64_t> statMissed{0};
+    std::atomic<uint64_t> statOverruns{0};
+    std::atomic<uint64_t> statTotalLateNs{0};
+    std::atomic<uint64_t> statMaxLateNs{0};
+    std::array<std::atomic<uint64_t>, SamplerStats::LATE_BUCKETS> statLate{};
+
+    /**
+     *  @brief Refreshes the Gamepad and folds its changes into the pending tick.
+     */
+    void collect();
+
+    /**
+     *  @brief Delivers the pending tick after the timer expired.
+     *  @param expirations The number of periods elapsed since the last tick
+     *  @param nowNs CLOCK_MONOTONIC time the expiration was read
+     */
+    void deliver(uint64_t expirations, uint64_t nowNs);
+};
+
+#endif // GAMEPADSAMPLER_H
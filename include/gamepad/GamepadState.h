@@ -0,0 +1,19 @@
+#ifndef GAMEPADSTATE_H
+#define GAMEPADSTATE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+struct alignas(64) GamepadState
+{
+    static constexpr size_t MAX_AXES = 64;     /* ABS_CNT, the most axes joydev can report */
+    static constexpr size_t MAX_BUTTONS = 256; /* JSEvent::number is 8 bits wide */
+
+    std::array<short, MAX_AXES> axes{};       /* axis values, only the first axisCount are used */
+    std::array<short, MAX_BUTTONS> buttons{}; /* button values, only the first buttonCount are used */
+    uint16_t axisCount = 0;                   /* axes reported by the device */
+    uint16_t buttonCount = 0;                 /* buttons reported by the device */
+};
+
+#endif // GAMEPADSTATE_H
@@ -0,0 +1,144 @@
+#ifndef GAMEPADSTATS_H
+#define GAMEPADSTATS_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Build with -DGAMEPAD_ENABLE_STATS=0 to compile all instrumentation out of the hot path
+#ifndef GAMEPAD_ENABLE_STATS
+#define GAMEPAD_ENABLE_STATS 1
+#endif
+
+#if GAMEPAD_ENABLE_STATS
+#define GAMEPAD_STAT(statement) statement
+#else
+#define GAMEPAD_STAT(statement)
+#endif
+
+struct GamepadStats
+{
+    /* lag bucket i counts events observed 2^(i-1) to 2^i - 1 ms late, bucket 0 is < 1 ms */
+    static constexpr size_t LAG_BUCKETS = 16;
+
+    uint64_t refreshes = 0;         /* refresh() calls */
+    uint64_t readCalls = 0;         /* read() syscalls on the device */
+    uint64_t eventsDrained = 0;     /* events read from the device */
+    uint64_t eagainHits = 0;        /* read() calls that found the queue empty */
+    uint64_t frames = 0;            /* frames committed in frame coherent mode */
+    uint64_t eventsCoalesced = 0;   /* axis events merged away or held back by coalescing */
+    uint64_t lastRefreshReads = 0;  /* read() calls made by the last refresh() */
+    uint64_t maxRefreshReads = 0;   /* most read() calls made by a single refresh() */
+    uint64_t lockContentions = 0;   /* times fdMutex was held by another thread */
+    uint64_t lockWaitNs = 0;        /* total time spent waiting for fdMutex */
+    uint64_t reconnectAttempts = 0; /* open() attempts while disconnected */
+    uint64_t reconnects = 0;        /* successful reconnections */
+    uint64_t reconnectNs = 0;       /* total time spent disconnected before reconnecting */
+    std::array<uint64_t, LAG_BUCKETS> lagHistogram{}; /* kernel event time to observation */
+};
+
+/**
+ *  @brief Live counters behind GamepadStats.
+ *  @details Every counter has a single writing thread, so updates are plain relaxed
+ *  @details loads and stores rather than atomic read-modify-writes. Any thread may scrape.
+ */
+struct GamepadCounters
+{
+    std::atomic<uint64_t> refreshes{0};
+    std::atomic<uint64_t> readCalls{0};
+    std::atomic<uint64_t> eventsDrained{0};
+    std::atomic<uint64_t> eagainHits{0};
+    std::atomic<uint64_t> frames{0};
+    std::atomic<uint64_t> eventsCoalesced{0};
+    std::atomic<uint64_t> lastRefreshReads{0};
+    std::atomic<uint64_t> maxRefreshReads{0};
+    std::atomic<uint64_t> lockContentions{0};
+    std::atomic<uint64_t> lockWaitNs{0};
+    std::atomic<uint64_t> reconnectAttempts{0};
+    std::atomic<uint64_t> reconnects{0};
+    std::atomic<uint64_t> reconnectNs{0};
+    std::array<std::atomic<uint64_t>, GamepadStats::LAG_BUCKETS> lagHistogram{};
+    /* smallest observed (now - event time), the kernel clock's offset from ours */
+    int32_t lagOffsetMs = INT32_MAX;
+    /* when the current disconnection started, 0 while connected */
+    uint64_t disconnectedAtNs = 0;
+
+    /**
+     *  @brief Adds to a counter owned by the calling thread.
+     *  @param counter The counter
+     *  @param amount The amount to add
+     */
+    static void add(std::atomic<uint64_t> &counter, uint64_t amount)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    /**
+     *  @brief Records how late an event was observed.
+     *  @param nowMs CLOCK_MONOTONIC time in milliseconds, truncated to 32 bits
+     *  @param eventMs The event's kernel timestamp
+     *  @details The kernel stamps events from jiffies, not CLOCK_MONOTONIC, so lag is
+     *  @details measured against the smallest difference seen so far.
+     */
+    void observeLag(uint32_t nowMs, uint32_t eventMs)
+    {
+        int32_t delta = (int32_t)(nowMs - eventMs);
+        if (delta < this->lagOffsetMs)
+            this->lagOffsetMs = delta;
+        uint32_t lag = (uint32_t)(delta - this->lagOffsetMs);
+        size_t bucket = lag == 0 ? 0 : 32 - __builtin_clz(lag);
+        if (bucket >= GamepadStats::LAG_BUCKETS)
+            bucket = GamepadStats::LAG_BUCKETS - 1;
+        add(this->lagHistogram[bucket], 1);
+    }
+
+    /**
+     *  @brief Takes over the values of another set of counters.
+     *  @param other The counters to copy, their writing threads must be stopped
+     */
+    void assign(const GamepadCounters &other)
+    {
+        std::atomic<uint64_t> *to[] = {&this->refreshes, &this->readCalls, &this->eventsDrained, &this->eagainHits,
+                                       &this->frames, &this->eventsCoalesced, &this->lastRefreshReads,
+                                       &this->maxRefreshReads, &this->lockContentions, &this->lockWaitNs,
+                                       &this->reconnectAttempts, &this->reconnects, &this->reconnectNs};
+        const std::atomic<uint64_t> *from[] = {&other.refreshes, &other.readCalls, &other.eventsDrained, &other.eagainHits,
+                                               &other.frames, &other.eventsCoalesced, &other.lastRefreshReads,
+                                               &other.maxRefreshReads, &other.lockContentions, &other.lockWaitNs,
+                                               &other.reconnectAttempts, &other.reconnects, &other.reconnectNs};
+        for (size_t i = 0; i < sizeof(to) / sizeof(to[0]); i++)
+            to[i]->store(from[i]->load(std::memory_order_relaxed), std::memory_order_relaxed);
+        for (size_t i = 0; i < GamepadStats::LAG_BUCKETS; i++)
+            this->lagHistogram[i].store(other.lagHistogram[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        this->lagOffsetMs = other.lagOffsetMs;
+        this->disconnectedAtNs = other.disconnectedAtNs;
+    }
+
+    /**
+     *  @brief Copies the counters into a plain struct.
+     *  @return The current values
+     */
+    GamepadStats snapshot() const
+    {
+        GamepadStats stats;
+        stats.refreshes = this->refreshes.load(std::memory_order_relaxed);
+        stats.readCalls = this->readCalls.load(std::memory_order_relaxed);
+        stats.eventsDrained = this->eventsDrained.load(std::memory_order_relaxed);
+        stats.eagainHits = this->eagainHits.load(std::memory_order_relaxed);
+        stats.frames = this->frames.load(std::memory_order_relaxed);
+        stats.eventsCoalesced = this->eventsCoalesced.load(std::memory_order_relaxed);
+        stats.lastRefreshReads = this->lastRefreshReads.load(std::memory_order_relaxed);
+        stats.maxRefreshReads = this->maxRefreshReads.load(std::memory_order_relaxed);
+        stats.lockContentions = this->lockContentions.load(std::memory_order_relaxed);
+        stats.lockWaitNs = this->lockWaitNs.load(std::memory_order_relaxed);
+        stats.reconnectAttempts = this->reconnectAttempts.load(std::memory_order_relaxed);
+        stats.reconnects = this->reconnects.load(std::memory_order_relaxed);
+        stats.reconnectNs = this->reconnectNs.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < GamepadStats::LAG_BUCKETS; i++)
+            stats.lagHistogram[i] = this->lagHistogram[i].load(std::memory_order_relaxed);
+        return stats;
+    }
+};
+
+#endif // GAMEPADSTATS_H
@@ -0,0 +1,121 @@
+#ifndef HOTPLUGMONITOR_H
+#define HOTPLUGMONITOR_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include "ThreadConfig.h"
+
+class HotplugMonitor
+{
+public:
+    /**
+     *  @brief Callback that attempts to reopen a watched device.
+     *  @return true once the device was reopened, which drops the watch
+     */
+    using ReopenCallback = std::function<bool()>;
+
+    /**
+     *  @brief Gives the process-wide monitor shared by all Gamepad instances.
+     *  @return The HotplugMonitor singleton
+     */
+    static HotplugMonitor &instance();
+
+    /**
+     *  @brief Destructor for HotplugMonitor object, stops the monitor thread
+     */
+    ~HotplugMonitor();
+
+    HotplugMonitor(const HotplugMonitor &) = delete;
+    HotplugMonitor &operator=(const HotplugMonitor &) = delete;
+
+    /**
+     *  @brief Waits for a device node to (re)appear and calls back to reopen it.
+     *  @param owner Key identifying the watch, used by unwatch()
+     *  @param path The path to the device node
+     *  @param callback Called on the monitor thread when the node is created or changes
+     *  @details The callback is also tried once right away, in case the node still exists.
+     */
+    void watch(const void *owner, const std::string &path, ReopenCallback callback);
+
+    /**
+     *  @brief Drops the watch registered by owner.
+     *  @param owner Key passed to watch()
+     *  @details Once this returns the owner's callback is not running and will not run again.
+     */
+    void unwatch(const void *owner);
+
+    /**
+     *  @brief Sets the CPU affinity, priority and memory locking of the monitor thread.
+     *  @param config The options, applied right away, starting the thread if needed
+     *  @return 0 on success, -1 on failure with errno set
+     *  @details This thread performs every Gamepad's reconnection.
+     */
+    int setThreadConfig(const ThreadConfig &config);
+
+private:
+    struct Watch
+    {
+        const void *owner;
+        std::string directory;
+        std::string name;
+        ReopenCallback callback;
+        bool watched;
+        // The directory is missing (e.g. udev removed 'by-id' with its last link), its parent is watched for it
+        bool parentWatched;
+    };
+
+    int inotifyFd;
+    int wakeFd;
+    std::vector<Watch> watches;
+    std::unordered_map<int, std::string> directories;
+    std::mutex watchesMutex;
+    std::atomic<bool> running;
+    std::thread monitorThread;
+    ThreadConfig threadConfig;
+
+    /**
+     *  @brief Initializes the monitor. Use instance() instead.
+     *  @return The created HotplugMonitor object
+     */
+    HotplugMonitor();
+
+    /**
+     *  @brief Body of the monitor thread.
+     */
+    void monitorLoop();
+
+    /**
+     *  @brief Adds an inotify watch on a directory, if not watched already.
+     *  @param directory The directory containing device nodes
+     *  @return true if the directory is watched
+     */
+    bool watchDirectory(const std::string &directory);
+
+    /**
+     *  @brief Brings a watch's inotify coverage up to date, watching its directory or else its parent.
+     *  @param watch The watch
+     *  @return true if its directory became watched
+     */
+    bool refreshWatch(Watch &watch);
+
+    /**
+     *  @brief Forgets an inotify watch the kernel dropped, e.g. because its directory was deleted.
+     *  @param wd The watch descriptor
+     */
+    void dropDirectory(int wd);
+
+    /**
+     *  @brief Tries the callbacks of matching watches, dropping those that succeed.
+     *  @param directory The directory of the changed node, empty to match any
+     *  @param name The name of the changed node, empty to match any
+     *  @param unwatchedOnly Only try watches whose directory could not be watched
+     */
+    void tryReopen(const std::string &directory, const std::string &name, bool unwatchedOnly);
+};
+
+#endif // HOTPLUGMONITOR_H
@@ -0,0 +1,179 @@
+#ifndef INPUTSOURCE_H
+#define INPUTSOURCE_H
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <cerrno>
+#include <sys/types.h>
+#include "JSEvent.h"
+#include "JoystickSource.h"
+#include "EvdevSource.h"
+#include "MemorySource.h"
+#include "ReplaySource.h"
+
+enum InputSourceType
+{
+    SOURCE_NONE = 0,     /* nothing open */
+    SOURCE_JOYSTICK = 1, /* 'jsX' joystick API node, or any stream of raw JSEvents */
+    SOURCE_EVDEV = 2,    /* 'eventX' evdev node */
+    SOURCE_MEMORY = 3,   /* in-memory event buffer */
+    SOURCE_REPLAY = 4    /* recording made by EventRecorder */
+};
+
+/**
+ *  @brief Where a Gamepad reads its JSEvents from.
+ *  @details Holds every backend by value and dispatches on a type tag, so reads are a
+ *  @details predictable switch rather than a virtual call. Every backend offers the same
+ *  @details read()/close()/getAxisCount()/getButtonCount() operations.
+ */
+class InputSource
+{
+public:
+    /**
+     *  @brief Initializes an InputSource with nothing open.
+     *  @return The created InputSource object
+     */
+    InputSource();
+
+    /**
+     *  @brief Destructor for InputSource object, closes the open backend
+     */
+    ~InputSource();
+
+    InputSource(const InputSource &) = delete;
+    InputSource &operator=(const InputSource &) = delete;
+
+    /**
+     *  @brief Takes over the open backend of another InputSource without reopening it.
+     *  @param other The InputSource to take from, left with nothing open
+     *  @return The created InputSource object
+     */
+    InputSource(InputSource &&other);
+
+    /**
+     *  @brief Closes the open backend and takes over the one of another InputSource.
+     *  @param other The InputSource to take from, left with nothing open
+     *  @return This InputSource
+     */
+    InputSource &operator=(InputSource &&other);
+
+    /**
+     *  @brief Exchanges the open backends of two InputSources, nothing is reopened.
+     *  @param other The InputSource to swap with
+     */
+    void swap(InputSource &other);
+
+    /**
+     *  @brief Opens a device node, picking evdev or the joystick API by probing it.
+     *  @param path The path to a 'jsX' or 'eventX' node
+     *  @return The file descriptor, negative on failure with errno set
+     */
+    int openDevice(const std::string &path);
+
+    /**
+     *  @brief Switches to an in-memory event buffer.
+     *  @param events Pointer to the first event, copied
+     *  @param count The number of events
+     *  @param axisCount Axes the simulated device reports
+     *  @param buttonCount Buttons the simulated device reports
+     */
+    void openMemory(const JSEvent *events, size_t count, uint16_t axisCount, uint16_t buttonCount);
+
+    /**
+     *  @brief Switches to a recording made by EventRecorder.
+     *  @param path The path to the recording file
+     *  @param realtime true to deliver events with their original spacing
+     *  @return 0 on success, -1 on failure with errno set, the current backend stays open on failure
+     */
+    int openReplay(const std::string &path, bool realtime);
+
+    /**
+     *  @brief Reads whole JSEvents from the open backend.
+     *  @param buf A buffer to read into
+     *  @param size The size of the buffer in bytes
+     *  @return The number of bytes read, or -1 with errno set
+     */
+    ssize_t read(void *buf, size_t size)
+    {
+        switch (this->type)
+        {
+        case SOURCE_JOYSTICK:
+            return this->joystick.read(buf, size);
+        case SOURCE_EVDEV:
+            return this->evdev.read(buf, size);
+        case SOURCE_MEMORY:
+            return this->memory.read(buf, size);
+        case SOURCE_REPLAY:
+            return this->replay.read(buf, size);
+        default:
+            errno = EBADF;
+            return -1;
+        }
+    }
+
+    /**
+     *  @brief Gives the full-precision timestamp of an event returned by the last read().
+     *  @param index The position of the event in the buffer passed to read()
+     *  @param event The event
+     *  @return The time in microseconds, from evdev's own timestamp or JSEvent::time otherwise
+     */
+    uint64_t getTimeUs(size_t index, const JSEvent &event)
+    {
+        if (this->type == SOURCE_EVDEV)
+            return this->evdev.getTimeUs(index);
+        return (uint64_t)event.time * 1000;
+    }
+
+    /**
+     *  @brief Closes the open backend.
+     *  @return The output of its close(), 0 if nothing was open
+     */
+    int close();
+
+    /**
+     *  @brief Gives the type of the open backend.
+     *  @return The InputSourceType
+     */
+    InputSourceType getType();
+
+    /**
+     *  @brief Gives the file descriptor to poll for input.
+     *  @return The file descriptor, -1 for backends without one
+     */
+    int getFd();
+
+    /**
+     *  @brief Gives how long until events can be read without waiting on the fd.
+     *  @return 0 if events are ready, nanoseconds until the next one for timed backends,
+     *  @return -1 if the fd must be polled or nothing more will arrive
+     */
+    int64_t nextDueNs();
+
+    /**
+     *  @brief Checks whether a memory or replay backend delivered all of its events.
+     *  @return true if finished
+     */
+    bool finished();
+
+    /**
+     *  @brief Gives the number of axes reported by the open backend.
+     *  @return The axis count
+     */
+    uint16_t getAxisCount();
+
+    /**
+     *  @brief Gives the number of buttons reported by the open backend.
+     *  @return The button count
+     */
+    uint16_t getButtonCount();
+
+private:
+    InputSourceType type;
+    JoystickSource joystick;
+    EvdevSource evdev;
+    MemorySource memory;
+    ReplaySource replay;
+};
+
+#endif // INPUTSOURCE_H
@@ -4,12 +4,27 @@
 #include <sys/types.h>
 #include <cstdint>
 
+enum JSEventType
+{
+    EVENT_BUTTON = 0x01, /* button pressed/released */
+    EVENT_AXIS = 0x02,   /* joystick moved */
+    EVENT_SYNC = 0x04,   /* end of one hardware report, only from sources that know report boundaries */
+    EVENT_INIT = 0x80    /* initial state of device, or'd with the above */
+};
+
 struct JSEvent
 {
     uint time;      /* event timestamp in milliseconds */
     short value;    /* value */
-    uint8_t type;   /* event type (1: btn, 2: axis) */
+    uint8_t type;   /* event type, see JSEventType */
     uint8_t number; /* axis/button number */
 };
 
+struct TimedEvent
+{
+    JSEvent event;       /* event as read from the device */
+    uint64_t receivedNs; /* steady_clock time the event was read, in nanoseconds */
+    uint64_t sourceUs;   /* source timestamp in microseconds, full precision for evdev */
+};
+
 #endif // JSEVENT_H
\ No newline at end of file
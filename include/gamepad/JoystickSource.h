@@ -0,0 +1,69 @@
+#ifndef JOYSTICKSOURCE_H
+#define JOYSTICKSOURCE_H
+
+#include <array>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <sys/types.h>
+#include "JSEvent.h"
+
+class JoystickSource
+{
+public:
+    /**
+     *  @brief Initializes a JoystickSource without an open device.
+     *  @return The created JoystickSource object
+     */
+    JoystickSource();
+
+    /**
+     *  @brief Takes ownership of an open 'jsX' (or any readable) file descriptor.
+     *  @param fd The file descriptor
+     *  @details Queries JSIOCGAXES/JSIOCGBUTTONS, nodes that reject them get the full index range.
+     */
+    void adopt(int fd);
+
+    /**
+     *  @brief Reads whole JSEvents straight from the device.
+     *  @param buf A buffer to read into
+     *  @param size The size of the buffer in bytes
+     *  @return The number of bytes read, a multiple of sizeof(JSEvent), or -1 with errno set
+     *  @details Streams such as pipes can end a read() inside an event, the trailing bytes are
+     *  @details kept and put in front of the next read().
+     */
+    ssize_t read(void *buf, size_t size);
+
+    /**
+     *  @brief Closes the device.
+     *  @return The output of the close() system call, 0 if it was not open
+     */
+    int close();
+
+    /**
+     *  @brief Gives the device file descriptor.
+     *  @return The file descriptor, -1 if not open
+     */
+    int getFd();
+
+    /**
+     *  @brief Gives the number of axes reported by the device.
+     *  @return The axis count
+     */
+    uint16_t getAxisCount();
+
+    /**
+     *  @brief Gives the number of buttons reported by the device.
+     *  @return The button count
+     */
+    uint16_t getButtonCount();
+
+private:
+    int fd;
+    uint16_t axisCount;
+    uint16_t buttonCount;
+    std::array<uint8_t, sizeof(JSEvent)> partial;
+    size_t partialSize;
+};
+
+#endif // JOYSTICKSOURCE_H
@@ -0,0 +1,67 @@
+#ifndef MEMORYSOURCE_H
+#define MEMORYSOURCE_H
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <sys/types.h>
+#include "JSEvent.h"
+
+class MemorySource
+{
+public:
+    /**
+     *  @brief Initializes an empty MemorySource.
+     *  @return The created MemorySource object
+     */
+    MemorySource();
+
+    /**
+     *  @brief Replaces the buffered events.
+     *  @param events Pointer to the first event, copied
+     *  @param count The number of events
+     *  @param axisCount Axes the simulated device reports
+     *  @param buttonCount Buttons the simulated device reports
+     */
+    void assign(const JSEvent *events, size_t count, uint16_t axisCount, uint16_t buttonCount);
+
+    /**
+     *  @brief Copies the next buffered events into buf, mirroring read() on a joystick fd.
+     *  @param buf A buffer to read into
+     *  @param size The size of the buffer in bytes
+     *  @return The number of bytes copied, or -1 with errno set to EAGAIN once drained
+     */
+    ssize_t read(void *buf, size_t size);
+
+    /**
+     *  @brief Drops the buffered events.
+     *  @return 0
+     */
+    int close();
+
+    /**
+     *  @brief Checks whether every event has been read.
+     *  @return true if drained
+     */
+    bool finished();
+
+    /**
+     *  @brief Gives the number of axes the simulated device reports.
+     *  @return The axis count
+     */
+    uint16_t getAxisCount();
+
+    /**
+     *  @brief Gives the number of buttons the simulated device reports.
+     *  @return The button count
+     */
+    uint16_t getButtonCount();
+
+private:
+    std::vector<JSEvent> events;
+    size_t position;
+    uint16_t axisCount;
+    uint16_t buttonCount;
+};
+
+#endif // MEMORYSOURCE_H
@@ -0,0 +1,92 @@
+#ifndef REPLAYSOURCE_H
+#define REPLAYSOURCE_H
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <sys/types.h>
+#include "JSEvent.h"
+#include "EventRecorder.h"
+
+class ReplaySource
+{
+public:
+    /**
+     *  @brief Initializes a ReplaySource without an open recording.
+     *  @return The created ReplaySource object
+     */
+    ReplaySource();
+
+    /**
+     *  @brief Destructor for ReplaySource object, unmaps the recording
+     */
+    ~ReplaySource();
+
+    ReplaySource(const ReplaySource &) = delete;
+    ReplaySource &operator=(const ReplaySource &) = delete;
+
+    /**
+     *  @brief Exchanges the open recordings of two ReplaySources, the mappings stay in place.
+     *  @param other The ReplaySource to swap with
+     */
+    void swap(ReplaySource &other);
+
+    /**
+     *  @brief Memory-maps a recording made by EventRecorder.
+     *  @param path The path to the recording file
+     *  @param realtime true to deliver events with their original spacing, false for as fast as possible
+     *  @return 0 on success, -1 on failure with errno set
+     */
+    int open(const std::string &path, bool realtime);
+
+    /**
+     *  @brief Copies the events that are due into buf, mirroring read() on a joystick fd.
+     *  @param buf A buffer to read into
+     *  @param size The size of the buffer in bytes
+     *  @return The number of bytes copied, or -1 with errno set to EAGAIN if nothing is due
+     */
+    ssize_t read(void *buf, size_t size);
+
+    /**
+     *  @brief Unmaps the recording.
+     *  @return 0
+     */
+    int close();
+
+    /**
+     *  @brief Gives how long until the next event is due.
+     *  @return Nanoseconds until the next event, 0 if one is due, -1 if the replay finished
+     */
+    int64_t nextDueNs();
+
+    /**
+     *  @brief Checks whether every event has been delivered.
+     *  @return true if finished
+     */
+    bool finished();
+
+    /**
+     *  @brief Gives the header of the open recording.
+     *  @return The header
+     */
+    const RecordingHeader &getHeader();
+
+private:
+    void *mapping;
+    size_t mappingSize;
+    RecordingHeader header;
+    const JSEvent *events;
+    size_t count;
+    size_t position;
+    bool realtime;
+    uint64_t startNs;
+
+    /**
+     *  @brief Gives when an event is due, relative to the first read().
+     *  @param index The index of the event
+     *  @return The due time in CLOCK_MONOTONIC nanoseconds
+     */
+    uint64_t dueNs(size_t index);
+};
+
+#endif // REPLAYSOURCE_H
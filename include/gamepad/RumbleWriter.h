@@ -0,0 +1,160 @@
+#ifndef RUMBLEWRITER_H
+#define RUMBLEWRITER_H
+
+#include <linux/input.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/**
+ *  @brief Force feedback output served by a background writer thread.
+ *  @details Callers only record the desired state of each effect slot, the writer thread
+ *  @details performs the EVIOCSFF / EVIOCRMFF ioctls and EV_FF writes. Requests made while
+ *  @details the writer is busy are coalesced, so only the latest state of a slot reaches the
+ *  @details kernel. Effects are re-uploaded automatically after the device is reopened.
+ */
+class RumbleWriter
+{
+public:
+    /**
+     *  @brief Number of effect slots, slot 0 is the one driven by setMagnitude().
+     */
+    static constexpr size_t MAX_EFFECTS = 16;
+
+    /**
+     *  @brief Initializes a RumbleWriter without a device.
+     *  @return The created RumbleWriter object
+     */
+    RumbleWriter();
+
+    /**
+     *  @brief Destructor for RumbleWriter object, stops the writer and closes the device
+     */
+    ~RumbleWriter();
+
+    RumbleWriter(const RumbleWriter &) = delete;
+    RumbleWriter &operator=(const RumbleWriter &) = delete;
+
+    /**
+     *  @brief Opens the evdev node of a controller for writing and starts the writer thread.
+     *  @param path The path to the controller's 'jsX' or 'eventX' node, or a link to either
+     *  @return 0 on success, -1 on failure with errno set
+     *  @details For 'jsX' nodes the sibling 'eventX' node is found through sysfs.
+     */
+    int open(const std::string &path);
+
+    /**
+     *  @brief Stops the writer thread, erases uploaded effects and closes the device.
+     */
+    void close();
+
+    /**
+     *  @brief Sets the rumble motors, replacing the previous request.
+     *  @param strong Low frequency motor in [0, 1]
+     *  @param weak High frequency motor in [0, 1]
+     *  @param duration How long to play, 0 to play until changed or stopped
+     */
+    void setMagnitude(float strong, float weak, std::chrono::milliseconds duration);
+
+    /**
+     *  @brief Stops the rumble motors.
+     */
+    void stop();
+
+    /**
+     *  @brief Queues an effect for upload.
+     *  @param effect The effect, its id is ignored
+     *  @return A handle for playEffect() / stopEffect() / eraseEffect(), -1 if all slots are in use
+     *  @details updateEffect() later changes it in place.
+     */
+    int uploadEffect(const struct ff_effect &effect);
+
+    /**
+     *  @brief Queues a replacement for an uploaded effect.
+     *  @param handle The handle given by uploadEffect()
+     *  @param effect The new effect, its id is ignored
+     */
+    void updateEffect(int handle, const struct ff_effect &effect);
+
+    /**
+     *  @brief Queues playback of an effect.
+     *  @param handle The handle given by uploadEffect()
+     *  @param count Number of repetitions
+     */
+    void playEffect(int handle, int count = 1);
+
+    /**
+     *  @brief Queues stopping an effect.
+     *  @param handle The handle given by uploadEffect()
+     */
+    void stopEffect(int handle);
+
+    /**
+     *  @brief Queues removal of an effect from the device, freeing its handle.
+     *  @param handle The handle given by uploadEffect()
+     */
+    void eraseEffect(int handle);
+
+    /**
+     *  @brief Gives the errno of the last failed ioctl or write on the writer thread.
+     *  @return The error, 0 if none
+     */
+    int getError();
+
+private:
+    // Retry interval while the device is gone
+    static constexpr std::chrono::milliseconds REOPEN_INTERVAL{250};
+
+    struct Slot
+    {
+        struct ff_effect effect{};
+        int16_t kernelId = -1;   /* id assigned by EVIOCSFF, -1 if not on the device */
+        uint32_t generation = 0; /* bumped when the handle is freed or reused */
+        bool used = false;
+        bool playing = false;    /* last requested playback state, restored after a reopen */
+        bool uploadPending = false;
+        bool erasePending = false;
+        int playPending = -1;    /* repetitions to play, 0 to stop, -1 if nothing to do */
+    };
+
+    std::string path;
+    int fd;
+    std::array<Slot, MAX_EFFECTS> slots;
+    bool pending;
+    bool running;
+    std::mutex slotsMutex;
+    std::condition_variable wake;
+    std::thread writerThread;
+    std::atomic<int> error;
+
+    /**
+     *  @brief Resolves and opens the evdev node for path.
+     *  @return The file descriptor, -1 on failure with errno set
+     */
+    int openDevice();
+
+    /**
+     *  @brief Body of the writer thread.
+     */
+    void writerLoop();
+
+    /**
+     *  @brief Performs the pending operations of one slot on the device.
+     *  @param slot The slot state copied out of slots
+     *  @return false if the device is gone
+     */
+    bool apply(Slot &slot);
+
+    /**
+     *  @brief Marks a slot dirty and wakes the writer, with slotsMutex held.
+     */
+    void notify();
+};
+
+#endif // RUMBLEWRITER_H
@@ -0,0 +1,75 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/**
+ *  @brief Single-writer sequence lock publishing copies of a trivially copyable value.
+ *  @details Readers never block the writer and never see a torn value, they retry
+ *  @details instead if a store happened during their copy. Any number of readers is allowed.
+ */
+template <typename T>
+class Seqlock
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Seqlock requires a trivially copyable type");
+
+public:
+    /**
+     *  @brief Publishes a new value. Only one thread may store.
+     *  @param value The value to publish
+     */
+    void store(const T &value)
+    {
+        std::array<uint64_t, WORDS> words{};
+        std::memcpy(words.data(), &value, sizeof(T));
+        uint32_t seq = this->sequence.load(std::memory_order_relaxed);
+        // Odd sequence marks a write in progress
+        this->sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < WORDS; i++)
+            this->data[i].store(words[i], std::memory_order_relaxed);
+        this->sequence.store(seq + 2, std::memory_order_release);
+    }
+
+    /**
+     *  @brief Reads a consistent copy of the last published value.
+     *  @return The value
+     */
+    T load() const
+    {
+        std::array<uint64_t, WORDS> words;
+        uint32_t before, after;
+        do
+        {
+            before = this->sequence.load(std::memory_order_acquire);
+            for (size_t i = 0; i < WORDS; i++)
+                words[i] = this->data[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = this->sequence.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+        T value;
+        std::memcpy(static_cast<void *>(&value), words.data(), sizeof(T));
+        return value;
+    }
+
+    /**
+     *  @brief Gives the number of stores so far, useful to skip unchanged values.
+     *  @return The store count
+     */
+    uint32_t version() const
+    {
+        return this->sequence.load(std::memory_order_acquire) / 2;
+    }
+
+private:
+    static constexpr size_t WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    alignas(64) std::atomic<uint32_t> sequence{0};
+    alignas(64) std::array<std::atomic<uint64_t>, WORDS> data{};
+};
+
+#endif // SEQLOCK_H
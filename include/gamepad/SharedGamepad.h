@@ -0,0 +1,279 @@
+#ifndef SHAREDGAMEPAD_H
+#define SHAREDGAMEPAD_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "Gamepad.h"
+#include "GamepadState.h"
+#include "GamepadStatus.h"
+#include "JSEvent.h"
+#include "Seqlock.h"
+#include "BitMask.h"
+
+/**
+ *  @brief Layout of the POSIX shared-memory segment a SharedGamepadPublisher writes.
+ *  @details One writer, any number of read-only mappings. The state is seqlocked and the
+ *  @details events go through a broadcast ring: every slot carries the sequence number of
+ *  @details the event it holds, so each reader keeps its own cursor and detects when the
+ *  @details writer lapped it instead of blocking the writer.
+ */
+struct SharedGamepadSegment
+{
+    static constexpr uint32_t MAGIC = 0x48535047; /* "GPSH" */
+    static constexpr uint32_t VERSION = 1;
+    static constexpr size_t EVENT_SLOTS = 1024;
+    static constexpr size_t NAME_SIZE = 128;
+
+    struct alignas(16) Slot
+    {
+        std::atomic<uint64_t> sequence; /* index + 1 of the held event, 0 while being written */
+        std::atomic<uint64_t> event;    /* the JSEvent's 8 bytes */
+    };
+
+    std::atomic<uint32_t> magic;          /* MAGIC once the segment is initialized */
+    uint32_t version;                     /* VERSION of the layout */
+    uint32_t size;                        /* sizeof(SharedGamepadSegment) */
+    std::atomic<int32_t> status;          /* GamepadStatus of the publisher's Gamepad */
+    std::atomic<uint64_t> publishedNs;    /* CLOCK_MONOTONIC time of the last publish(), a heartbeat */
+    std::atomic<uint64_t> droppedEvents;  /* events the publisher lost before writing them */
+    char name[NAME_SIZE];                 /* device name, written before magic */
+    uint16_t busType;
+    uint16_t vendor;
+    uint16_t product;
+    uint16_t hardwareVersion;
+    Seqlock<GamepadState> state;
+    alignas(64) std::atomic<uint64_t> eventTail; /* events written so far */
+    std::array<Slot, EVENT_SLOTS> events;
+};
+
+/**
+ *  @brief Publishes one process' Gamepad to other processes through shared memory.
+ *  @details The owning process keeps reading the device as usual and calls publish() after
+ *  @details each refresh(). Readers map the segment with SharedGamepadView, so the device is
+ *  @details read, and reconnected, by a single process.
+ */
+class SharedGamepadPublisher
+{
+public:
+    /**
+     *  @brief Initializes a SharedGamepadPublisher for a Gamepad, without creating the segment.
+     *  @param gamepad The Gamepad to publish, must outlive the publisher
+     *  @return The created SharedGamepadPublisher object
+     */
+    SharedGamepadPublisher(Gamepad &gamepad);
+
+    /**
+     *  @brief Destructor for SharedGamepadPublisher object, removes the segment
+     */
+    ~SharedGamepadPublisher();
+
+    SharedGamepadPublisher(const SharedGamepadPublisher &) = delete;
+    SharedGamepadPublisher &operator=(const SharedGamepadPublisher &) = delete;
+
+    /**
+     *  @brief Creates the segment and publishes the current state.
+     *  @param name The shm_open() name, e.g. "/gamepad0"
+     *  @return 0 on success, -1 on failure with errno set
+     *  @details Replaces a stale segment of the same name. Enables the Gamepad's history,
+     *  @details which is where publish() takes the events from.
+     */
+    int open(const std::string &name);
+
+    /**
+     *  @brief Unmaps and removes the segment, mapped views keep their last state.
+     */
+    void close();
+
+    /**
+     *  @brief Writes the state and the events applied since the last call.
+     *  @details Call from the Gamepad's refreshing thread, after refresh(). The state is only
+     *  @details stored when something changed, the heartbeat is updated every time.
+     */
+    void publish();
+
+    /**
+     *  @brief Checks whether the segment exists.
+     *  @return true between a successful open() and close()
+     */
+    bool isOpen();
+
+private:
+    Gamepad &gamepad;
+    std::string name;
+    SharedGamepadSegment *segment;
+    uint64_t historySeen;
+    uint32_t stateVersion;
+    int32_t lastStatus;
+};
+
+/**
+ *  @brief Read-only, Gamepad-like view of a segment written by a SharedGamepadPublisher.
+ *  @details refresh() copies the published state and collects the new events without any
+ *  @details system call. A view never writes to the segment, so any number of processes
+ *  @details can map it. Each view is owned by one thread.
+ */
+class SharedGamepadView
+{
+public:
+    /**
+     *  @brief Initializes a SharedGamepadView that is not mapped yet.
+     *  @return The created SharedGamepadView object
+     */
+    SharedGamepadView();
+
+    /**
+     *  @brief Destructor for SharedGamepadView object, unmaps the segment
+     */
+    ~SharedGamepadView();
+
+    SharedGamepadView(const SharedGamepadView &) = delete;
+    SharedGamepadView &operator=(const SharedGamepadView &) = delete;
+
+    /**
+     *  @brief Maps a segment created by a SharedGamepadPublisher.
+     *  @param name The shm_open() name given to the publisher
+     *  @return 0 on success, -1 on failure with errno set (EPROTO if the layout doesn't match,
+     *  @return EAGAIN if the publisher is still initializing it)
+     *  @details Only events published after this call are delivered.
+     */
+    int open(const std::string &name);
+
+    /**
+     *  @brief Unmaps the segment.
+     */
+    void close();
+
+    /**
+     *  @brief Checks whether a segment is mapped.
+     *  @return true between a successful open() and close()
+     */
+    bool isOpen();
+
+    /**
+     *  @brief Takes the latest published state and collects the new events.
+     */
+    void refresh();
+
+    /**
+     *  @brief Pops the oldest event collected by refresh().
+     *  @param event Reference to write the event into
+     *  @return true if an event was popped
+     */
+    bool popEvent(JSEvent &event);
+
+    /**
+     *  @brief Gives the state of an axis as of the last refresh().
+     *  @param index The index of the axis
+     *  @return The value, 0 if out of range
+     */
+    short getAxis(int index);
+
+    /**
+     *  @brief Gives the state of a button as of the last refresh().
+     *  @param index The index of the button
+     *  @return The value, 0 if out of range
+     */
+    short getButton(int index);
+
+    /**
+     *  @brief Checks whether a button went down in the last refresh().
+     *  @param index The index of the button
+     *  @return true if it was pressed
+     */
+    bool wasPressed(int index);
+
+    /**
+     *  @brief Checks whether a button went up in the last refresh().
+     *  @param index The index of the button
+     *  @return true if it was released
+     */
+    bool wasReleased(int index);
+
+    /**
+     *  @brief Gives the axes that changed in the last refresh().
+     *  @return The mask
+     */
+    const BitMask<GamepadState::MAX_AXES> &changedAxes();
+
+    /**
+     *  @brief Gives the buttons that changed in the last refresh().
+     *  @return The mask
+     */
+    const BitMask<GamepadState::MAX_BUTTONS> &changedButtons();
+
+    /**
+     *  @brief Gives the whole state as of the last refresh().
+     *  @return The state
+     */
+    const GamepadState &snapshot();
+
+    /**
+     *  @brief Gives the number of axes the device reports.
+     *  @return The axis count
+     */
+    int getAxisCount();
+
+    /**
+     *  @brief Gives the number of buttons the device reports.
+     *  @return The button count
+     */
+    int getButtonCount();
+
+    /**
+     *  @brief Gives the status of the publisher's Gamepad.
+     *  @return The status, INVALID_FILE_ERROR if no segment is mapped
+     */
+    GamepadStatus getStatus();
+
+    /**
+     *  @brief Checks whether the publisher's Gamepad is in an error state.
+     *  @return true if the status is not OK
+     */
+    bool getErr();
+
+    /**
+     *  @brief Gives the device name published by the publisher.
+     *  @return The name, empty if no segment is mapped
+     */
+    std::string getName();
+
+    /**
+     *  @brief Gives the time since the publisher last called publish().
+     *  @return The age in nanoseconds, lets readers notice a publisher that died
+     */
+    uint64_t getPublishAgeNs();
+
+    /**
+     *  @brief Gives the number of events this view missed because the writer lapped it.
+     *  @return The count, including events the publisher itself dropped since open()
+     */
+    uint64_t getDroppedEvents();
+
+private:
+    // Events a refresh() keeps for popEvent(), at most one ring lap
+    static constexpr size_t PENDING_SIZE = SharedGamepadSegment::EVENT_SLOTS;
+
+    const SharedGamepadSegment *segment;
+    GamepadState state;
+    uint32_t stateVersion;
+    uint64_t eventHead;
+    uint64_t dropped;
+    uint64_t publisherDroppedAtOpen;
+    BitMask<GamepadState::MAX_AXES> axisChanges;
+    BitMask<GamepadState::MAX_BUTTONS> buttonChanges;
+    BitMask<GamepadState::MAX_BUTTONS> presses;
+    BitMask<GamepadState::MAX_BUTTONS> releases;
+    std::array<JSEvent, PENDING_SIZE> pending;
+    size_t pendingHead;
+    size_t pendingCount;
+
+    /**
+     *  @brief Copies the events published since the last call into pending.
+     */
+    void collectEvents();
+};
+
+#endif // SHAREDGAMEPAD_H
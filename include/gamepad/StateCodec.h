@@ -0,0 +1,127 @@
+#ifndef STATECODEC_H
+#define STATECODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include "GamepadState.h"
+#include "BitMask.h"
+
+/**
+ *  @brief Packet layout shared by StateEncoder and StateDecoder.
+ *  @details flags byte, varint sequence, [varint axisCount, varint buttonCount if keyframe],
+ *  @details varint mask of the axes that follow, one zigzag varint delta per such axis,
+ *  @details varint mask of the 8-button groups that follow, one toggle byte per such group.
+ *  @details A keyframe is a delta against the all-zero state, so it uses the same body.
+ *  @details Buttons are carried as pressed/released, decoded values are 0 or 1.
+ */
+struct StatePacket
+{
+    static constexpr uint8_t FLAG_KEYFRAME = 0x01;
+
+    /**
+     *  @brief Upper bound on the size of any encoded packet.
+     */
+    static constexpr size_t MAX_SIZE = 1 + 5 + 3 + 3 + 10 + GamepadState::MAX_AXES * 3 + 5 + GamepadState::MAX_BUTTONS / 8;
+};
+
+/**
+ *  @brief Turns successive GamepadStates into compact packets holding only what changed.
+ *  @details Keeps the last state it encoded, packets are meant for one StateDecoder.
+ */
+class StateEncoder
+{
+public:
+    /**
+     *  @brief Initializes a StateEncoder whose first packet is a keyframe.
+     *  @return The created StateEncoder object
+     */
+    StateEncoder();
+
+    /**
+     *  @brief Encodes the controls marked in the change masks that differ from the last packet.
+     *  @param state The current state
+     *  @param axisChanges Axes that may have changed since the last call
+     *  @param buttonChanges Buttons that may have changed since the last call
+     *  @param out Buffer of at least StatePacket::MAX_SIZE bytes
+     *  @return The packet size, 0 if nothing changed and no packet needs to be sent
+     *  @details Changes outside the masks are missed until the next keyframe, so pass masks
+     *  @details covering everything since the previous call (e.g. after each refresh()).
+     */
+    size_t encode(const GamepadState &state, const BitMask<GamepadState::MAX_AXES> &axisChanges,
+                  const BitMask<GamepadState::MAX_BUTTONS> &buttonChanges, uint8_t *out);
+
+    /**
+     *  @brief Encodes every control that differs from the last packet, without change masks.
+     *  @param state The current state
+     *  @param out Buffer of at least StatePacket::MAX_SIZE bytes
+     *  @return The packet size, 0 if nothing changed and no packet needs to be sent
+     */
+    size_t encode(const GamepadState &state, uint8_t *out);
+
+    /**
+     *  @brief Makes the next packet a keyframe, e.g. when the decoder reports a gap.
+     */
+    void requestKeyframe();
+
+    /**
+     *  @brief Sends a keyframe every so many packets, so lossy transports recover on their own.
+     *  @param packets The interval, 0 to only send keyframes on request
+     */
+    void setKeyframeInterval(uint32_t packets);
+
+private:
+    GamepadState sent;
+    uint32_t sequence;
+    uint32_t keyframeInterval;
+    uint32_t sinceKeyframe;
+    bool keyframePending;
+
+    /**
+     *  @brief Encodes the candidates that differ from sent and updates sent.
+     *  @param state The current state
+     *  @param axisCandidates Axes to compare
+     *  @param buttonWords Buttons to compare, one bit per button
+     *  @param out Buffer of at least StatePacket::MAX_SIZE bytes
+     *  @return The packet size, 0 if nothing needs to be sent
+     */
+    size_t encodeDiff(const GamepadState &state, uint64_t axisCandidates, const uint64_t *buttonWords, uint8_t *out);
+};
+
+/**
+ *  @brief Rebuilds a GamepadState from StateEncoder packets.
+ */
+class StateDecoder
+{
+public:
+    /**
+     *  @brief Initializes a StateDecoder waiting for a keyframe.
+     *  @return The created StateDecoder object
+     */
+    StateDecoder();
+
+    /**
+     *  @brief Applies one packet to the state.
+     *  @param data The packet
+     *  @param size The packet size in bytes
+     *  @param state The state to update, only touched on success
+     *  @param axisChanges Optional mask receiving the axes the packet changed
+     *  @param buttonChanges Optional mask receiving the buttons the packet changed
+     *  @return 0 on success, -1 with errno set to EBADMSG for a malformed packet, EALREADY for
+     *  @return a stale or duplicate one, EPROTO if packets were lost and a keyframe is needed
+     */
+    int decode(const uint8_t *data, size_t size, GamepadState &state,
+               BitMask<GamepadState::MAX_AXES> *axisChanges = nullptr,
+               BitMask<GamepadState::MAX_BUTTONS> *buttonChanges = nullptr);
+
+    /**
+     *  @brief Checks whether deltas are being refused until the next keyframe.
+     *  @return true if a keyframe should be requested from the encoder
+     */
+    bool needsKeyframe() const;
+
+private:
+    uint32_t expected;
+    bool synced;
+};
+
+#endif // STATECODEC_H
@@ -0,0 +1,72 @@
+#ifndef THREADCONFIG_H
+#define THREADCONFIG_H
+
+#include <pthread.h>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <thread>
+#include <utility>
+
+/**
+ *  @brief Scheduling and memory options for the library's background threads.
+ *  @details The default leaves threads exactly as std::thread creates them. SCHED_FIFO
+ *  @details priorities and mlockall() usually need CAP_SYS_NICE / CAP_IPC_LOCK or matching
+ *  @details rlimits, failures are reported with errno set to EPERM.
+ */
+struct ThreadConfig
+{
+    uint64_t cpuMask = 0;      /* bit i allows CPU i, 0 for any CPU */
+    int priority = 0;          /* SCHED_FIFO priority from 1 to 99, 0 to keep SCHED_OTHER */
+    bool lockMemory = false;   /* mlockall() current and future pages, for the whole process */
+    size_t stackPrefault = 0;  /* bytes of stack touched when a thread starts */
+
+    /**
+     *  @brief Applies the CPU affinity and scheduling policy to a running thread.
+     *  @param thread The thread
+     *  @return 0 on success, -1 on failure with errno set
+     */
+    int apply(pthread_t thread) const;
+
+    /**
+     *  @brief Locks the process' memory if lockMemory is set.
+     *  @return 0 on success or if nothing was requested, -1 on failure with errno set
+     */
+    int lockProcessMemory() const;
+
+    /**
+     *  @brief Touches stackPrefault bytes of the calling thread's stack so later use doesn't fault.
+     */
+    void prefaultStack() const;
+
+    /**
+     *  @brief Starts a thread that configures itself before running the body.
+     *  @param thread Set to the started thread
+     *  @param body The thread body
+     *  @return 0 on success, -1 with errno set if the scheduling could not be applied
+     *  @details Returns once the new thread applied its settings. A thread that cannot get
+     *  @details the requested scheduling still runs, with defaults.
+     */
+    template <typename F>
+    int launch(std::thread &thread, F body) const
+    {
+        ThreadConfig config = *this;
+        std::promise<int> applied;
+        std::future<int> result = applied.get_future();
+        // The promise lives in the thread, the launcher may return as soon as it is set
+        thread = std::thread([config, body, applied = std::move(applied)]() mutable
+                             {
+            int err = config.apply(pthread_self()) < 0 ? errno : 0;
+            config.prefaultStack();
+            applied.set_value(err);
+            body(); });
+        int err = result.get();
+        if (err == 0)
+            return 0;
+        errno = err;
+        return -1;
+    }
+};
+
+#endif // THREADCONFIG_H
@@ -0,0 +1,174 @@
+#include "../include/gamepad/AxisCoalescer.h"
+
+#include <cstdlib>
+
+// Marks a superseded event in the batch, no real event has type 0
+static constexpr uint8_t EVENT_SUPERSEDED = 0;
+
+/**
+ *  @brief Initializes an AxisCoalescer that passes every axis through.
+ *  @return The created AxisCoalescer object
+ */
+AxisCoalescer::AxisCoalescer()
+{
+}
+
+/**
+ *  @brief Coalesces one axis.
+ *  @param axis The index of the axis
+ *  @param options The interval and threshold
+ *  @return 0 on success, -1 if the index is out of range
+ */
+int AxisCoalescer::setOptions(size_t axis, const AxisCoalescing &options)
+{
+    if (axis >= GamepadState::MAX_AXES)
+        return -1;
+    this->options[axis] = options;
+    this->intervalNs[axis] = options.interval.count() > 0 ? (uint64_t)options.interval.count() * 1000 : 0;
+    this->thresholds[axis] = options.threshold;
+    this->coalesced.set(axis);
+    return 0;
+}
+
+/**
+ *  @brief Gives the options of one axis.
+ *  @param axis The index of the axis, must be below GamepadState::MAX_AXES
+ *  @return The options
+ */
+const AxisCoalescing &AxisCoalescer::getOptions(size_t axis) const
+{
+    return this->options[axis];
+}
+
+/**
+ *  @brief Drops superseded and held-back axis events from a batch.
+ *  @param events The batch, compacted in place
+ *  @param count The number of events
+ *  @param nowNs CLOCK_MONOTONIC time of the batch
+ *  @return The number of events left, in their original order
+ */
+size_t AxisCoalescer::filter(JSEvent *events, size_t count, uint64_t nowNs)
+{
+    // Newest first, so every axis event that has a later one in the batch is marked
+    BitMask<GamepadState::MAX_AXES> later;
+    for (size_t i = count; i-- > 0;)
+    {
+        JSEvent &event = events[i];
+        if (event.type != EVENT_AXIS || event.number >= GamepadState::MAX_AXES || !this->coalesced.test(event.number))
+            continue;
+        if (later.test(event.number))
+            event.type = EVENT_SUPERSEDED;
+        else
+            later.set(event.number);
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        const JSEvent &event = events[i];
+        if (event.type == EVENT_SUPERSEDED)
+            continue;
+        uint8_t type = event.type & ~EVENT_INIT;
+        if (type == EVENT_AXIS && event.number < GamepadState::MAX_AXES && this->coalesced.test(event.number))
+        {
+            size_t axis = event.number;
+            if (event.type & EVENT_INIT)
+            {
+                // The stream's starting point, applied as is
+                this->pending.reset(axis);
+            }
+            else if (event.value == this->applied[axis])
+            {
+                // Back to what was applied, nothing is outstanding anymore
+                this->pending.reset(axis);
+                continue;
+            }
+            else if (!this->due(axis, event.value, nowNs, false))
+            {
+                this->held[axis] = event;
+                this->pending.set(axis);
+                this->touched.set(axis);
+                continue;
+            }
+            this->pending.reset(axis);
+            this->applied[axis] = event.value;
+            this->appliedNs[axis] = nowNs;
+        }
+        events[kept++] = event;
+    }
+    return kept;
+}
+
+/**
+ *  @brief Hands out the held-back values that may be applied now.
+ *  @param nowNs CLOCK_MONOTONIC time, usually that of the last filter()
+ *  @param out Buffer of at least GamepadState::MAX_AXES events
+ *  @return The number of events written
+ */
+size_t AxisCoalescer::flush(uint64_t nowNs, JSEvent *out)
+{
+    size_t count = 0;
+    if (this->pending.any())
+    {
+        for (size_t axis : this->pending)
+        {
+            const JSEvent &event = this->held[axis];
+            if (!this->due(axis, event.value, nowNs, !this->touched.test(axis)))
+                continue;
+            out[count++] = event;
+            this->applied[axis] = event.value;
+            this->appliedNs[axis] = nowNs;
+        }
+        for (size_t i = 0; i < count; i++)
+            this->pending.reset(out[i].number);
+    }
+    this->touched.clear();
+    return count;
+}
+
+/**
+ *  @brief Gives how long until flush() has a held-back value to hand out.
+ *  @param nowNs CLOCK_MONOTONIC time
+ *  @return Nanoseconds until the earliest one is due, 0 if one is due now, -1 if none is held
+ */
+int64_t AxisCoalescer::nextDueNs(uint64_t nowNs) const
+{
+    int64_t earliest = -1;
+    if (!this->pending.any())
+        return earliest;
+    for (size_t axis : this->pending)
+    {
+        uint64_t dueNs = this->appliedNs[axis] + this->intervalNs[axis];
+        int64_t wait = dueNs > nowNs ? (int64_t)(dueNs - nowNs) : 0;
+        if (earliest < 0 || wait < earliest)
+            earliest = wait;
+    }
+    return earliest;
+}
+
+/**
+ *  @brief Drops the held-back values, e.g. when the stream is reopened.
+ */
+void AxisCoalescer::reset()
+{
+    this->pending.clear();
+    this->touched.clear();
+    this->applied.fill(0);
+    this->appliedNs.fill(0);
+}
+
+/**
+ *  @brief Checks whether a value may be applied now.
+ *  @param axis The index of the axis
+ *  @param value The value
+ *  @param nowNs CLOCK_MONOTONIC time
+ *  @param quiet Whether the axis had no event since the last flush()
+ *  @return true if it may be applied
+ */
+bool AxisCoalescer::due(size_t axis, short value, uint64_t nowNs, bool quiet) const
+{
+    if (nowNs - this->appliedNs[axis] < this->intervalNs[axis])
+        return false;
+    // Jitter below the threshold waits until the stick settles, then the settled value goes through
+    return quiet || std::abs(value - this->applied[axis]) >= this->thresholds[axis];
+}
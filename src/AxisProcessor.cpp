@@ -0,0 +1,257 @@
+#include "../include/gamepad/AxisProcessor.h"
+
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+static_assert(GamepadState::MAX_AXES % AxisProcessor::LANES == 0, "axes must fill whole vectors");
+static_assert(GamepadState::MAX_AXES / AxisProcessor::LANES <= 64, "block mask is a single word");
+
+/**
+ *  @brief Gives 1 / range, or 0 for an empty range so the axis stays at the center.
+ *  @param range The distance between the center and one end of travel
+ *  @return The scale factor
+ */
+static float inverseRange(float range)
+{
+    return range > 0.0f ? 1.0f / range : 0.0f;
+}
+
+/**
+ *  @brief Initializes an AxisProcessor with identity calibration on every axis.
+ *  @return The created AxisProcessor object
+ */
+AxisProcessor::AxisProcessor()
+{
+    this->normalized.fill(0.0f);
+    this->values.fill(0.0f);
+    this->pairCount = 0;
+    for (size_t axis = 0; axis < GamepadState::MAX_AXES; axis++)
+        this->setCalibration(axis, AxisCalibration());
+}
+
+/**
+ *  @brief Replaces the calibration of one axis.
+ *  @param axis The index of the axis
+ *  @param calibration The new calibration
+ *  @return 0 on success, -1 if the index is out of range
+ */
+int AxisProcessor::setCalibration(size_t axis, const AxisCalibration &calibration)
+{
+    if (axis >= GamepadState::MAX_AXES)
+        return -1;
+    this->calibrations[axis] = calibration;
+    this->center[axis] = calibration.center;
+    this->positiveScale[axis] = inverseRange((float)calibration.maximum - calibration.center);
+    this->negativeScale[axis] = inverseRange((float)calibration.center - calibration.minimum);
+    this->deadzone[axis] = calibration.deadzone;
+    // A saturation at or below the deadzone turns the axis into a switch
+    this->deadzoneScale[axis] = calibration.saturation > calibration.deadzone
+                                    ? 1.0f / (calibration.saturation - calibration.deadzone)
+                                    : 1e30f;
+    this->curve[axis] = calibration.curve;
+    this->gain[axis] = calibration.invert ? -1.0f : 1.0f;
+    this->stale = true;
+    return 0;
+}
+
+/**
+ *  @brief Gives the calibration of one axis.
+ *  @param axis The index of the axis, must be below GamepadState::MAX_AXES
+ *  @return The calibration
+ */
+const AxisCalibration &AxisProcessor::getCalibration(size_t axis) const
+{
+    return this->calibrations[axis];
+}
+
+/**
+ *  @brief Makes two axes share a circular deadzone, replacing any previous one for the pair.
+ *  @param xAxis The index of the horizontal axis
+ *  @param yAxis The index of the vertical axis
+ *  @param deadzone Radius reported as the center, as a fraction of travel
+ *  @param saturation Radius reported as full deflection, as a fraction of travel
+ *  @return 0 on success, -1 if an index is out of range or all pairs are in use
+ */
+int AxisProcessor::setRadialDeadzone(size_t xAxis, size_t yAxis, float deadzone, float saturation)
+{
+    if (xAxis >= GamepadState::MAX_AXES || yAxis >= GamepadState::MAX_AXES || xAxis == yAxis)
+        return -1;
+    RadialPair pair{(uint8_t)xAxis, (uint8_t)yAxis, deadzone,
+                    saturation > deadzone ? 1.0f / (saturation - deadzone) : 1e30f};
+    size_t slot = 0;
+    while (slot < this->pairCount && !(this->pairs[slot].xAxis == xAxis && this->pairs[slot].yAxis == yAxis))
+        slot++;
+    if (slot == MAX_RADIAL_PAIRS)
+        return -1;
+    if (slot == this->pairCount)
+        this->pairCount++;
+    this->pairs[slot] = pair;
+    this->stale = true;
+    return 0;
+}
+
+/**
+ *  @brief Removes every radial deadzone.
+ */
+void AxisProcessor::clearRadialDeadzones()
+{
+    this->pairCount = 0;
+    this->stale = true;
+}
+
+/**
+ *  @brief Forces every axis to be recomputed by the next process() call.
+ */
+void AxisProcessor::invalidate()
+{
+    this->stale = true;
+}
+
+/**
+ *  @brief Recomputes the axes that changed.
+ *  @param state The state holding the raw axis values
+ *  @param changes The axes that changed since the last call
+ */
+void AxisProcessor::process(const GamepadState &state, const BitMask<GamepadState::MAX_AXES> &changes)
+{
+    // One bit per block of LANES axes, blocks past the reported axes are always zero
+    size_t usedBlocks = (state.axisCount + LANES - 1) / LANES;
+    uint64_t dirty = 0;
+    for (size_t block = 0; block < usedBlocks; block++)
+    {
+        size_t first = block * LANES;
+        uint64_t bits = changes.data()[first / 64] >> (first % 64);
+        if (this->stale || (bits & ((uint64_t(1) << LANES) - 1)))
+            dirty |= uint64_t(1) << block;
+    }
+    if (this->stale)
+    {
+        // Axes the device no longer reports settle on 0
+        for (size_t axis = usedBlocks * LANES; axis < GamepadState::MAX_AXES; axis++)
+            this->normalized[axis] = this->values[axis] = 0.0f;
+        this->stale = false;
+    }
+    if (!dirty)
+        return;
+
+    // A radial pair needs both of its axes recomputed together, and pulling in its blocks
+    // can make an earlier pair dirty, so expand until nothing changes
+    uint64_t expanded;
+    do
+    {
+        expanded = dirty;
+        for (size_t i = 0; i < this->pairCount; i++)
+            if (dirty & this->pairBlocks(this->pairs[i]))
+                dirty |= this->pairBlocks(this->pairs[i]);
+    } while (dirty != expanded);
+    // Every pair touching a recomputed block is re-normalized, so each must be reshaped
+    uint64_t pairsDirty = 0;
+    for (size_t i = 0; i < this->pairCount; i++)
+        if (dirty & this->pairBlocks(this->pairs[i]))
+            pairsDirty |= uint64_t(1) << i;
+
+    for (size_t block = 0; block < BLOCKS; block++)
+        if (dirty >> block & 1)
+            this->normalizeBlock(&state.axes[block * LANES], block * LANES);
+    for (size_t i = 0; i < this->pairCount; i++)
+        if (pairsDirty >> i & 1)
+            this->applyRadial(this->pairs[i]);
+    for (size_t block = 0; block < BLOCKS; block++)
+        if (dirty >> block & 1)
+            this->shapeBlock(block * LANES);
+}
+
+/**
+ *  @brief Centers, scales and clamps four raw axes into normalized.
+ *  @param raw Pointer to the first raw value of the block
+ *  @param first The index of the first axis in the block
+ */
+void AxisProcessor::normalizeBlock(const short *raw, size_t first)
+{
+#if defined(__SSE2__)
+    __m128i packed = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(raw));
+    // Sign extend the four shorts to 32 bits
+    __m128i wide = _mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16);
+    __m128 offset = _mm_sub_ps(_mm_cvtepi32_ps(wide), _mm_load_ps(&this->center[first]));
+    __m128 positive = _mm_cmpge_ps(offset, _mm_setzero_ps());
+    __m128 scale = _mm_or_ps(_mm_and_ps(positive, _mm_load_ps(&this->positiveScale[first])),
+                             _mm_andnot_ps(positive, _mm_load_ps(&this->negativeScale[first])));
+    __m128 x = _mm_mul_ps(offset, scale);
+    x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+    _mm_store_ps(&this->normalized[first], x);
+#elif defined(__ARM_NEON)
+    float32x4_t offset = vsubq_f32(vcvtq_f32_s32(vmovl_s16(vld1_s16(raw))), vld1q_f32(&this->center[first]));
+    uint32x4_t positive = vcgeq_f32(offset, vdupq_n_f32(0.0f));
+    float32x4_t scale = vbslq_f32(positive, vld1q_f32(&this->positiveScale[first]), vld1q_f32(&this->negativeScale[first]));
+    float32x4_t x = vmulq_f32(offset, scale);
+    x = vminq_f32(vmaxq_f32(x, vdupq_n_f32(-1.0f)), vdupq_n_f32(1.0f));
+    vst1q_f32(&this->normalized[first], x);
+#else
+    for (size_t axis = first; axis < first + LANES; axis++)
+    {
+        float offset = raw[axis - first] - this->center[axis];
+        float x = offset * (offset >= 0.0f ? this->positiveScale[axis] : this->negativeScale[axis]);
+        this->normalized[axis] = std::fmin(std::fmax(x, -1.0f), 1.0f);
+    }
+#endif
+}
+
+/**
+ *  @brief Applies deadzone, curve and inversion to four normalized axes.
+ *  @param first The index of the first axis in the block
+ */
+void AxisProcessor::shapeBlock(size_t first)
+{
+#if defined(__SSE2__)
+    __m128 signMask = _mm_set1_ps(-0.0f);
+    __m128 x = _mm_load_ps(&this->normalized[first]);
+    __m128 sign = _mm_and_ps(x, signMask);
+    __m128 magnitude = _mm_andnot_ps(signMask, x);
+    magnitude = _mm_mul_ps(_mm_sub_ps(magnitude, _mm_load_ps(&this->deadzone[first])), _mm_load_ps(&this->deadzoneScale[first]));
+    magnitude = _mm_min_ps(_mm_max_ps(magnitude, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    // Blend towards m^3: m + curve * (m^3 - m)
+    __m128 cubic = _mm_mul_ps(_mm_mul_ps(magnitude, magnitude), magnitude);
+    magnitude = _mm_add_ps(magnitude, _mm_mul_ps(_mm_load_ps(&this->curve[first]), _mm_sub_ps(cubic, magnitude)));
+    _mm_store_ps(&this->values[first], _mm_mul_ps(_mm_or_ps(magnitude, sign), _mm_load_ps(&this->gain[first])));
+#elif defined(__ARM_NEON)
+    float32x4_t x = vld1q_f32(&this->normalized[first]);
+    uint32x4_t sign = vandq_u32(vreinterpretq_u32_f32(x), vdupq_n_u32(0x80000000u));
+    float32x4_t magnitude = vmulq_f32(vsubq_f32(vabsq_f32(x), vld1q_f32(&this->deadzone[first])), vld1q_f32(&this->deadzoneScale[first]));
+    magnitude = vminq_f32(vmaxq_f32(magnitude, vdupq_n_f32(0.0f)), vdupq_n_f32(1.0f));
+    // Blend towards m^3: m + curve * (m^3 - m)
+    float32x4_t cubic = vmulq_f32(vmulq_f32(magnitude, magnitude), magnitude);
+    magnitude = vmlaq_f32(magnitude, vld1q_f32(&this->curve[first]), vsubq_f32(cubic, magnitude));
+    float32x4_t signedMagnitude = vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(magnitude), sign));
+    vst1q_f32(&this->values[first], vmulq_f32(signedMagnitude, vld1q_f32(&this->gain[first])));
+#else
+    for (size_t axis = first; axis < first + LANES; axis++)
+    {
+        float x = this->normalized[axis];
+        float magnitude = (std::fabs(x) - this->deadzone[axis]) * this->deadzoneScale[axis];
+        magnitude = std::fmin(std::fmax(magnitude, 0.0f), 1.0f);
+        magnitude += this->curve[axis] * (magnitude * magnitude * magnitude - magnitude);
+        this->values[axis] = std::copysign(magnitude, x) * this->gain[axis];
+    }
+#endif
+}
+
+/**
+ *  @brief Rescales one radial pair inside normalized.
+ *  @param pair The pair
+ */
+void AxisProcessor::applyRadial(const RadialPair &pair)
+{
+    float x = this->normalized[pair.xAxis];
+    float y = this->normalized[pair.yAxis];
+    float radius = std::sqrt(x * x + y * y);
+    float factor = 0.0f;
+    if (radius > pair.deadzone)
+        factor = std::fmin((radius - pair.deadzone) * pair.scale, 1.0f) / radius;
+    this->normalized[pair.xAxis] = x * factor;
+    this->normalized[pair.yAxis] = y * factor;
+}
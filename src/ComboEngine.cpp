@@ -0,0 +1,409 @@
+#include "../include/gamepad/ComboEngine.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+// Longest chord or sequence, keeps step counts in a byte
+static constexpr size_t MAX_STEPS = 64;
+
+/**
+ *  @brief Initializes a ComboEngine without patterns.
+ *  @return The created ComboEngine object
+ */
+ComboEngine::ComboEngine()
+{
+    this->compiled = true;
+    this->handler = nullptr;
+    this->context = nullptr;
+}
+
+/**
+ *  @brief Adds a pattern matching when every button is held at once.
+ *  @param buttons The buttons, at most 64
+ *  @param window Longest time between the first and last press, 0 for any
+ *  @return The combo id, -1 if the pattern is invalid or the engine is full
+ */
+int ComboEngine::addChord(std::initializer_list<uint8_t> buttons, std::chrono::milliseconds window)
+{
+    Pattern pattern{};
+    pattern.type = ComboType::CHORD;
+    pattern.windowMs = (uint32_t)window.count();
+    return this->addPattern(pattern, buttons);
+}
+
+/**
+ *  @brief Adds a pattern matching buttons pressed in order.
+ *  @param buttons The buttons, at most 64
+ *  @param maxGap Longest time between two consecutive presses
+ *  @return The combo id, -1 if the pattern is invalid or the engine is full
+ */
+int ComboEngine::addSequence(std::initializer_list<uint8_t> buttons, std::chrono::milliseconds maxGap)
+{
+    Pattern pattern{};
+    pattern.type = ComboType::SEQUENCE;
+    pattern.windowMs = (uint32_t)maxGap.count();
+    return this->addPattern(pattern, buttons);
+}
+
+/**
+ *  @brief Adds a pattern matching two presses of the same button.
+ *  @param button The button
+ *  @param window Longest time between the two presses
+ *  @return The combo id, -1 if the engine is full
+ */
+int ComboEngine::addDoubleTap(uint8_t button, std::chrono::milliseconds window)
+{
+    return this->addSequence({button, button}, window);
+}
+
+/**
+ *  @brief Adds a pattern matching a button held for a duration.
+ *  @param button The button
+ *  @param duration How long it must be held
+ *  @return The combo id, -1 if the engine is full
+ */
+int ComboEngine::addHold(uint8_t button, std::chrono::milliseconds duration)
+{
+    Pattern pattern{};
+    pattern.type = ComboType::HOLD;
+    pattern.control = button;
+    pattern.windowMs = (uint32_t)duration.count();
+    return this->addPattern(pattern, {});
+}
+
+/**
+ *  @brief Adds a pattern matching an axis flicked from rest past a threshold.
+ *  @param axis The axis
+ *  @param threshold Value to reach, its sign gives the direction
+ *  @param within Longest time from leaving rest to reaching the threshold
+ *  @return The combo id, -1 if the threshold is 0 or the engine is full
+ */
+int ComboEngine::addFlick(uint8_t axis, short threshold, std::chrono::milliseconds within)
+{
+    if (axis >= GamepadState::MAX_AXES || threshold == 0)
+        return -1;
+    Pattern pattern{};
+    pattern.type = ComboType::FLICK;
+    pattern.control = axis;
+    pattern.threshold = threshold;
+    pattern.windowMs = (uint32_t)within.count();
+    return this->addPattern(pattern, {});
+}
+
+/**
+ *  @brief Sets the handler called for every match, replacing any previous one.
+ *  @param handler The handler, nullptr to remove
+ *  @param context Passed back to the handler
+ */
+void ComboEngine::onMatch(MatchHandler handler, void *context)
+{
+    this->handler = handler;
+    this->context = context;
+}
+
+/**
+ *  @brief Advances the patterns using the event's button or axis.
+ *  @param event The decoded event, init events only update the held buttons
+ */
+void ComboEngine::feed(const JSEvent &event)
+{
+    if (!this->compiled)
+        this->compile();
+    // Holds complete with time, not with an event of their own
+    if (!this->armedHolds.empty())
+        this->update(event.time);
+    uint8_t type = event.type & ~EVENT_INIT;
+    bool init = event.type & EVENT_INIT;
+    if (type == EVENT_BUTTON)
+    {
+        if (init)
+        {
+            // Already held when the stream opened, it isn't a press
+            if (event.value)
+                this->held.set(event.number);
+            else
+                this->held.reset(event.number);
+            this->pressMs[event.number] = event.time;
+            return;
+        }
+        this->feedButton(event.number, event.value != 0, event.time);
+    }
+    else if (type == EVENT_AXIS && event.number < GamepadState::MAX_AXES)
+    {
+        this->feedAxis(event.number, event.value, event.time);
+    }
+}
+
+/**
+ *  @brief Advances the patterns for a batch of events.
+ *  @param events Pointer to the first event
+ *  @param count The number of events
+ */
+void ComboEngine::feed(const JSEvent *events, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        this->feed(events[i]);
+}
+
+/**
+ *  @brief Lets holds match without waiting for another event.
+ *  @param time The current time on the events' clock, in ms
+ */
+void ComboEngine::update(uint32_t time)
+{
+    for (size_t i = this->armedHolds.size(); i-- > 0;)
+    {
+        Pattern &pattern = this->patterns[this->armedHolds[i]];
+        if (time - pattern.lastMs < pattern.windowMs)
+            continue;
+        pattern.progress = 0;
+        size_t combo = this->armedHolds[i];
+        this->armedHolds[i] = this->armedHolds.back();
+        this->armedHolds.pop_back();
+        this->match(combo, time);
+    }
+}
+
+/**
+ *  @brief Forgets the matches reported so far, e.g. once per frame.
+ */
+void ComboEngine::clearMatches()
+{
+    this->matched.clear();
+}
+
+/**
+ *  @brief Drops the progress of every pattern, e.g. after a reconnect.
+ */
+void ComboEngine::reset()
+{
+    for (Pattern &pattern : this->patterns)
+        pattern.progress = 0;
+    this->armedHolds.clear();
+    this->held.clear();
+}
+
+/**
+ *  @brief Appends a pattern and marks the index stale.
+ *  @param pattern The pattern
+ *  @param buttons Its steps
+ *  @return The combo id, -1 if the engine is full
+ */
+int ComboEngine::addPattern(Pattern pattern, std::initializer_list<uint8_t> buttons)
+{
+    bool stepped = pattern.type == ComboType::CHORD || pattern.type == ComboType::SEQUENCE;
+    if (this->patterns.size() == MAX_COMBOS || (stepped && (buttons.size() == 0 || buttons.size() > MAX_STEPS)))
+        return -1;
+    pattern.first = (uint16_t)this->steps.size();
+    pattern.length = (uint8_t)buttons.size();
+    this->steps.insert(this->steps.end(), buttons.begin(), buttons.end());
+    this->patterns.push_back(pattern);
+    this->compiled = false;
+    return (int)this->patterns.size() - 1;
+}
+
+/**
+ *  @brief Rebuilds the per-control index from the registered patterns.
+ */
+void ComboEngine::compile()
+{
+    this->fallback.assign(this->steps.size(), 0);
+    std::vector<std::vector<uint16_t>> byButton(GamepadState::MAX_BUTTONS);
+    std::vector<std::vector<uint16_t>> byAxis(GamepadState::MAX_AXES);
+    size_t holds = 0;
+    for (size_t combo = 0; combo < this->patterns.size(); combo++)
+    {
+        const Pattern &pattern = this->patterns[combo];
+        switch (pattern.type)
+        {
+        case ComboType::HOLD:
+            byButton[pattern.control].push_back((uint16_t)combo);
+            holds++;
+            break;
+        case ComboType::FLICK:
+            byAxis[pattern.control].push_back((uint16_t)combo);
+            break;
+        default:
+            if (pattern.type == ComboType::SEQUENCE)
+                this->compileFallback(pattern);
+            for (size_t step = pattern.first; step < pattern.first + pattern.length; step++)
+            {
+                // A button used twice (e.g. a double tap) still evaluates the pattern once
+                std::vector<uint16_t> &list = byButton[this->steps[step]];
+                if (list.empty() || list.back() != combo)
+                    list.push_back((uint16_t)combo);
+            }
+            break;
+        }
+    }
+
+    this->buttonIndex.clear();
+    for (size_t button = 0; button < GamepadState::MAX_BUTTONS; button++)
+    {
+        this->buttonOffsets[button] = (uint32_t)this->buttonIndex.size();
+        this->buttonIndex.insert(this->buttonIndex.end(), byButton[button].begin(), byButton[button].end());
+    }
+    this->buttonOffsets[GamepadState::MAX_BUTTONS] = (uint32_t)this->buttonIndex.size();
+    this->axisIndex.clear();
+    for (size_t axis = 0; axis < GamepadState::MAX_AXES; axis++)
+    {
+        this->axisOffsets[axis] = (uint32_t)this->axisIndex.size();
+        this->axisIndex.insert(this->axisIndex.end(), byAxis[axis].begin(), byAxis[axis].end());
+    }
+    this->axisOffsets[GamepadState::MAX_AXES] = (uint32_t)this->axisIndex.size();
+    // Every hold is armed at most once, so feeding never allocates
+    this->armedHolds.reserve(holds);
+    this->compiled = true;
+}
+
+/**
+ *  @brief Computes the fallback entries of a sequence.
+ *  @param pattern The SEQUENCE pattern
+ */
+void ComboEngine::compileFallback(const Pattern &pattern)
+{
+    const uint8_t *steps = &this->steps[pattern.first];
+    uint8_t *fallback = &this->fallback[pattern.first];
+    fallback[0] = 0;
+    uint8_t matched = 0;
+    for (size_t step = 1; step < pattern.length; step++)
+    {
+        while (matched && steps[step] != steps[matched])
+            matched = fallback[matched - 1];
+        if (steps[step] == steps[matched])
+            matched++;
+        fallback[step] = matched;
+    }
+}
+
+/**
+ *  @brief Advances the patterns using a button.
+ *  @param button The button
+ *  @param pressed Whether it went down
+ *  @param time The event time in ms
+ */
+void ComboEngine::feedButton(uint8_t button, bool pressed, uint32_t time)
+{
+    // Autorepeat or a duplicate report, not a new press
+    if (pressed == this->held.test(button))
+        return;
+    if (pressed)
+    {
+        this->held.set(button);
+        this->pressMs[button] = time;
+    }
+    else
+    {
+        this->held.reset(button);
+    }
+
+    for (uint32_t i = this->buttonOffsets[button]; i < this->buttonOffsets[button + 1]; i++)
+    {
+        size_t combo = this->buttonIndex[i];
+        Pattern &pattern = this->patterns[combo];
+        const uint8_t *steps = &this->steps[pattern.first];
+        switch (pattern.type)
+        {
+        case ComboType::CHORD:
+        {
+            if (!pressed)
+            {
+                // Rearm once the chord is broken
+                pattern.progress = 0;
+                break;
+            }
+            if (pattern.progress)
+                break;
+            uint32_t earliest = time;
+            bool complete = true;
+            for (size_t step = 0; step < pattern.length && complete; step++)
+            {
+                complete = this->held.test(steps[step]);
+                if (time - this->pressMs[steps[step]] > time - earliest)
+                    earliest = this->pressMs[steps[step]];
+            }
+            if (complete && (!pattern.windowMs || time - earliest <= pattern.windowMs))
+            {
+                pattern.progress = 1;
+                this->match(combo, time);
+            }
+            break;
+        }
+        case ComboType::SEQUENCE:
+            if (!pressed)
+                break;
+            if (pattern.progress && time - pattern.lastMs > pattern.windowMs)
+                pattern.progress = 0;
+            // Out of order, this press may still continue a shorter prefix ({A, A, B} after A, A, A)
+            while (pattern.progress && steps[pattern.progress] != button)
+                pattern.progress = this->fallback[pattern.first + pattern.progress - 1];
+            if (steps[pattern.progress] == button)
+                pattern.progress++;
+            pattern.lastMs = time;
+            if (pattern.progress == pattern.length)
+            {
+                pattern.progress = 0;
+                this->match(combo, time);
+            }
+            break;
+        case ComboType::HOLD:
+            if (pressed)
+            {
+                pattern.progress = 1;
+                pattern.lastMs = time;
+                this->armedHolds.push_back((uint16_t)combo);
+            }
+            else if (pattern.progress)
+            {
+                pattern.progress = 0;
+                auto armed = std::find(this->armedHolds.begin(), this->armedHolds.end(), (uint16_t)combo);
+                *armed = this->armedHolds.back();
+                this->armedHolds.pop_back();
+            }
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+/**
+ *  @brief Advances the patterns using an axis.
+ *  @param axis The axis
+ *  @param value The new value
+ *  @param time The event time in ms
+ */
+void ComboEngine::feedAxis(uint8_t axis, short value, uint32_t time)
+{
+    for (uint32_t i = this->axisOffsets[axis]; i < this->axisOffsets[axis + 1]; i++)
+    {
+        size_t combo = this->axisIndex[i];
+        Pattern &pattern = this->patterns[combo];
+        int target = pattern.threshold > 0 ? pattern.threshold : -(int)pattern.threshold;
+        int directed = pattern.threshold > 0 ? value : -(int)value;
+        if (std::abs((int)value) <= target / 4)
+        {
+            // Still at rest, the flick is timed from the last moment here
+            pattern.progress = 1;
+            pattern.lastMs = time;
+        }
+        else if (pattern.progress && directed >= target)
+        {
+            pattern.progress = 0;
+            if (time - pattern.lastMs <= pattern.windowMs)
+                this->match(combo, time);
+        }
+    }
+}
+
+/**
+ *  @brief Records and reports a match.
+ *  @param combo The combo id
+ *  @param time The time of the completing event
+ */
+void ComboEngine::match(size_t combo, uint32_t time)
+{
+    this->matched.set(combo);
+    if (this->handler)
+        this->handler(this->context, (int)combo, time);
+}
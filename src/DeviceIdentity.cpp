@@ -0,0 +1,101 @@
+#include "../include/gamepad/DeviceIdentity.h"
+
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <linux/input.h>
+#include <linux/joystick.h>
+#include <dirent.h>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+
+// udev's stable names for input devices, one link per node
+static const char *BY_ID_DIRECTORY = "/dev/input/by-id";
+
+/**
+ *  @brief Reads a hexadecimal id from the sysfs directory of a character device.
+ *  @param st The stat of the device node
+ *  @param file The file below device/id, e.g. "vendor"
+ *  @return The id, 0 if it cannot be read
+ */
+static uint16_t readSysfsId(const struct stat &st, const char *file)
+{
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/dev/char/%u:%u/device/id/%s", major(st.st_rdev), minor(st.st_rdev), file);
+    FILE *stream = fopen(path, "r");
+    if (!stream)
+        return 0;
+    unsigned int value = 0;
+    if (fscanf(stream, "%x", &value) != 1)
+        value = 0;
+    fclose(stream);
+    return (uint16_t)value;
+}
+
+/**
+ *  @brief Reads the identity of an open device node.
+ *  @param fd The file descriptor of a 'jsX' or 'eventX' node
+ *  @return The identity without stablePath, invalid if the node answers neither API
+ */
+DeviceIdentity DeviceIdentity::query(int fd)
+{
+    DeviceIdentity identity;
+    char name[256] = {};
+    struct input_id id;
+    if (ioctl(fd, EVIOCGNAME(sizeof(name) - 1), name) >= 0)
+    {
+        identity.name = name;
+        if (ioctl(fd, EVIOCGID, &id) >= 0)
+        {
+            identity.busType = id.bustype;
+            identity.vendor = id.vendor;
+            identity.product = id.product;
+            identity.version = id.version;
+        }
+        return identity;
+    }
+    if (ioctl(fd, JSIOCGNAME(sizeof(name) - 1), name) < 0)
+        return identity;
+    identity.name = name;
+    // joydev has no id ioctl, the parent input device exposes them in sysfs
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISCHR(st.st_mode))
+    {
+        identity.busType = readSysfsId(st, "bustype");
+        identity.vendor = readSysfsId(st, "vendor");
+        identity.product = readSysfsId(st, "product");
+        identity.version = readSysfsId(st, "version");
+    }
+    return identity;
+}
+
+/**
+ *  @brief Finds the /dev/input/by-id link pointing at a device node.
+ *  @param path The path to the node
+ *  @return The link, empty if there is none (e.g. most Bluetooth pads)
+ */
+std::string DeviceIdentity::findStablePath(const std::string &path)
+{
+    char target[PATH_MAX];
+    if (!realpath(path.c_str(), target))
+        return std::string();
+    DIR *directory = opendir(BY_ID_DIRECTORY);
+    if (!directory)
+        return std::string();
+    std::string found;
+    char resolved[PATH_MAX];
+    while (struct dirent *entry = readdir(directory))
+    {
+        if (entry->d_name[0] == '.')
+            continue;
+        std::string link = std::string(BY_ID_DIRECTORY) + "/" + entry->d_name;
+        if (realpath(link.c_str(), resolved) && std::string(resolved) == target)
+        {
+            found = link;
+            break;
+        }
+    }
+    closedir(directory);
+    return found;
+}
@@ -0,0 +1,323 @@
+#include "../include/gamepad/EvdevSource.h"
+
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+/**
+ *  @brief Checks a bit in an evdev capability bitmap.
+ *  @param bits The bitmap
+ *  @param bit The bit to check
+ *  @return true if set
+ */
+static bool testBit(const unsigned long *bits, size_t bit)
+{
+    const size_t width = sizeof(unsigned long) * 8;
+    return (bits[bit / width] >> (bit % width)) & 1;
+}
+
+/**
+ *  @brief Initializes an EvdevSource without an open device.
+ *  @return The created EvdevSource object
+ */
+EvdevSource::EvdevSource()
+{
+    this->fd = -1;
+    this->axisCount = 0;
+    this->buttonCount = 0;
+    this->pendingTimeUs = 0;
+    this->pendingPosition = 0;
+    this->stashPosition = 0;
+    this->stashCount = 0;
+    this->frameOpen = false;
+    this->dropping = false;
+    this->axisMap.fill(UNMAPPED);
+    this->buttonMap.fill(UNMAPPED);
+}
+
+/**
+ *  @brief Takes ownership of an open '/dev/input/eventX' file descriptor.
+ *  @param fd The file descriptor
+ *  @details Numbers axes and buttons the same way joydev does, so indices match the 'jsX' node,
+ *  @details and queues init events describing the current state.
+ */
+void EvdevSource::adopt(int fd)
+{
+    const size_t width = sizeof(unsigned long) * 8;
+    unsigned long absBits[(ABS_CNT + width - 1) / width] = {};
+    unsigned long keyBits[(KEY_CNT + width - 1) / width] = {};
+    ioctl(fd, EVIOCGBIT(EV_ABS, sizeof(absBits)), absBits);
+    ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(keyBits)), keyBits);
+
+    // Event timestamps default to CLOCK_REALTIME, which the init events and every other
+    // source of this library don't use
+    int clock = CLOCK_MONOTONIC;
+    ioctl(fd, EVIOCSCLOCKID, &clock);
+
+    this->fd = fd;
+    this->dropping = false;
+    this->stashPosition = 0;
+    this->stashCount = 0;
+    this->axisCount = 0;
+    this->buttonCount = 0;
+    this->axisMap.fill(UNMAPPED);
+    this->buttonMap.fill(UNMAPPED);
+
+    for (size_t code = 0; code < ABS_CNT && this->axisCount < GamepadState::MAX_AXES; code++)
+    {
+        if (!testBit(absBits, code))
+            continue;
+        struct input_absinfo info{};
+        ioctl(fd, EVIOCGABS(code), &info);
+        this->ranges[this->axisCount] = AxisRange{info.minimum, info.maximum};
+        this->axisMap[code] = this->axisCount++;
+    }
+    // joydev numbers BTN_JOYSTICK and up first, then BTN_MISC up to BTN_JOYSTICK
+    for (size_t code = BTN_JOYSTICK; code < KEY_CNT && this->buttonCount < GamepadState::MAX_BUTTONS; code++)
+    {
+        if (testBit(keyBits, code))
+            this->buttonMap[code - BTN_MISC] = this->buttonCount++;
+    }
+    for (size_t code = BTN_MISC; code < BTN_JOYSTICK && this->buttonCount < GamepadState::MAX_BUTTONS; code++)
+    {
+        if (testBit(keyBits, code))
+            this->buttonMap[code - BTN_MISC] = this->buttonCount++;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    this->queueState((uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000);
+}
+
+/**
+ *  @brief Reads input_events and translates them into JSEvents.
+ *  @param buf A buffer to read JSEvents into
+ *  @param size The size of the buffer in bytes
+ *  @return The number of bytes of JSEvents produced, or -1 with errno set
+ *  @details Axes are rescaled from the device's range to [-32767, 32767].
+ *  @details Every SYN_REPORT closing a report with mapped events becomes an EVENT_SYNC.
+ */
+ssize_t EvdevSource::read(void *buf, size_t size)
+{
+    JSEvent *out = static_cast<JSEvent *>(buf);
+    size_t wanted = size / sizeof(JSEvent);
+    size_t produced = 0;
+    // Grows to the largest batch once, then reads never allocate
+    if (this->timesUs.size() < wanted)
+        this->timesUs.resize(wanted);
+
+    // Init events go first, like joydev's startup events
+    this->emitPending(out, produced, wanted);
+
+    while (produced < wanted)
+    {
+        bool drained = false;
+        if (this->stashPosition == this->stashCount)
+        {
+            // Every input_event yields at most one JSEvent, never read more than fits
+            size_t count = wanted - produced < this->stash.size() ? wanted - produced : this->stash.size();
+            ssize_t bytesRead = ::read(this->fd, this->stash.data(), count * sizeof(struct input_event));
+            if (bytesRead <= 0)
+            {
+                if (produced > 0)
+                    break;
+                return bytesRead;
+            }
+            this->stashPosition = 0;
+            this->stashCount = bytesRead / sizeof(struct input_event);
+            drained = (size_t)bytesRead < count * sizeof(struct input_event);
+        }
+
+        // A resync can fill the buffer with init events, what is left stays for the next read()
+        while (this->stashPosition < this->stashCount && produced < wanted)
+        {
+            const struct input_event &event = this->stash[this->stashPosition++];
+            uint64_t timeUs = (uint64_t)event.input_event_sec * 1000000 + event.input_event_usec;
+            uint time = (uint)(timeUs / 1000);
+            if (this->dropping)
+            {
+                // The kernel dropped part of this report, what is left of it is inconsistent
+                if (event.type == EV_SYN && event.code == SYN_REPORT)
+                {
+                    this->dropping = false;
+                    this->queueState(timeUs);
+                    this->emitPending(out, produced, wanted);
+                }
+                continue;
+            }
+            if (event.type == EV_ABS && event.code < ABS_CNT && this->axisMap[event.code] != UNMAPPED)
+            {
+                uint16_t axis = this->axisMap[event.code];
+                this->timesUs[produced] = timeUs;
+                out[produced++] = JSEvent{time, this->scale(axis, event.value), EVENT_AXIS, (uint8_t)axis};
+                this->frameOpen = true;
+            }
+            else if (event.type == EV_KEY && event.code >= BTN_MISC && event.code < KEY_CNT &&
+                     this->buttonMap[event.code - BTN_MISC] != UNMAPPED && event.value != 2)
+            {
+                // Autorepeat (value 2) is ignored, as joydev does
+                uint16_t button = this->buttonMap[event.code - BTN_MISC];
+                this->timesUs[produced] = timeUs;
+                out[produced++] = JSEvent{time, (short)event.value, EVENT_BUTTON, (uint8_t)button};
+                this->frameOpen = true;
+            }
+            else if (event.type == EV_SYN && event.code == SYN_REPORT && this->frameOpen)
+            {
+                // Mark the report boundary so Gamepad can apply the report as one frame
+                this->timesUs[produced] = timeUs;
+                out[produced++] = JSEvent{time, 0, EVENT_SYNC, 0};
+                this->frameOpen = false;
+            }
+            else if (event.type == EV_SYN && event.code == SYN_DROPPED)
+            {
+                // Kernel buffer overran, resynchronize once the broken report is over
+                this->dropping = true;
+            }
+        }
+        if (drained)
+            break;
+    }
+    if (produced == 0)
+    {
+        // Only SYN reports for unmapped codes were read
+        errno = EAGAIN;
+        return -1;
+    }
+    return produced * sizeof(JSEvent);
+}
+
+/**
+ *  @brief Checks whether translated events are buffered, which the fd won't signal.
+ *  @return true if init events or input_events left over by the last read() are waiting
+ */
+bool EvdevSource::hasPending()
+{
+    return this->pendingPosition < this->pending.size() || this->stashPosition < this->stashCount;
+}
+
+/**
+ *  @brief Gives the full-precision timestamp of an event produced by the last read().
+ *  @param index The position of the event in the buffer passed to read()
+ *  @return CLOCK_MONOTONIC time in microseconds, JSEvent::time only keeps milliseconds
+ */
+uint64_t EvdevSource::getTimeUs(size_t index)
+{
+    return index < this->timesUs.size() ? this->timesUs[index] : 0;
+}
+
+/**
+ *  @brief Closes the device.
+ *  @return The output of the close() system call, 0 if it was not open
+ */
+int EvdevSource::close()
+{
+    this->pending.clear();
+    this->pendingPosition = 0;
+    this->stashPosition = 0;
+    this->stashCount = 0;
+    this->frameOpen = false;
+    this->dropping = false;
+    int oldFd = this->fd;
+    this->fd = -1;
+    if (oldFd >= 0)
+        return ::close(oldFd);
+    return 0;
+}
+
+/**
+ *  @brief Gives the device file descriptor.
+ *  @return The file descriptor, -1 if not open
+ */
+int EvdevSource::getFd()
+{
+    return this->fd;
+}
+
+/**
+ *  @brief Gives the number of absolute axes on the device.
+ *  @return The axis count
+ */
+uint16_t EvdevSource::getAxisCount()
+{
+    return this->axisCount;
+}
+
+/**
+ *  @brief Gives the number of buttons on the device.
+ *  @return The button count
+ */
+uint16_t EvdevSource::getButtonCount()
+{
+    return this->buttonCount;
+}
+
+/**
+ *  @brief Queues init events for the current state of every axis and button.
+ *  @param timeUs Timestamp for the events, in microseconds
+ */
+void EvdevSource::queueState(uint64_t timeUs)
+{
+    uint time = (uint)(timeUs / 1000);
+    const size_t width = sizeof(unsigned long) * 8;
+    unsigned long keyState[(KEY_CNT + width - 1) / width] = {};
+    ioctl(this->fd, EVIOCGKEY(sizeof(keyState)), keyState);
+
+    this->pending.clear();
+    this->pendingPosition = 0;
+    this->pendingTimeUs = timeUs;
+    for (size_t code = BTN_MISC; code < KEY_CNT; code++)
+    {
+        uint16_t button = this->buttonMap[code - BTN_MISC];
+        if (button != UNMAPPED)
+            this->pending.push_back(JSEvent{time, (short)testBit(keyState, code), EVENT_BUTTON | EVENT_INIT, (uint8_t)button});
+    }
+    for (size_t code = 0; code < ABS_CNT; code++)
+    {
+        uint16_t axis = this->axisMap[code];
+        if (axis == UNMAPPED)
+            continue;
+        struct input_absinfo info{};
+        ioctl(this->fd, EVIOCGABS(code), &info);
+        this->pending.push_back(JSEvent{time, this->scale(axis, info.value), EVENT_AXIS | EVENT_INIT, (uint8_t)axis});
+    }
+    // The whole state forms one frame, which also closes any report cut short by SYN_DROPPED
+    if (!this->pending.empty())
+        this->pending.push_back(JSEvent{time, 0, EVENT_SYNC | EVENT_INIT, 0});
+    this->frameOpen = false;
+}
+
+/**
+ *  @brief Copies queued init events into a read() buffer.
+ *  @param out The buffer
+ *  @param produced Events already in the buffer, updated
+ *  @param wanted Capacity of the buffer in events
+ */
+void EvdevSource::emitPending(JSEvent *out, size_t &produced, size_t wanted)
+{
+    while (produced < wanted && this->pendingPosition < this->pending.size())
+    {
+        this->timesUs[produced] = this->pendingTimeUs;
+        out[produced++] = this->pending[this->pendingPosition++];
+    }
+}
+
+/**
+ *  @brief Rescales a raw axis value to the joystick API range.
+ *  @param axis The axis index
+ *  @param value The raw value
+ *  @return The scaled value
+ */
+short EvdevSource::scale(uint16_t axis, int32_t value)
+{
+    const AxisRange &range = this->ranges[axis];
+    if (range.maximum <= range.minimum)
+        return (short)(value < -32767 ? -32767 : value > 32767 ? 32767 : value);
+    int64_t scaled = ((int64_t)value - range.minimum) * 65534 / ((int64_t)range.maximum - range.minimum) - 32767;
+    if (scaled < -32767)
+        scaled = -32767;
+    else if (scaled > 32767)
+        scaled = 32767;
+    return (short)scaled;
+}
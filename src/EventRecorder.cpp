@@ -0,0 +1,182 @@
+#include "../include/gamepad/EventRecorder.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+
+/**
+ *  @brief Writes a whole buffer, retrying short writes.
+ *  @param fd The file descriptor
+ *  @param data The bytes to write
+ *  @param size The number of bytes
+ *  @return 0 on success, -1 on failure with errno set
+ */
+static int writeAll(int fd, const void *data, size_t size)
+{
+    const char *ptr = static_cast<const char *>(data);
+    while (size > 0)
+    {
+        ssize_t written = write(fd, ptr, size);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        ptr += written;
+        size -= written;
+    }
+    return 0;
+}
+
+/**
+ *  @brief Initializes an EventRecorder without an open file.
+ *  @return The created EventRecorder object
+ */
+EventRecorder::EventRecorder()
+{
+    this->fd = -1;
+    this->buffered = 0;
+    this->flushed = 0;
+    this->head = 0;
+    this->tail = 0;
+    this->writeErrno = 0;
+    this->stopping = false;
+}
+
+/**
+ *  @brief Destructor for EventRecorder object, flushes and closes the file
+ */
+EventRecorder::~EventRecorder()
+{
+    this->close();
+}
+
+/**
+ *  @brief Creates or truncates a recording and writes its header.
+ *  @param path The path to the recording file
+ *  @param axisCount Axes reported by the device being recorded
+ *  @param buttonCount Buttons reported by the device being recorded
+ *  @return 0 on success, -1 on failure with errno set
+ */
+int EventRecorder::open(const std::string &path, uint16_t axisCount, uint16_t buttonCount)
+{
+    this->close();
+    // O_APPEND keeps the file strictly append-only
+    this->fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (this->fd < 0)
+        return -1;
+    RecordingHeader header;
+    header.axisCount = axisCount;
+    header.buttonCount = buttonCount;
+    if (writeAll(this->fd, &header, sizeof(header)) < 0)
+    {
+        int err = errno;
+        this->close();
+        errno = err;
+        return -1;
+    }
+    this->writeErrno = 0;
+    this->stopping = false;
+    this->writerThread = std::thread([this]()
+                                     { this->writerLoop(); });
+    return 0;
+}
+
+/**
+ *  @brief Writes all buffered events to the file and waits until they are written.
+ *  @return 0 on success, -1 on failure with errno set, including earlier failed writes
+ */
+int EventRecorder::flush()
+{
+    if (this->buffered > 0)
+        this->handOff();
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->changed.wait(lock, [this]()
+                       { return this->head == this->tail; });
+    if (this->writeErrno == 0)
+        return 0;
+    errno = this->writeErrno;
+    return -1;
+}
+
+/**
+ *  @brief Flushes and closes the file.
+ *  @return 0 on success, -1 on failure with errno set
+ */
+int EventRecorder::close()
+{
+    if (this->fd < 0)
+        return 0;
+    int result = 0;
+    if (this->writerThread.joinable())
+    {
+        result = this->flush();
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->stopping = true;
+        }
+        this->changed.notify_all();
+        this->writerThread.join();
+    }
+    if (::close(this->fd) < 0)
+        result = -1;
+    this->fd = -1;
+    return result;
+}
+
+/**
+ *  @brief Gives the number of events recorded so far.
+ *  @return The event count
+ */
+uint64_t EventRecorder::getCount()
+{
+    return this->flushed + this->buffered;
+}
+
+/**
+ *  @brief Queues the buffer being filled and moves on to the next one.
+ */
+void EventRecorder::handOff()
+{
+    if (this->fd < 0)
+    {
+        this->buffered = 0;
+        return;
+    }
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->counts[this->tail % BUFFER_COUNT] = this->buffered;
+    this->tail++;
+    this->flushed += this->buffered;
+    this->buffered = 0;
+    this->changed.notify_all();
+    // The next buffer may still be queued, only then does the disk hold the caller up
+    this->changed.wait(lock, [this]()
+                       { return this->tail - this->head < BUFFER_COUNT; });
+}
+
+/**
+ *  @brief Body of the writer thread.
+ */
+void EventRecorder::writerLoop()
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while (true)
+    {
+        this->changed.wait(lock, [this]()
+                           { return this->stopping || this->head != this->tail; });
+        if (this->head == this->tail)
+            return;
+        size_t index = this->head % BUFFER_COUNT;
+        size_t count = this->counts[index];
+        lock.unlock();
+        // Queued buffers are not touched by append() until head moves past them
+        int result = writeAll(this->fd, this->buffers[index].data(), count * sizeof(JSEvent));
+        int err = errno;
+        lock.lock();
+        if (result < 0 && this->writeErrno == 0)
+            this->writeErrno = err;
+        this->head++;
+        this->changed.notify_all();
+    }
+}
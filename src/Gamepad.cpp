@@ -1,130 +1,1056 @@
 #include "../include/gamepad/Gamepad.h"
 #include "../include/gamepad/JSEvent.h"
+#include "../include/gamepad/HotplugMonitor.h"
 
 #include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 #include <unistd.h>
 #include <chrono>
+#include <algorithm>
+
+/**
+ *  @brief Gives the current CLOCK_MONOTONIC time.
+ *  @return The time in nanoseconds
+ */
+static uint64_t monotonicNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+/**
+ *  @brief Initializes a Gamepad object.
+ *  @param path The path to the 'jsX' or 'eventX' input file stream as a string
+ *  @return The created Gamepad object
+ */
+Gamepad::Gamepad(const std::string &path)
+{
+    this->reconnecting.store(false);
+    this->status.store(GamepadStatus::OK);
+    this->readerActive.store(false);
+    this->readerWakeFd = -1;
+    this->readerReadyFd.store(-1);
+    this->openGeneration.store(0);
+    this->openedCounts.store(0);
+    this->appliedGeneration = 0;
+    this->primed = false;
+    this->initEvents = 0;
+    this->lastEventUs = 0;
+    this->openStream(path);
+    this->refresh();
+}
 
 /**
  *  @brief Initializes a Gamepad object.
- *  @param path The path to the 'jsX' input file stream as a string
+ *  @param index The index of the joystick to be initialized
  *  @return The created Gamepad object
  */
-Gamepad::Gamepad(const std::string &path)
+Gamepad::Gamepad(int index) : Gamepad("/dev/input/js" + std::to_string(index)) {}
+
+/**
+ *  @brief Destructor for Gamepad object, ensures cleanup
+ */
+Gamepad::~Gamepad()
+{
+    this->stopReader();
+    this->closeStream();
+    if (this->readerWakeFd >= 0)
+        close(this->readerWakeFd);
+    if (this->readerReadyFd.load() >= 0)
+        close(this->readerReadyFd.load());
+}
+
+/**
+ *  @brief Takes over the open device, cached state and threads of another Gamepad.
+ *  @param other The Gamepad to move from, left closed
+ *  @return The created Gamepad object
+ */
+Gamepad::Gamepad(Gamepad &&other)
+{
+    this->reconnecting.store(false);
+    this->readerActive.store(false);
+    this->readerWakeFd = -1;
+    this->readerReadyFd.store(-1);
+    this->moveFrom(other);
+}
+
+/**
+ *  @brief Closes this Gamepad and takes over the open device, cached state and threads of another.
+ *  @param other The Gamepad to move from, left closed
+ *  @return This Gamepad
+ */
+Gamepad &Gamepad::operator=(Gamepad &&other)
+{
+    if (this == &other)
+        return *this;
+    this->stopReader();
+    this->closeStream();
+    if (this->readerWakeFd >= 0)
+        close(this->readerWakeFd);
+    this->readerWakeFd = -1;
+    if (this->readerReadyFd.load() >= 0)
+        close(this->readerReadyFd.load());
+    this->readerReadyFd.store(-1);
+    this->moveFrom(other);
+    return *this;
+}
+
+/**
+ *  @brief Updates the state of the Gamepad, including errors.
+ *  @details If you wish to interact with the Gamepad iteratively or periodically,
+ *  @details call this before any logic.
+ */
+void Gamepad::refresh()
+{
+    // Changes are reported relative to the previous refresh only
+    this->clearChanges();
+    GAMEPAD_STAT(GamepadCounters::add(this->counters.refreshes, 1));
+    GAMEPAD_STAT(uint32_t nowMs = (uint32_t)(monotonicNs() / 1000000));
+
+    uint64_t nowNs = this->coalescer ? monotonicNs() : 0;
+
+    if (this->readerActive.load(std::memory_order_acquire))
+    {
+        // Background reader owns the fd, only apply what it queued
+        TimedEvent timed;
+        bool changed = this->syncOpened();
+        bool wasPrimed = this->primed;
+        size_t staged = 0;
+        while (this->ring->pop(timed))
+        {
+            GAMEPAD_STAT(this->counters.observeLag(nowMs, timed.event.time));
+            this->lastEventUs = timed.sourceUs;
+            changed = true;
+            if (!this->coalescer)
+            {
+                this->applyEvents(&timed.event, 1);
+                continue;
+            }
+            // Gathered into batches so a burst on one axis can be merged
+            this->eventBuffer[staged++] = timed.event;
+            if (staged == MAX_BATCH_SIZE)
+            {
+                this->applyCoalesced(staged, nowNs);
+                staged = 0;
+            }
+        }
+        if (this->coalescer)
+        {
+            this->applyCoalesced(staged, nowNs);
+            changed |= this->flushCoalesced(nowNs);
+        }
+        this->endBatch();
+        if (changed)
+            this->publishState();
+        this->notifyPrimed(wasPrimed);
+        return;
+    }
+
+    if (this->reconnecting.load())
+        // Still disconnected, no point in refreshing state
+        return;
+
+    ssize_t bytesRead = -1;
+    bool drained = false;
+    bool changed = this->syncOpened();
+    bool wasPrimed = this->primed;
+    size_t requested = this->batchSize * sizeof(JSEvent);
+    // Drain up to batchSize events per read() into eventBuffer
+    // read() updates errno to check status
+    GAMEPAD_STAT(uint64_t reads = 1);
+    while ((bytesRead = this->ownedRead(this->eventBuffer.data(), requested)) > 0)
+    {
+        size_t count = bytesRead / sizeof(JSEvent);
+        this->lastEventUs = this->source.getTimeUs(count - 1, this->eventBuffer[count - 1]);
+#if GAMEPAD_ENABLE_STATS
+        GamepadCounters::add(this->counters.eventsDrained, count);
+        for (size_t i = 0; i < count; i++)
+            this->counters.observeLag(nowMs, this->eventBuffer[i].time);
+#endif
+        if (this->coalescer)
+            this->applyCoalesced(count, nowNs);
+        else
+            this->applyEvents(this->eventBuffer.data(), count);
+        changed = true;
+        // Short read means the kernel queue is empty, skip the extra EAGAIN read()
+        if ((size_t)bytesRead < requested)
+        {
+            drained = true;
+            break;
+        }
+        GAMEPAD_STAT(reads++);
+    }
+    int err = drained ? EAGAIN : errno;
+#if GAMEPAD_ENABLE_STATS
+    if (!drained && bytesRead < 0 && err == EAGAIN)
+        GamepadCounters::add(this->counters.eagainHits, 1);
+    this->counters.lastRefreshReads.store(reads, std::memory_order_relaxed);
+    if (reads > this->counters.maxRefreshReads.load(std::memory_order_relaxed))
+        this->counters.maxRefreshReads.store(reads, std::memory_order_relaxed);
+#endif
+    if (this->coalescer && this->flushCoalesced(nowNs))
+        changed = true;
+    this->endBatch();
+    // The kernel queues init events ahead of everything else, so a drained queue is fully synced
+    if (err == EAGAIN && this->frameSize == 0)
+        this->primed = true;
+    // Publish once per refresh rather than once per event
+    if (changed)
+        this->publishState();
+    this->notifyPrimed(wasPrimed);
+    // Check for read errors
+    this->updateStatus(err);
+    if (this->getErr())
+    {
+        // Problem with controller, attempt reconnection
+        this->startReconnection();
+    }
+}
+
+/**
+ *  @brief Sleeps until the device has input or the timeout expires, then refreshes.
+ *  @param timeout Maximum time to wait, negative to wait indefinitely
+ *  @return true if the device had input ready, was reopened or held-back axis values came due, false on timeout or interruption
+ *  @details Replaces spinning on refresh(), the thread sleeps in ppoll() while idle.
+ */
+bool Gamepad::waitForEvent(std::chrono::microseconds timeout)
+{
+    int fd;
+    int64_t dueNs;
+    {
+        std::lock_guard<std::mutex> lock(this->fdMutex);
+        fd = this->source.getFd();
+        dueNs = this->source.nextDueNs();
+    }
+    // Read once, every decision below has to agree on the same state
+    bool reconnecting = this->reconnecting.load();
+    bool readerActive = this->readerActive.load();
+    // The fd only signals new input, held-back axis values need a refresh of their own
+    int64_t heldNs = this->getHeldDueNs();
+    bool held = heldNs >= 0 && (timeout.count() < 0 || heldNs < std::chrono::nanoseconds(timeout).count());
+    if (held)
+        timeout = std::chrono::microseconds((heldNs + 999) / 1000);
+    if (fd < 0 && !reconnecting && this->source.getType() != SOURCE_NONE)
+    {
+        // Memory and replay sources have no fd to poll, sleep until the next event is due
+        std::chrono::nanoseconds limit(timeout);
+        bool ready = dueNs >= 0 && (timeout.count() < 0 || dueNs <= limit.count());
+        std::chrono::nanoseconds wait = ready ? std::chrono::nanoseconds(dueNs) : limit;
+        // A finished source never becomes ready, don't block forever on it
+        if (wait.count() > 0)
+            std::this_thread::sleep_for(wait);
+        this->refresh();
+        return ready || held;
+    }
+    if (dueNs == 0)
+    {
+        // Already buffered in user space, the fd would not signal it
+        this->refresh();
+        return true;
+    }
+
+    struct pollfd pfds[2];
+    // A negative fd (disconnected) is ignored by ppoll()
+    pfds[0].fd = fd;
+    pfds[0].events = POLLIN;
+    pfds[0].revents = 0;
+    // While disconnected, the HotplugMonitor signals the reopen here, the reader consumes it itself
+    pfds[1].fd = reconnecting && !readerActive ? this->getReconnectFd() : -1;
+    pfds[1].events = POLLIN;
+    pfds[1].revents = 0;
+
+    struct timespec ts;
+    struct timespec *tsp = nullptr;
+    if (timeout.count() >= 0)
+    {
+        ts.tv_sec = timeout.count() / 1000000;
+        ts.tv_nsec = (timeout.count() % 1000000) * 1000;
+        tsp = &ts;
+    }
+    else if (pfds[0].fd < 0 && pfds[1].fd < 0)
+    {
+        // Nothing could ever wake ppoll(), don't block forever
+        this->refresh();
+        return false;
+    }
+
+    int ready = ppoll(pfds, 2, tsp, nullptr);
+    if (ready < 0)
+        // Interrupted by a signal
+        return false;
+    if (pfds[1].revents & POLLIN)
+    {
+        uint64_t value;
+        read(pfds[1].fd, &value, sizeof(value));
+    }
+
+    // Refresh even on timeout so reconnection and error state are picked up
+    this->refresh();
+    return (ready > 0 && (pfds[0].revents & POLLIN)) || (pfds[1].revents & POLLIN) || held;
+}
+
+/**
+ *  @brief Gives the file descriptor of the device stream.
+ *  @return The file descriptor, negative if the stream is closed
+ *  @details Useful for registering the device with an external poll/epoll loop.
+ */
+int Gamepad::getFd()
+{
+    std::lock_guard<std::mutex> lock(this->fdMutex);
+    return this->source.getFd();
+}
+
+/**
+ *  @brief Gives an eventfd signalled each time the HotplugMonitor reopens the device.
+ *  @return The file descriptor, negative if it could not be created
+ */
+int Gamepad::getReconnectFd()
+{
+    // Same eventfd that wakes a parked reader, created before any reconnection is watched
+    if (this->readerWakeFd < 0)
+        this->readerWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    return this->readerWakeFd;
+}
+
+/**
+ *  @brief Gives an eventfd the background reader signals after queueing events.
+ *  @return The file descriptor, negative if it could not be created
+ */
+int Gamepad::getReadyFd()
+{
+    int fd = this->readerReadyFd.load();
+    if (fd < 0)
+    {
+        fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        this->readerReadyFd.store(fd);
+    }
+    return fd;
+}
+
+/**
+ *  @brief Starts the background reader thread.
+ *  @details The reader drains the fd into a lock-free ring of TimedEvents and starts
+ *  @details reconnection on errors. refresh() and popEvent() then only pop from the ring,
+ *  @details with no syscalls or locks. Only one consumer thread may call them.
+ *  @return 0 on success, -1 with errno set if the setThreadConfig() options could not be applied, the reader still runs then
+ */
+int Gamepad::startReader()
+{
+    if (this->readerActive.load())
+        return 0;
+    if (!this->ring)
+        this->ring.reset(new EventRing<TimedEvent, READER_RING_SIZE>());
+    if (this->readerWakeFd < 0)
+        this->readerWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    this->readerActive.store(true, std::memory_order_release);
+    return this->threadConfig.launch(this->readerThread, [this]()
+                                     { this->readerLoop(); });
+}
+
+/**
+ *  @brief Stops the background reader thread and applies any events still queued.
+ *  @details Must be called from the consumer thread.
+ */
+void Gamepad::stopReader()
+{
+    if (!this->readerActive.load())
+        return;
+    this->readerActive.store(false, std::memory_order_release);
+    uint64_t value = 1;
+    // Interrupt the reader's poll()
+    write(this->readerWakeFd, &value, sizeof(value));
+    if (this->readerThread.joinable())
+        this->readerThread.join();
+    TimedEvent timed;
+    bool wasPrimed = this->primed;
+    while (this->ring->pop(timed))
+        this->applyEvents(&timed.event, 1);
+    this->endBatch();
+    this->publishState();
+    this->notifyPrimed(wasPrimed);
+}
+
+/**
+ *  @brief Sets the CPU affinity, priority and memory locking of the background reader.
+ *  @param config The options, applied right away to a running reader and to later ones
+ *  @return 0 on success, -1 on failure with errno set, e.g. EPERM without CAP_SYS_NICE
+ */
+int Gamepad::setThreadConfig(const ThreadConfig &config)
+{
+    this->threadConfig = config;
+    if (config.lockProcessMemory() < 0)
+        return -1;
+    if (this->readerActive.load() && config.apply(this->readerThread.native_handle()) < 0)
+        return -1;
+    return 0;
+}
+
+/**
+ *  @brief Allocates everything the hot path may need up front.
+ */
+void Gamepad::preallocate()
+{
+    // Value-initialized, so every page is written once here rather than on first use
+    if (!this->ring)
+        this->ring.reset(new EventRing<TimedEvent, READER_RING_SIZE>());
+    if (this->readerWakeFd < 0)
+        this->readerWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (!this->history)
+        this->history.reset(new EventHistory<HISTORY_SIZE>());
+}
+
+/**
+ *  @brief Checks whether the background reader thread is running.
+ *  @return true if the reader is active
+ */
+bool Gamepad::isReaderActive()
+{
+    return this->readerActive.load(std::memory_order_acquire);
+}
+
+/**
+ *  @brief Checks whether the Gamepad waits for its device node to reappear.
+ *  @return true while reconnecting
+ */
+bool Gamepad::isReconnecting()
+{
+    return this->reconnecting.load();
+}
+
+/**
+ *  @brief Pops the oldest queued event from the background reader and applies it.
+ *  @param event Reference to write the popped event into
+ *  @return true if an event was popped, false if none are queued or the reader is inactive
+ */
+bool Gamepad::popEvent(TimedEvent &event)
+{
+    if (!this->readerActive.load(std::memory_order_acquire))
+        return false;
+    this->syncOpened();
+    if (!this->ring->pop(event))
+        return false;
+    bool wasPrimed = this->primed;
+    this->lastEventUs = event.sourceUs;
+    this->applyEvents(&event.event, 1);
+    this->endBatch();
+    this->publishState();
+    this->notifyPrimed(wasPrimed);
+    return true;
+}
+
+/**
+ *  @brief Gives the source timestamp of the newest event applied so far.
+ *  @return The time in microseconds, full precision for evdev nodes, 0 before any event
+ */
+uint64_t Gamepad::getLastEventTimeUs()
+{
+    return this->lastEventUs;
+}
+
+/**
+ *  @brief Gives the most up-to-date value of the given axis.
+ *  @param index The index of the desired axis
+ *  @return The current value of the axis
+ */
+short Gamepad::getAxis(int index)
+{
+    // Invalid index
+    if (index >= this->state.axisCount || index < 0)
+        return 0;
+    return this->state.axes[index];
+}
+
+/**
+ *  @brief Gives the most up-to-date value of the given button.
+ *  @param index The index of the desired button
+ *  @return The current value of the button
+ */
+short Gamepad::getButton(int index)
+{
+    // Invalid index
+    if (index >= this->state.buttonCount || index < 0)
+        return 0;
+    return this->state.buttons[index];
+}
+
+/**
+ *  @brief Gives the calibrated value of the given axis.
+ *  @param index The index of the desired axis
+ *  @return The value in [-1, 1], the raw value scaled by 1/32767 if no calibration is set
+ */
+float Gamepad::getAxisValue(int index)
+{
+    // Invalid index
+    if (index >= this->state.axisCount || index < 0)
+        return 0.0f;
+    if (this->processor)
+        return this->processor->get(index);
+    return std::max(this->state.axes[index] / 32767.0f, -1.0f);
+}
+
+/**
+ *  @brief Sets the deadzone, range and response of one axis, enabling axis processing.
+ *  @param index The index of the axis
+ *  @param calibration The calibration
+ *  @return 0 on success, -1 if the index is out of range
+ */
+int Gamepad::setAxisCalibration(int index, const AxisCalibration &calibration)
+{
+    if (index < 0)
+        return -1;
+    if (!this->processor)
+        this->processor.reset(new AxisProcessor());
+    if (this->processor->setCalibration(index, calibration) < 0)
+        return -1;
+    this->processor->process(this->state, this->axisChanges);
+    return 0;
+}
+
+/**
+ *  @brief Gives a circular deadzone to a pair of axes, enabling axis processing.
+ *  @param xIndex The index of the horizontal axis
+ *  @param yIndex The index of the vertical axis
+ *  @param deadzone Radius reported as the center, as a fraction of travel
+ *  @param saturation Radius reported as full deflection, as a fraction of travel
+ *  @return 0 on success, -1 if an index is out of range or too many pairs are set
+ */
+int Gamepad::setRadialDeadzone(int xIndex, int yIndex, float deadzone, float saturation)
+{
+    if (xIndex < 0 || yIndex < 0)
+        return -1;
+    if (!this->processor)
+        this->processor.reset(new AxisProcessor());
+    if (this->processor->setRadialDeadzone(xIndex, yIndex, deadzone, saturation) < 0)
+        return -1;
+    this->processor->process(this->state, this->axisChanges);
+    return 0;
+}
+
+/**
+ *  @brief Drops every calibration and radial deadzone.
+ */
+void Gamepad::disableAxisProcessing()
+{
+    this->processor.reset();
+}
+
+/**
+ *  @brief Collapses bursts of events on one axis, enabling coalescing.
+ *  @param index The index of the axis
+ *  @param options The rate limit and hysteresis threshold
+ *  @return 0 on success, -1 if the index is out of range
+ */
+int Gamepad::setAxisCoalescing(int index, const AxisCoalescing &options)
+{
+    if (index < 0)
+        return -1;
+    if (!this->coalescer)
+        this->coalescer.reset(new AxisCoalescer());
+    return this->coalescer->setOptions(index, options);
+}
+
+/**
+ *  @brief Collapses bursts of events on every axis, enabling coalescing.
+ *  @param options The rate limit and hysteresis threshold
+ */
+void Gamepad::setAxisCoalescing(const AxisCoalescing &options)
+{
+    for (size_t axis = 0; axis < GamepadState::MAX_AXES; axis++)
+        this->setAxisCoalescing((int)axis, options);
+}
+
+/**
+ *  @brief Applies every axis event again, held-back values are dropped.
+ */
+void Gamepad::disableAxisCoalescing()
+{
+    this->coalescer.reset();
+}
+
+/**
+ *  @brief Gives how long until refresh() has held-back axis values to apply without new input.
+ *  @return Nanoseconds until the earliest one is due, 0 if one is due now, -1 if none is held
+ */
+int64_t Gamepad::getHeldDueNs()
+{
+    return this->coalescer ? this->coalescer->nextDueNs(monotonicNs()) : -1;
+}
+
+/**
+ *  @brief Gives a consistent copy of all axes and buttons as of the last refresh().
+ *  @return The published GamepadState
+ *  @details Safe to call from any number of threads concurrently with refresh(),
+ *  @details never blocks the refreshing thread and never returns a torn state.
+ */
+GamepadState Gamepad::snapshot() const
+{
+    return this->published.load();
+}
+
+/**
+ *  @brief Gives how many times refresh() published a new state.
+ *  @return The publication count, changes whenever snapshot() may return something new
+ *  @details Safe to call from any thread, lets consumers skip copying an unchanged state.
+ */
+uint32_t Gamepad::getStateVersion() const
+{
+    return this->published.version();
+}
+
+/**
+ *  @brief Sets how many events refresh() requests per read() call.
+ *  @param size The batch size, clamped to [1, MAX_BATCH_SIZE]
+ */
+void Gamepad::setBatchSize(size_t size)
+{
+    if (size < 1)
+        size = 1;
+    else if (size > MAX_BATCH_SIZE)
+        size = MAX_BATCH_SIZE;
+    this->batchSize = size;
+}
+
+/**
+ *  @brief Gets how many events refresh() requests per read() call.
+ *  @return The current batch size
+ */
+size_t Gamepad::getBatchSize()
+{
+    return this->batchSize;
+}
+
+/**
+ *  @brief Checks whether the button went from released to pressed during the last refresh().
+ *  @param index The index of the button
+ *  @return true if pressed since the previous refresh()
+ */
+bool Gamepad::wasPressed(int index)
+{
+    return index >= 0 && this->buttonPresses.test(index);
+}
+
+/**
+ *  @brief Checks whether the button went from pressed to released during the last refresh().
+ *  @param index The index of the button
+ *  @return true if released since the previous refresh()
+ */
+bool Gamepad::wasReleased(int index)
+{
+    return index >= 0 && this->buttonReleases.test(index);
+}
+
+/**
+ *  @brief Gives the axes whose value changed during the last refresh().
+ *  @return A mask that can be iterated for the changed indices
+ */
+const BitMask<GamepadState::MAX_AXES> &Gamepad::changedAxes()
+{
+    return this->axisChanges;
+}
+
+/**
+ *  @brief Gives the buttons whose value changed during the last refresh().
+ *  @return A mask that can be iterated for the changed indices
+ */
+const BitMask<GamepadState::MAX_BUTTONS> &Gamepad::changedButtons()
+{
+    return this->buttonChanges;
+}
+
+/**
+ *  @brief Encodes what the last refresh() changed into a packet for a remote StateDecoder.
+ *  @param encoder The encoder paired with the remote decoder
+ *  @param out Buffer of at least StatePacket::MAX_SIZE bytes
+ *  @return The packet size, 0 if nothing changed
+ */
+size_t Gamepad::encodeChanges(StateEncoder &encoder, uint8_t *out)
+{
+    return encoder.encode(this->state, this->axisChanges, this->buttonChanges, out);
+}
+
+/**
+ *  @brief Starts recording every applied event into a fixed-size history.
+ *  @details The history buffer is allocated once, on first use.
+ */
+void Gamepad::enableHistory()
+{
+    if (!this->history)
+        this->history.reset(new EventHistory<HISTORY_SIZE>());
+    this->recordHistory = true;
+}
+
+/**
+ *  @brief Stops recording events. The recorded history is kept.
+ */
+void Gamepad::disableHistory()
+{
+    this->recordHistory = false;
+}
+
+/**
+ *  @brief Gives the recorded event history for latency and timing queries.
+ *  @return The history, nullptr if it was never enabled
+ */
+const EventHistory<Gamepad::HISTORY_SIZE> *Gamepad::getHistory()
+{
+    return this->history.get();
+}
+
+/**
+ *  @brief Registers the handler for one button, replacing any previous one.
+ *  @param index The index of the button
+ *  @param handler The handler, nullptr to remove
+ *  @param context Passed back to the handler
+ *  @details Handlers run on the thread calling refresh() as each event is applied.
+ */
+void Gamepad::onButton(int index, EventHandler handler, void *context)
+{
+    if (index < 0 || index >= (int)this->buttonHandlers.size())
+        return;
+    this->buttonHandlers[index] = HandlerSlot{handler, context};
+}
+
+/**
+ *  @brief Registers the handler for one axis, replacing any previous one.
+ *  @param index The index of the axis
+ *  @param handler The handler, nullptr to remove
+ *  @param context Passed back to the handler
+ */
+void Gamepad::onAxis(int index, EventHandler handler, void *context)
+{
+    if (index < 0 || index >= (int)this->axisHandlers.size())
+        return;
+    this->axisHandlers[index] = HandlerSlot{handler, context};
+}
+
+/**
+ *  @brief Registers the handler for every button and axis event, replacing any previous one.
+ *  @param handler The handler, nullptr to remove
+ *  @param context Passed back to the handler
+ */
+void Gamepad::onAny(EventHandler handler, void *context)
+{
+    this->anyHandler = HandlerSlot{handler, context};
+}
+
+/**
+ *  @brief Registers the handler called once per committed frame, replacing any previous one.
+ *  @param handler The handler, nullptr to remove
+ *  @param context Passed back to the handler
+ */
+void Gamepad::onFrame(EventHandler handler, void *context)
+{
+    this->frameHandler = HandlerSlot{handler, context};
+}
+
+/**
+ *  @brief Registers a handler for every applied button and axis event, apart from onAny().
+ *  @param handler The handler, nullptr to remove
+ *  @param context Passed back to the handler
+ *  @details For adapters such as GamepadAsync, which then leave the user's handlers alone.
+ */
+void Gamepad::setEventTap(EventHandler handler, void *context)
+{
+    this->tapHandler = HandlerSlot{handler, context};
+}
+
+/**
+ *  @brief Applies whole hardware reports at once instead of one event at a time.
+ *  @param enabled true to stage events until their frame is complete
+ */
+void Gamepad::setFrameCoherent(bool enabled)
+{
+    if (!enabled)
+    {
+        // Nothing may stay staged once events are applied directly again
+        this->commitFrame();
+        this->publishState();
+    }
+    this->frameCoherent = enabled;
+}
+
+/**
+ *  @brief Checks whether frame coherent updates are enabled.
+ *  @return true if enabled
+ */
+bool Gamepad::isFrameCoherent()
+{
+    return this->frameCoherent;
+}
+
+/**
+ *  @brief Gives the number of axes reported by the device (JSIOCGAXES).
+ *  @return The axis count
+ */
+int Gamepad::getAxisCount()
+{
+    return this->state.axisCount;
+}
+
+/**
+ *  @brief Gives the number of buttons reported by the device (JSIOCGBUTTONS).
+ *  @return The button count
+ */
+int Gamepad::getButtonCount()
+{
+    return this->state.buttonCount;
+}
+
+/**
+ *  @brief Checks whether the cached state reflects the device since it was last (re)opened.
+ *  @return true once the kernel's initial state events have been applied
+ */
+bool Gamepad::isPrimed()
+{
+    return this->primed;
+}
+
+/**
+ *  @brief Sets a callback invoked once the state is primed after each open or reconnect.
+ *  @param callback The callback, called from the thread running refresh()
+ *  @details The constructor's refresh() usually primes the state already, the callback is
+ *  @details then invoked right away so that first priming is not missed.
+ */
+void Gamepad::setPrimedCallback(std::function<void(Gamepad &)> callback)
+{
+    this->primedCallback = std::move(callback);
+    if (this->primed && this->primedCallback)
+        this->primedCallback(*this);
+}
+
+/**
+ *  @brief Gives a copy of the hot-path counters, safe to call from any thread.
+ *  @return The current GamepadStats, all zero when built with GAMEPAD_ENABLE_STATS=0
+ */
+GamepadStats Gamepad::getStats() const
+{
+    return this->counters.snapshot();
+}
+
+/**
+ *  @brief Gets current status of Gamepad.
+ *  @returns Current GamepadStatus enum value
+ */
+GamepadStatus Gamepad::getStatus()
+{
+    return this->status.load();
+}
+
+/**
+ *  @brief Checks if the Gamepad is in an error state (doesn't exist or failed to open/read)
+ *  @return true if in error state, false otherwise
+ */
+bool Gamepad::getErr()
+{
+    return this->status.load() < GamepadStatus::OK;
+}
+
+/**
+ *  @brief Opens the stream of a given path to a 'jsX' or 'eventX' file.
+ *  @param path The path to the file as a string
+ *  @return The file descriptor of the stream
+ *  @details If the operation was successful, return positive integer
+ *  @details Otherwise, set device error state and output error to console.
+ */
+int Gamepad::openStream(const std::string &path)
+{
+    // Switching / opening new stream, stop waiting for the old one
+    this->stopReconnection();
+    this->path = path;
+    {
+        std::lock_guard<std::mutex> lock(this->fdMutex);
+        // A new path may be a different controller, learn its identity afresh
+        this->identity = DeviceIdentity();
+    }
+    return this->safeOpen(path);
+}
+
+/**
+ *  @brief Replaces the device with a recording made by startRecording().
+ *  @param path The path to the recording file
+ *  @param realtime true to deliver events with their original spacing, false for as fast as possible
+ *  @return 0 on success, -1 on failure with errno set
+ *  @details Events then flow through refresh() exactly as if read from the device.
+ *  @details Calling openStream() switches back to a device.
+ */
+int Gamepad::openReplay(const std::string &path, bool realtime)
 {
-    this->fd = -1;
-    this->reconnecting.store(false);
-    this->openStream(path);
-    this->refresh();
+    this->stopReconnection();
+    std::lock_guard<std::mutex> lock(this->fdMutex);
+    if (this->source.openReplay(path, realtime) < 0)
+        return -1;
+    this->status.store(GamepadStatus::OK);
+    this->announceOpened();
+    return 0;
 }
 
 /**
- *  @brief Initializes a Gamepad object.
- *  @param index The index of the joystick to be initialized
- *  @return The created Gamepad object
+ *  @brief Replaces the device with an in-memory buffer of events.
+ *  @param events Pointer to the first event, copied
+ *  @param count The number of events
+ *  @param axisCount Axes the simulated device reports
+ *  @param buttonCount Buttons the simulated device reports
+ *  @details Calling openStream() switches back to a device.
  */
-Gamepad::Gamepad(int index) : Gamepad(std::string("/dev/input/js") + char('0' + index)) {}
+void Gamepad::openMemory(const JSEvent *events, size_t count, uint16_t axisCount, uint16_t buttonCount)
+{
+    this->stopReconnection();
+    std::lock_guard<std::mutex> lock(this->fdMutex);
+    this->source.openMemory(events, count, axisCount, buttonCount);
+    this->status.store(GamepadStatus::OK);
+    this->announceOpened();
+}
 
 /**
- *  @brief Destructor for Gamepad object, ensures cleanup
+ *  @brief Checks whether an open replay or memory buffer has delivered all of its events.
+ *  @return true if one is open and finished
  */
-Gamepad::~Gamepad()
+bool Gamepad::isReplayFinished()
 {
-    this->closeStream();
+    std::lock_guard<std::mutex> lock(this->fdMutex);
+    return this->source.finished();
 }
 
 /**
- *  @brief Updates the state of the Gamepad, including errors.
- *  @details If you wish to interact with the Gamepad iteratively or periodically,
- *  @details call this before any logic.
+ *  @brief Gives the identity of the controller, cached when the stream was first opened.
+ *  @return The DeviceIdentity, invalid for pipes, files and replays
  */
-void Gamepad::refresh()
+DeviceIdentity Gamepad::getIdentity()
 {
-    if (!this->reconnecting.load())
-        // Connection successful, stop background thread
-        stopReconnectionThread();
-    else
-        // Still disconnected, no point in refreshing state
-        return;
+    std::lock_guard<std::mutex> lock(this->fdMutex);
+    return this->identity;
+}
 
-    ssize_t bytesRead = -1;
-    JSEvent event;
-    // Read sizeof(JSEvent) bytes into event
-    // read() updates errno to check status
-    while ((bytesRead = this->safeRead(&event, sizeof(JSEvent))) > 0)
-    {
-        if (event.type == 1)
-            this->buttons[event.number] = event.value;
-        else if (event.type == 2)
-            this->axes[event.number] = event.value;
-    }
-    int err = errno;
-    // Check for read errors
-    this->updateStatus(err);
-    if (this->getErr())
-    {
-        // Problem with controller, attempt reconnection
-        this->startReconnectionThread();
-    }
+/**
+ *  @brief Opens the controller's evdev node for force feedback and starts the rumble writer.
+ *  @return 0 on success, -1 on failure with errno set
+ */
+int Gamepad::enableRumble()
+{
+    std::unique_ptr<RumbleWriter> writer(new RumbleWriter());
+    // The by-id link keeps pointing at this controller across reconnections
+    if (writer->open(this->reconnectPath()) < 0)
+        return -1;
+    this->rumble = std::move(writer);
+    return 0;
 }
 
 /**
- *  @brief Gives the most up-to-date value of the given axis.
- *  @param index The index of the desired axis
- *  @return The current value of the axis
+ *  @brief Stops the rumble writer, the kernel stops and erases its effects.
  */
-short Gamepad::getAxis(int index)
+void Gamepad::disableRumble()
 {
-    // Invalid index
-    if (index >= this->axes.size() || index < 0)
-        return 0;
-    return this->axes[index];
+    this->rumble.reset();
 }
 
 /**
- *  @brief Gives the most up-to-date value of the given button.
- *  @param index The index of the desired button
- *  @return The current value of the button
+ *  @brief Sets the rumble motors, replacing the previous magnitude.
+ *  @param strong Low frequency motor in [0, 1]
+ *  @param weak High frequency motor in [0, 1]
+ *  @param duration How long to play, 0 to play until changed or stopped
  */
-short Gamepad::getButton(int index)
+void Gamepad::setRumble(float strong, float weak, std::chrono::milliseconds duration)
 {
-    // Invalid index
-    if (index >= this->buttons.size() || index < 0)
-        return 0;
-    return this->buttons[index];
+    if (this->rumble)
+        this->rumble->setMagnitude(strong, weak, duration);
 }
 
 /**
- *  @brief Gets current status of Gamepad.
- *  @returns Current GamepadStatus enum value
+ *  @brief Stops the rumble motors.
  */
-GamepadStatus Gamepad::getStatus()
+void Gamepad::stopRumble()
 {
-    return this->status;
+    if (this->rumble)
+        this->rumble->stop();
 }
 
 /**
- *  @brief Checks if the Gamepad is in an error state (doesn't exist or failed to open/read)
- *  @return true if in error state, false otherwise
+ *  @brief Queues a force feedback effect for upload.
+ *  @param effect The effect, its id is ignored
+ *  @return A handle for the calls below, -1 if rumble is disabled or all slots are in use
  */
-bool Gamepad::getErr()
+int Gamepad::uploadEffect(const struct ff_effect &effect)
 {
-    return this->status < GamepadStatus::OK;
+    return this->rumble ? this->rumble->uploadEffect(effect) : -1;
 }
 
 /**
- *  @brief Opens the stream of a given path to a 'jsX' file.
- *  @param path The path to the file as a string
- *  @return The file descriptor of the stream
- *  @details If the operation was successful, return positive integer
- *  @details Otherwise, set device error state and output error to console.
+ *  @brief Queues a replacement for an uploaded effect.
+ *  @param handle The handle given by uploadEffect()
+ *  @param effect The new effect
  */
-int Gamepad::openStream(const std::string &path)
+void Gamepad::updateEffect(int handle, const struct ff_effect &effect)
 {
-    // Switching / opening new stream, stop background thread
-    this->stopReconnectionThread();
-    this->path = path;
-    return this->safeOpen(path);
+    if (this->rumble)
+        this->rumble->updateEffect(handle, effect);
+}
+
+/**
+ *  @brief Queues playback of an uploaded effect.
+ *  @param handle The handle given by uploadEffect()
+ *  @param count Number of repetitions
+ */
+void Gamepad::playEffect(int handle, int count)
+{
+    if (this->rumble)
+        this->rumble->playEffect(handle, count);
+}
+
+/**
+ *  @brief Queues stopping an uploaded effect.
+ *  @param handle The handle given by uploadEffect()
+ */
+void Gamepad::stopEffect(int handle)
+{
+    if (this->rumble)
+        this->rumble->stopEffect(handle);
+}
+
+/**
+ *  @brief Queues removal of an uploaded effect, freeing its handle.
+ *  @param handle The handle given by uploadEffect()
+ */
+void Gamepad::eraseEffect(int handle)
+{
+    if (this->rumble)
+        this->rumble->eraseEffect(handle);
+}
+
+/**
+ *  @brief Gives the kind of source events are currently read from.
+ *  @return The InputSourceType
+ */
+InputSourceType Gamepad::getSourceType()
+{
+    std::lock_guard<std::mutex> lock(this->fdMutex);
+    return this->source.getType();
+}
+
+/**
+ *  @brief Starts appending every event read from the device to a recording file.
+ *  @param path The path to the recording file, truncated if it exists
+ *  @return 0 on success, -1 on failure with errno set
+ *  @details Events are buffered and written in large blocks by a writer thread, refresh() only
+ *  @details waits for the disk if it falls several blocks behind.
+ *  @details Events are recorded as applied, axis events dropped by setAxisCoalescing() are not.
+ */
+int Gamepad::startRecording(const std::string &path)
+{
+    std::unique_ptr<EventRecorder> recorder(new EventRecorder());
+    if (recorder->open(path, this->state.axisCount, this->state.buttonCount) < 0)
+        return -1;
+    this->recorder = std::move(recorder);
+    return 0;
+}
+
+/**
+ *  @brief Flushes and closes the recording file.
+ */
+void Gamepad::stopRecording()
+{
+    this->recorder.reset();
 }
 
 /**
@@ -133,8 +1059,8 @@ int Gamepad::openStream(const std::string &path)
  */
 int Gamepad::closeStream()
 {
-    // Stopping device file stream, stop background thread
-    this->stopReconnectionThread();
+    // Stopping device file stream, stop waiting for it to reappear
+    this->stopReconnection();
     return this->safeClose();
 }
 
@@ -145,57 +1071,399 @@ int Gamepad::closeStream()
  */
 void Gamepad::updateStatus(int err)
 {
+    GamepadStatus next;
     switch (err)
     {
     case EBADF:
         // Invalid file descriptor
-        this->status = GamepadStatus::INVALID_FILE_ERROR;
+        next = GamepadStatus::INVALID_FILE_ERROR;
         break;
     case EINVAL:
         // Invalid file object
-        this->status = GamepadStatus::INVALID_FILE_ERROR;
+        next = GamepadStatus::INVALID_FILE_ERROR;
         break;
     case EIO:
         // I/O error
-        this->status = GamepadStatus::IO_ERROR;
+        next = GamepadStatus::IO_ERROR;
         break;
     case EAGAIN:
         // Read would block but was cancelled with O_NONBLOCK flag
-        this->status = GamepadStatus::OK;
+        next = GamepadStatus::OK;
         break;
     default:
         // Unknown error
-        this->status = GamepadStatus::ERROR;
+        next = GamepadStatus::ERROR;
         break;
     }
+    // Usually unchanged, skip the seq_cst store (a locked xchg on x86) in the steady state
+    if (this->status.load(std::memory_order_relaxed) != next)
+        this->status.store(next);
+}
+
+/**
+ *  @brief Resets the per-refresh change masks.
+ */
+void Gamepad::clearChanges()
+{
+    this->axisChanges.clear();
+    this->buttonChanges.clear();
+    this->buttonPresses.clear();
+    this->buttonReleases.clear();
+}
+
+/**
+ *  @brief Invokes the primed callback if the state just became primed.
+ *  @param wasPrimed Whether the state was primed before the update
+ */
+void Gamepad::notifyPrimed(bool wasPrimed)
+{
+    if (!wasPrimed && this->primed && this->primedCallback)
+        this->primedCallback(*this);
+}
+
+/**
+ *  @brief Picks up axis/button counts after the stream was (re)opened.
+ *  @return true if the device was reopened since the last call
+ */
+bool Gamepad::syncOpened()
+{
+    uint32_t generation = this->openGeneration.load(std::memory_order_acquire);
+    if (generation == this->appliedGeneration)
+        return false;
+    this->appliedGeneration = generation;
+    uint32_t counts = this->openedCounts.load(std::memory_order_relaxed);
+    this->state.axisCount = counts & 0xFFFF;
+    this->state.buttonCount = counts >> 16;
+    // Wait for the kernel's init events describing the new stream
+    this->primed = false;
+    this->initEvents = 0;
+    // A half staged frame belongs to the old stream
+    this->frameSize = 0;
+    this->sourceFramed = false;
+    if (this->processor)
+        this->processor->invalidate();
+    if (this->coalescer)
+        this->coalescer->reset();
+    return true;
+}
+
+/**
+ *  @brief Applies a single decoded event to the cached state.
+ *  @param event The event to apply
+ */
+void Gamepad::applyEvent(const JSEvent &event)
+{
+    // Recorded as applied, after coalescing, so replays reproduce the state this Gamepad saw
+    if (this->recorder)
+        this->recorder->append(event);
+    // Report boundaries only matter for frame staging
+    if ((event.type & ~EVENT_INIT) == EVENT_SYNC)
+        return;
+
+    if (event.type & EVENT_INIT)
+    {
+        // One init event per control is sent after open, primed once all have arrived
+        if (++this->initEvents >= (uint32_t)this->state.axisCount + this->state.buttonCount)
+            this->primed = true;
+    }
+    else
+    {
+        // Regular events only follow once the initial state was sent
+        this->primed = true;
+    }
+
+    uint8_t type = event.type & ~EVENT_INIT;
+    // Indices past what the device reported are dropped, never written out of bounds
+    const HandlerSlot *slot;
+    if (type == EVENT_BUTTON && event.number < this->state.buttonCount)
+    {
+        short previous = this->state.buttons[event.number];
+        if (previous != event.value)
+        {
+            this->state.buttons[event.number] = event.value;
+            this->buttonChanges.set(event.number);
+            if (!previous)
+                this->buttonPresses.set(event.number);
+            else if (!event.value)
+                this->buttonReleases.set(event.number);
+        }
+        slot = &this->buttonHandlers[event.number];
+    }
+    else if (type == EVENT_AXIS && event.number < this->state.axisCount)
+    {
+        if (this->state.axes[event.number] != event.value)
+        {
+            this->state.axes[event.number] = event.value;
+            this->axisChanges.set(event.number);
+        }
+        slot = &this->axisHandlers[event.number];
+    }
+    else
+    {
+        return;
+    }
+
+    if (this->recordHistory)
+        this->history->push(event);
+    if (this->tapHandler.handler)
+        this->tapHandler.handler(this->tapHandler.context, event);
+
+    // Flat tables indexed by event.number, dispatch is a plain indirect call
+    if (slot->handler)
+        slot->handler(slot->context, event);
+    if (this->anyHandler.handler)
+        this->anyHandler.handler(this->anyHandler.context, event);
+}
+
+/**
+ *  @brief Applies a batch of decoded events to the cached state.
+ *  @param events Pointer to the first event
+ *  @param count The number of events to apply
+ */
+void Gamepad::applyEvents(const JSEvent *events, size_t count)
+{
+    if (!this->frameCoherent)
+    {
+        for (size_t i = 0; i < count; i++)
+            this->applyEvent(events[i]);
+        return;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        this->frameEvents[this->frameSize++] = events[i];
+        if ((events[i].type & ~EVENT_INIT) == EVENT_SYNC)
+        {
+            // From now on only EVENT_SYNC ends a frame, a batch may stop mid-report
+            this->sourceFramed = true;
+            this->commitFrame();
+        }
+        else if (this->frameSize == MAX_FRAME_EVENTS)
+        {
+            // Oversized report, commit what we have rather than drop events
+            this->commitFrame();
+        }
+    }
+}
+
+/**
+ *  @brief Coalesces the first events of eventBuffer and applies what is left.
+ *  @param count The number of events in eventBuffer
+ *  @param nowNs CLOCK_MONOTONIC time of the refresh
+ */
+void Gamepad::applyCoalesced(size_t count, uint64_t nowNs)
+{
+    size_t kept = this->coalescer->filter(this->eventBuffer.data(), count, nowNs);
+    GAMEPAD_STAT(GamepadCounters::add(this->counters.eventsCoalesced, count - kept));
+    this->applyEvents(this->eventBuffer.data(), kept);
+}
+
+/**
+ *  @brief Applies the held-back axis values that are due.
+ *  @param nowNs CLOCK_MONOTONIC time of the refresh
+ *  @return true if any value was applied
+ */
+bool Gamepad::flushCoalesced(uint64_t nowNs)
+{
+    static_assert(MAX_BATCH_SIZE >= GamepadState::MAX_AXES, "eventBuffer must hold one held-back value per axis");
+    size_t count = this->coalescer->flush(nowNs, this->eventBuffer.data());
+    this->applyEvents(this->eventBuffer.data(), count);
+    return count > 0;
+}
+
+/**
+ *  @brief Applies the staged frame to the cached state and notifies the frame handler.
+ */
+void Gamepad::commitFrame()
+{
+    if (this->frameSize == 0)
+        return;
+    size_t size = this->frameSize;
+    this->frameSize = 0;
+    for (size_t i = 0; i < size; i++)
+        this->applyEvent(this->frameEvents[i]);
+    GAMEPAD_STAT(GamepadCounters::add(this->counters.frames, 1));
+    if (this->frameHandler.handler)
+        this->frameHandler.handler(this->frameHandler.context, this->frameEvents[size - 1]);
+}
+
+/**
+ *  @brief Commits a partial frame at the end of a batch, for sources without report boundaries.
+ */
+void Gamepad::endBatch()
+{
+    if (!this->sourceFramed)
+        this->commitFrame();
+}
+
+/**
+ *  @brief Publishes the cached state for snapshot() readers.
+ */
+void Gamepad::publishState()
+{
+    // Once per publication, so a burst of events on one axis is only processed once
+    if (this->processor)
+        this->processor->process(this->state, this->axisChanges);
+    this->published.store(this->state);
+}
+
+/**
+ *  @brief Attempts to reopen file stream.
+ *  @returns The file descriptor of the stream
+ */
+int Gamepad::reconnect()
+{
+    return this->safeOpen(this->reconnectPath());
+}
+
+/**
+ *  @brief Gives the path reconnection should reopen.
+ *  @return The cached by-id link if there is one, the opened path otherwise
+ */
+std::string Gamepad::reconnectPath()
+{
+    std::lock_guard<std::mutex> lock(this->fdMutex);
+    // udev points the by-id link at whatever 'jsX' the controller gets next, no scan needed
+    return this->identity.stablePath.empty() ? this->path : this->identity.stablePath;
 }
 
 /**
- *  @brief Asynchronously attempt reconnection every ~250ms.
+ *  @brief Asynchronously reconnect as soon as the device node reappears.
+ *  @details Registers with the shared HotplugMonitor, no thread is spawned per device.
  */
-void Gamepad::startReconnectionThread()
+void Gamepad::startReconnection()
 {
     if (this->reconnecting.exchange(true))
         return;
-    std::string path = this->path;
-    this->reconnectionThread = std::thread([this, path]()
-                                           {
-        while (this->safeOpen(path) < 0 && this->reconnecting.load()) 
+    // Created before the callback can run, which signals it from the monitor thread
+    this->getReconnectFd();
+    std::string path = this->reconnectPath();
+    // Kept when a moved Gamepad resumes the reconnection of the one it came from
+    GAMEPAD_STAT(if (!this->counters.disconnectedAtNs) this->counters.disconnectedAtNs = monotonicNs());
+    HotplugMonitor::instance().watch(this, path, [this, path]()
+                                     {
+        GAMEPAD_STAT(GamepadCounters::add(this->counters.reconnectAttempts, 1));
+        if (this->safeOpen(path) < 0)
+            return false;
+        GAMEPAD_STAT(GamepadCounters::add(this->counters.reconnects, 1));
+        GAMEPAD_STAT(GamepadCounters::add(this->counters.reconnectNs, monotonicNs() - this->counters.disconnectedAtNs));
+        GAMEPAD_STAT(this->counters.disconnectedAtNs = 0);
+        this->status.store(GamepadStatus::OK);
+        this->reconnecting.store(false);
+        if (this->readerWakeFd >= 0)
         {
-            std::this_thread::sleep_for(std::chrono::milliseconds(250));
+            uint64_t value = 1;
+            // Reader thread is parked while reconnecting, wake it up
+            write(this->readerWakeFd, &value, sizeof(value));
         }
-        this->reconnecting.store(false); });
+        return true; });
 }
 
 /**
- * @brief Stop reconnecton thread.
+ *  @brief Stop waiting for the device node to reappear.
  */
-void Gamepad::stopReconnectionThread()
+void Gamepad::stopReconnection()
 {
+    if (!this->reconnecting.load())
+        return;
+    HotplugMonitor::instance().unwatch(this);
     this->reconnecting.store(false);
-    if (this->reconnectionThread.joinable())
+    GAMEPAD_STAT(this->counters.disconnectedAtNs = 0);
+}
+
+/**
+ *  @brief Body of the background reader thread.
+ */
+void Gamepad::readerLoop()
+{
+    std::array<JSEvent, MAX_BATCH_SIZE> batch;
+    struct pollfd pfds[2];
+    pfds[1].fd = this->readerWakeFd;
+    pfds[1].events = POLLIN;
+
+    while (this->readerActive.load(std::memory_order_acquire))
     {
-        this->reconnectionThread.join();
+        int timeoutMs = -1;
+        size_t space = this->ring->freeSpace();
+        int64_t dueNs;
+        bool virtualSource;
+        {
+            std::lock_guard<std::mutex> lock(this->fdMutex);
+            pfds[0].fd = this->source.getFd();
+            dueNs = this->source.nextDueNs();
+            virtualSource = this->source.getType() == SOURCE_MEMORY || this->source.getType() == SOURCE_REPLAY;
+        }
+        pfds[0].events = POLLIN;
+        if (this->reconnecting.load())
+        {
+            // Parked until the HotplugMonitor reopens the device and wakes us
+            pfds[0].fd = -1;
+        }
+        else if (virtualSource)
+        {
+            // Nothing to poll, sleep until the next event is due (or forever once finished)
+            if (dueNs > 0)
+                timeoutMs = (int)std::min<int64_t>((dueNs + 999999) / 1000000, 1000);
+            else if (dueNs == 0)
+                timeoutMs = 0;
+        }
+        else if (this->getErr() || pfds[0].fd < 0)
+        {
+            this->startReconnection();
+            continue;
+        }
+        if (space == 0)
+        {
+            // Consumer is behind, leave events queued in the kernel until there is room
+            pfds[0].fd = -1;
+            timeoutMs = 1;
+        }
+        else if (dueNs == 0 && !virtualSource)
+        {
+            // Already buffered in user space (an evdev resync), the fd would not signal it
+            timeoutMs = 0;
+        }
+
+        pfds[0].revents = 0;
+        pfds[1].revents = 0;
+        if (poll(pfds, 2, timeoutMs) < 0)
+            continue;
+        if (pfds[1].revents & POLLIN)
+        {
+            uint64_t value;
+            read(this->readerWakeFd, &value, sizeof(value));
+            continue;
+        }
+        // Virtual sources are read on timeout, they simply report EAGAIN if nothing is due yet
+        if (space == 0 || this->reconnecting.load() || (pfds[0].fd < 0 && !virtualSource))
+            continue;
+        if (pfds[0].fd >= 0 && pfds[0].revents == 0 && timeoutMs != 0)
+            continue;
+
+        size_t count = std::min(space, this->batchSize);
+        ssize_t bytesRead = this->safeRead(batch.data(), count * sizeof(JSEvent));
+        if (bytesRead > 0)
+        {
+            uint64_t now = monotonicNs();
+            size_t events = bytesRead / sizeof(JSEvent);
+            GAMEPAD_STAT(GamepadCounters::add(this->counters.eventsDrained, events));
+            for (size_t i = 0; i < events; i++)
+                this->ring->push(TimedEvent{batch[i], now, this->source.getTimeUs(i, batch[i])});
+            int readyFd = this->readerReadyFd.load(std::memory_order_relaxed);
+            if (readyFd >= 0)
+            {
+                uint64_t value = 1;
+                write(readyFd, &value, sizeof(value));
+            }
+        }
+        else if (bytesRead < 0 && errno == EAGAIN)
+        {
+            GAMEPAD_STAT(GamepadCounters::add(this->counters.eagainHits, 1));
+        }
+        else
+        {
+            // End of stream is treated as an I/O error so the device gets reopened
+            this->updateStatus(bytesRead < 0 ? errno : EIO);
+        }
     }
 }
 
@@ -207,8 +1475,31 @@ void Gamepad::stopReconnectionThread()
  */
 ssize_t Gamepad::safeRead(void *buf, size_t size)
 {
-    std::lock_guard<std::mutex> lock(this->fdMutex);
-    return read(this->fd, buf, size);
+    std::unique_lock<std::mutex> lock(this->fdMutex, std::try_to_lock);
+    if (!lock.owns_lock())
+    {
+        // Only time the wait when there actually is contention
+        GAMEPAD_STAT(uint64_t start = monotonicNs());
+        lock.lock();
+        GAMEPAD_STAT(GamepadCounters::add(this->counters.lockContentions, 1));
+        GAMEPAD_STAT(GamepadCounters::add(this->counters.lockWaitNs, monotonicNs() - start));
+    }
+    GAMEPAD_STAT(GamepadCounters::add(this->counters.readCalls, 1));
+    return this->source.read(buf, size);
+}
+
+/**
+ *  @brief Reads from the source without fdMutex, for refresh() while not reconnecting.
+ *  @param buf A reference to a buffer to read into
+ *  @param size The size of the buffer / how many bytes to read
+ *  @return The amount of bytes read as a ssize_t
+ */
+ssize_t Gamepad::ownedRead(void *buf, size_t size)
+{
+    // No other thread touches the source now: the reader is stopped, and the HotplugMonitor
+    // only reopens it while reconnecting is set, which only the refreshing thread sets here
+    GAMEPAD_STAT(GamepadCounters::add(this->counters.readCalls, 1));
+    return this->source.read(buf, size);
 }
 
 /**
@@ -219,11 +1510,24 @@ ssize_t Gamepad::safeRead(void *buf, size_t size)
 int Gamepad::safeOpen(const std::string &path)
 {
     std::lock_guard<std::mutex> lock(this->fdMutex);
-    int newFd = open(path.c_str(), O_RDONLY | O_NONBLOCK);
-    int oldFd = this->fd;
-    this->fd = newFd;
-    if (oldFd >= 0)
-        close(oldFd);
+    // Probes for evdev vs the joystick API, and ends any replay
+    int newFd = this->source.openDevice(path);
+    if (newFd < 0)
+        return newFd;
+    DeviceIdentity opened = DeviceIdentity::query(newFd);
+    if (this->identity.valid() && opened.valid() && !this->identity.matches(opened))
+    {
+        // Another controller was enumerated under the old name, keep waiting for ours
+        this->source.close();
+        errno = ENODEV;
+        return -1;
+    }
+    if (!this->identity.valid() && opened.valid())
+    {
+        opened.stablePath = DeviceIdentity::findStablePath(path);
+        this->identity = opened;
+    }
+    this->announceOpened();
     return newFd;
 }
 
@@ -234,9 +1538,89 @@ int Gamepad::safeOpen(const std::string &path)
 int Gamepad::safeClose()
 {
     std::lock_guard<std::mutex> lock(this->fdMutex);
-    int oldFd = this->fd;
-    this->fd = -1;
-    if (oldFd >= 0)
-        return close(oldFd);
-    return 0;
+    return this->source.close();
+}
+
+/**
+ *  @brief Moves everything from other into this Gamepad, which must have nothing open.
+ *  @param other The Gamepad to move from, left closed
+ */
+void Gamepad::moveFrom(Gamepad &other)
+{
+    // Both threads hold other's this pointer, park them before taking anything
+    bool wasReading = other.readerActive.load();
+    other.stopReader();
+    bool wasReconnecting = false;
+    if (other.reconnecting.load())
+    {
+        HotplugMonitor::instance().unwatch(&other);
+        // The monitor may have reopened the device just before the watch was dropped
+        wasReconnecting = other.reconnecting.exchange(false);
+    }
+
+    {
+        std::lock(this->fdMutex, other.fdMutex);
+        std::lock_guard<std::mutex> lock(this->fdMutex, std::adopt_lock);
+        std::lock_guard<std::mutex> otherLock(other.fdMutex, std::adopt_lock);
+        this->path = std::move(other.path);
+        this->source = std::move(other.source);
+        this->identity = std::move(other.identity);
+        this->openGeneration.store(other.openGeneration.load());
+        this->openedCounts.store(other.openedCounts.load());
+    }
+    this->status.store(other.status.load());
+    other.status.store(GamepadStatus::INVALID_FILE_ERROR);
+
+    this->state = other.state;
+    this->published.store(other.published.load());
+    this->axisChanges = other.axisChanges;
+    this->buttonChanges = other.buttonChanges;
+    this->buttonPresses = other.buttonPresses;
+    this->buttonReleases = other.buttonReleases;
+    this->axisHandlers = other.axisHandlers;
+    this->buttonHandlers = other.buttonHandlers;
+    this->anyHandler = other.anyHandler;
+    this->frameHandler = other.frameHandler;
+    this->tapHandler = other.tapHandler;
+    this->frameCoherent = other.frameCoherent;
+    this->sourceFramed = other.sourceFramed;
+    this->frameSize = other.frameSize;
+    this->frameEvents = other.frameEvents;
+    this->history = std::move(other.history);
+    this->recordHistory = other.recordHistory;
+    other.recordHistory = false;
+    this->counters.assign(other.counters);
+    this->recorder = std::move(other.recorder);
+    this->processor = std::move(other.processor);
+    this->coalescer = std::move(other.coalescer);
+    this->rumble = std::move(other.rumble);
+    this->appliedGeneration = other.appliedGeneration;
+    this->primed = other.primed;
+    this->initEvents = other.initEvents;
+    this->lastEventUs = other.lastEventUs;
+    this->primedCallback = std::move(other.primedCallback);
+    other.primedCallback = nullptr;
+    this->batchSize = other.batchSize;
+    this->ring = std::move(other.ring);
+    this->readerWakeFd = other.readerWakeFd;
+    other.readerWakeFd = -1;
+    this->readerReadyFd.store(other.readerReadyFd.exchange(-1));
+    this->threadConfig = other.threadConfig;
+
+    if (wasReconnecting)
+        this->startReconnection();
+    if (wasReading)
+        this->startReader();
+}
+
+/**
+ *  @brief Hands the source's axis/button counts to the refreshing thread.
+ *  @details Must be called with fdMutex held, right after the source was (re)opened.
+ */
+void Gamepad::announceOpened()
+{
+    uint32_t axisCount = std::min<uint32_t>(this->source.getAxisCount(), GamepadState::MAX_AXES);
+    uint32_t buttonCount = std::min<uint32_t>(this->source.getButtonCount(), GamepadState::MAX_BUTTONS);
+    this->openedCounts.store(axisCount | buttonCount << 16, std::memory_order_relaxed);
+    this->openGeneration.fetch_add(1, std::memory_order_release);
 }
\ No newline at end of file
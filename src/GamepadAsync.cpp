@@ -0,0 +1,398 @@
+#include "../include/gamepad/GamepadAsync.h"
+
+#if GAMEPAD_HAS_COROUTINES
+
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <cerrno>
+
+/**
+ *  @brief Event tap queueing every applied event for dispatch().
+ *  @param context The GamepadAsync's event queue
+ *  @param event The applied event
+ */
+static void queueApplied(void *context, const JSEvent &event)
+{
+    static_cast<std::vector<JSEvent> *>(context)->push_back(event);
+}
+
+/**
+ *  @brief Initializes a GamepadAsync for a Gamepad.
+ *  @param gamepad The Gamepad, must outlive this object
+ *  @return The created GamepadAsync object, check getFd() for failure
+ */
+GamepadAsync::GamepadAsync(Gamepad &gamepad) : gamepad(gamepad)
+{
+    this->epollFd = epoll_create1(EPOLL_CLOEXEC);
+    this->reconnectFd = gamepad.getReconnectFd();
+    this->deviceFd = -1;
+    this->heldFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    this->eventHead = nullptr;
+    this->eventTail = nullptr;
+    this->connectedHead = nullptr;
+    // Unlike the fixed-size history, a refresh applying any number of events can't overrun it
+    this->applied.reserve(Gamepad::MAX_BATCH_SIZE);
+    gamepad.setEventTap(queueApplied, &this->applied);
+    if (this->epollFd >= 0 && this->reconnectFd >= 0)
+    {
+        struct epoll_event watch{};
+        watch.events = EPOLLIN;
+        watch.data.fd = this->reconnectFd;
+        epoll_ctl(this->epollFd, EPOLL_CTL_ADD, this->reconnectFd, &watch);
+    }
+    if (this->epollFd >= 0 && this->heldFd >= 0)
+    {
+        struct epoll_event watch{};
+        watch.events = EPOLLIN;
+        watch.data.fd = this->heldFd;
+        epoll_ctl(this->epollFd, EPOLL_CTL_ADD, this->heldFd, &watch);
+    }
+    this->trackDevice(true);
+}
+
+/**
+ *  @brief Destructor for GamepadAsync object, releases the event tap and closes the epoll and timer descriptors
+ */
+GamepadAsync::~GamepadAsync()
+{
+    this->gamepad.setEventTap(nullptr);
+    if (this->epollFd >= 0)
+        close(this->epollFd);
+    if (this->heldFd >= 0)
+        close(this->heldFd);
+}
+
+/**
+ *  @brief Gives the descriptor for the executor to watch.
+ *  @return An epoll fd readable whenever dispatch() has work, negative on failure
+ */
+int GamepadAsync::getFd()
+{
+    return this->epollFd;
+}
+
+/**
+ *  @brief Refreshes the Gamepad and resumes the coroutines its events complete.
+ *  @return The number of coroutines resumed
+ */
+size_t GamepadAsync::dispatch()
+{
+    uint64_t value;
+    // Signalled by the HotplugMonitor after it reopened the device
+    bool reopened = this->reconnectFd >= 0 && read(this->reconnectFd, &value, sizeof(value)) == sizeof(value);
+    // Clears an expiration, the refresh below applies what came due
+    if (this->heldFd >= 0)
+        read(this->heldFd, &value, sizeof(value));
+    this->gamepad.refresh();
+    this->trackDevice(reopened);
+    this->armHeld();
+
+    size_t resumed = 0;
+    // Indexed, the vector must stay valid whatever a resumed coroutine does
+    for (size_t i = 0; i < this->applied.size(); i++)
+        resumed += this->resumeEvent(this->applied[i]);
+    this->applied.clear();
+    if (this->connectedHead && this->connected())
+        resumed += this->resumeConnected();
+    return resumed;
+}
+
+/**
+ *  @brief Waits on getFd() and dispatches, for callers without an executor.
+ *  @param timeout Maximum time to wait, negative to wait indefinitely
+ *  @return The number of coroutines resumed, -1 on error with errno set
+ */
+int GamepadAsync::poll(std::chrono::milliseconds timeout)
+{
+    struct pollfd pfd;
+    pfd.fd = this->epollFd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    int ready = ::poll(&pfd, 1, timeout.count() < 0 ? -1 : (int)timeout.count());
+    if (ready < 0)
+        return errno == EINTR ? 0 : -1;
+    if (ready == 0)
+        return 0;
+    return (int)this->dispatch();
+}
+
+/**
+ *  @brief Awaits the next event, axis or button.
+ *  @return Awaitable resuming with the event, init events included
+ */
+GamepadAsync::EventAwaiter GamepadAsync::nextEvent()
+{
+    return EventAwaiter(*this, 0, -1, -1);
+}
+
+/**
+ *  @brief Awaits the next event of one control.
+ *  @param type EVENT_BUTTON or EVENT_AXIS, init events are included
+ *  @param number The index of the button or axis
+ *  @return Awaitable resuming with the event
+ */
+GamepadAsync::EventAwaiter GamepadAsync::nextEvent(uint8_t type, uint8_t number)
+{
+    return EventAwaiter(*this, type, number, -1);
+}
+
+/**
+ *  @brief Awaits the next press of a button, ignoring its init event.
+ *  @param index The index of the button
+ *  @return Awaitable resuming with the press event
+ */
+GamepadAsync::EventAwaiter GamepadAsync::buttonPressed(uint8_t index)
+{
+    return EventAwaiter(*this, EVENT_BUTTON, index, 1);
+}
+
+/**
+ *  @brief Awaits the next release of a button, ignoring its init event.
+ *  @param index The index of the button
+ *  @return Awaitable resuming with the release event
+ */
+GamepadAsync::EventAwaiter GamepadAsync::buttonReleased(uint8_t index)
+{
+    return EventAwaiter(*this, EVENT_BUTTON, index, 0);
+}
+
+/**
+ *  @brief Awaits the device being connected, completes right away if it is.
+ *  @return Awaitable resuming once the stream is open without error
+ */
+GamepadAsync::ConnectedAwaiter GamepadAsync::reconnected()
+{
+    return ConnectedAwaiter(*this);
+}
+
+/**
+ *  @brief Checks whether the Gamepad has an open stream without error.
+ *  @return true if connected
+ */
+bool GamepadAsync::connected()
+{
+    return !this->gamepad.getErr() && this->gamepad.getSourceType() != SOURCE_NONE;
+}
+
+/**
+ *  @brief Moves the epoll registration to the Gamepad's current device fd.
+ *  @param force Register again even if the fd number is unchanged, after a reopen
+ */
+void GamepadAsync::trackDevice(bool force)
+{
+    if (this->epollFd < 0)
+        return;
+    int fd = this->gamepad.getErr() ? -1 : this->gamepad.getFd();
+    if (fd == this->deviceFd && !force)
+        return;
+    // Fails harmlessly if the old fd was closed, which already dropped it from the set
+    if (this->deviceFd >= 0)
+        epoll_ctl(this->epollFd, EPOLL_CTL_DEL, this->deviceFd, nullptr);
+    this->deviceFd = -1;
+    if (fd < 0)
+        return;
+    struct epoll_event watch{};
+    watch.events = EPOLLIN;
+    watch.data.fd = fd;
+    if (epoll_ctl(this->epollFd, EPOLL_CTL_ADD, fd, &watch) == 0 || errno == EEXIST)
+        this->deviceFd = fd;
+}
+
+/**
+ *  @brief Arms the held-back value timer for the Gamepad's next due value, or disarms it.
+ */
+void GamepadAsync::armHeld()
+{
+    if (this->heldFd < 0)
+        return;
+    int64_t heldNs = this->gamepad.getHeldDueNs();
+    struct itimerspec spec{};
+    if (heldNs >= 0)
+    {
+        // An all-zero it_value disarms, a value that is due now fires right away instead
+        int64_t wait = heldNs > 0 ? heldNs : 1;
+        spec.it_value.tv_sec = wait / 1000000000;
+        spec.it_value.tv_nsec = wait % 1000000000;
+    }
+    timerfd_settime(this->heldFd, 0, &spec, nullptr);
+}
+
+/**
+ *  @brief Resumes the coroutines waiting for an event it matches.
+ *  @param event The applied event
+ *  @return The number of coroutines resumed
+ */
+size_t GamepadAsync::resumeEvent(const JSEvent &event)
+{
+    // Detach first: a resumed coroutine may wait again, and that wait is for a later event
+    EventAwaiter *ready = nullptr;
+    EventAwaiter **readyTail = &ready;
+    EventAwaiter *previous = nullptr;
+    for (EventAwaiter *awaiter = this->eventHead; awaiter;)
+    {
+        EventAwaiter *next = awaiter->next;
+        if (awaiter->matches(event))
+        {
+            (previous ? previous->next : this->eventHead) = next;
+            if (this->eventTail == awaiter)
+                this->eventTail = previous;
+            awaiter->queued = false;
+            awaiter->event = event;
+            awaiter->next = nullptr;
+            *readyTail = awaiter;
+            readyTail = &awaiter->next;
+        }
+        else
+        {
+            previous = awaiter;
+        }
+        awaiter = next;
+    }
+
+    size_t resumed = 0;
+    while (ready)
+    {
+        // The awaiter lives in the coroutine frame, which may be gone after resume()
+        EventAwaiter *next = ready->next;
+        ready->handle.resume();
+        ready = next;
+        resumed++;
+    }
+    return resumed;
+}
+
+/**
+ *  @brief Resumes the coroutines waiting for the device.
+ *  @return The number of coroutines resumed
+ */
+size_t GamepadAsync::resumeConnected()
+{
+    ConnectedAwaiter *ready = this->connectedHead;
+    this->connectedHead = nullptr;
+    for (ConnectedAwaiter *awaiter = ready; awaiter; awaiter = awaiter->next)
+        awaiter->queued = false;
+
+    size_t resumed = 0;
+    while (ready)
+    {
+        ConnectedAwaiter *next = ready->next;
+        ready->handle.resume();
+        ready = next;
+        resumed++;
+    }
+    return resumed;
+}
+
+/**
+ *  @brief Removes a wait from the event list.
+ *  @param awaiter The wait, must be queued
+ */
+void GamepadAsync::unlink(EventAwaiter *awaiter)
+{
+    EventAwaiter *previous = nullptr;
+    for (EventAwaiter *current = this->eventHead; current; previous = current, current = current->next)
+    {
+        if (current != awaiter)
+            continue;
+        (previous ? previous->next : this->eventHead) = current->next;
+        if (this->eventTail == current)
+            this->eventTail = previous;
+        break;
+    }
+    awaiter->queued = false;
+}
+
+/**
+ *  @brief Removes a wait from the connection list.
+ *  @param awaiter The wait, must be queued
+ */
+void GamepadAsync::unlink(ConnectedAwaiter *awaiter)
+{
+    for (ConnectedAwaiter **link = &this->connectedHead; *link; link = &(*link)->next)
+    {
+        if (*link != awaiter)
+            continue;
+        *link = awaiter->next;
+        break;
+    }
+    awaiter->queued = false;
+}
+
+GamepadAsync::EventAwaiter::EventAwaiter(GamepadAsync &owner, uint8_t type, int number, int edge) : owner(owner)
+{
+    this->next = nullptr;
+    this->queued = false;
+    this->type = type;
+    this->number = number;
+    this->edge = edge;
+    this->event = JSEvent();
+}
+
+GamepadAsync::EventAwaiter::~EventAwaiter()
+{
+    // Coroutine destroyed while suspended, don't leave a dangling node behind
+    if (this->queued)
+        this->owner.unlink(this);
+}
+
+void GamepadAsync::EventAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    this->handle = handle;
+    this->next = nullptr;
+    this->queued = true;
+    if (this->owner.eventTail)
+        this->owner.eventTail->next = this;
+    else
+        this->owner.eventHead = this;
+    this->owner.eventTail = this;
+}
+
+/**
+ *  @brief Checks whether an event completes this wait.
+ *  @param event The applied event
+ *  @return true if it matches the filter
+ */
+bool GamepadAsync::EventAwaiter::matches(const JSEvent &event) const
+{
+    uint8_t type = event.type & ~EVENT_INIT;
+    if (this->type && type != this->type)
+        return false;
+    if (this->number >= 0 && event.number != this->number)
+        return false;
+    if (this->edge < 0)
+        return true;
+    // Presses and releases are transitions, the init state isn't one
+    return !(event.type & EVENT_INIT) && (event.value != 0) == (this->edge == 1);
+}
+
+GamepadAsync::ConnectedAwaiter::ConnectedAwaiter(GamepadAsync &owner) : owner(owner)
+{
+    this->next = nullptr;
+    this->queued = false;
+}
+
+GamepadAsync::ConnectedAwaiter::~ConnectedAwaiter()
+{
+    if (this->queued)
+        this->owner.unlink(this);
+}
+
+bool GamepadAsync::ConnectedAwaiter::await_ready() const
+{
+    return this->owner.connected();
+}
+
+void GamepadAsync::ConnectedAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    this->handle = handle;
+    this->next = nullptr;
+    this->queued = true;
+    ConnectedAwaiter **link = &this->owner.connectedHead;
+    while (*link)
+        link = &(*link)->next;
+    *link = this;
+}
+
+#endif // GAMEPAD_HAS_COROUTINES
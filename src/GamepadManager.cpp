@@ -0,0 +1,341 @@
+#include "../include/gamepad/GamepadManager.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdint>
+
+// epoll data tag reserved for the wake eventfd
+static constexpr uint64_t WAKE_ID = UINT64_MAX;
+// Set in the epoll data of a device's reconnect eventfd, the rest is the device id
+static constexpr uint64_t RECONNECT_TAG = UINT64_C(1) << 63;
+// Maximum events handled per epoll_wait() call
+static constexpr int MAX_EVENTS = 64;
+
+/**
+ *  @brief Initializes a GamepadManager with an empty epoll set.
+ *  @return The created GamepadManager object
+ */
+GamepadManager::GamepadManager()
+{
+    this->pendingCount.store(0);
+    this->running.store(false);
+    this->epollFd = epoll_create1(EPOLL_CLOEXEC);
+    this->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (this->epollFd >= 0 && this->wakeFd >= 0)
+    {
+        struct epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.u64 = WAKE_ID;
+        epoll_ctl(this->epollFd, EPOLL_CTL_ADD, this->wakeFd, &ev);
+    }
+}
+
+/**
+ *  @brief Destructor for GamepadManager object, stops the reactor and releases owned devices
+ */
+GamepadManager::~GamepadManager()
+{
+    this->stop();
+    if (this->wakeFd >= 0)
+        close(this->wakeFd);
+    if (this->epollFd >= 0)
+        close(this->epollFd);
+}
+
+/**
+ *  @brief Registers an existing Gamepad. The manager does not take ownership.
+ *  @param gamepad The Gamepad to register, must outlive the manager
+ *  @return The id of the device within the manager
+ */
+size_t GamepadManager::add(Gamepad &gamepad)
+{
+    std::unique_ptr<Device> device(new Device{&gamepad, nullptr, -1, gamepad.getReconnectFd(), true, gamepad.getStatus(), false});
+    return this->addDevice(std::move(device));
+}
+
+/**
+ *  @brief Creates and registers a Gamepad owned by the manager.
+ *  @param path The path to the 'jsX' input file stream as a string
+ *  @return The id of the device within the manager
+ */
+size_t GamepadManager::add(const std::string &path)
+{
+    std::unique_ptr<Gamepad> owned(new Gamepad(path));
+    Gamepad *gamepad = owned.get();
+    std::unique_ptr<Device> device(new Device{gamepad, std::move(owned), -1, gamepad->getReconnectFd(), true, gamepad->getStatus(), false});
+    return this->addDevice(std::move(device));
+}
+
+/**
+ *  @brief Gives the device registered under the given id.
+ *  @param id The id returned by add()
+ *  @return A reference to the Gamepad
+ */
+Gamepad &GamepadManager::get(size_t id)
+{
+    std::lock_guard<std::mutex> lock(this->devicesMutex);
+    return *this->devices[id]->gamepad;
+}
+
+/**
+ *  @brief Gives the number of registered devices.
+ *  @return The device count
+ */
+size_t GamepadManager::size()
+{
+    std::lock_guard<std::mutex> lock(this->devicesMutex);
+    return this->devices.size();
+}
+
+/**
+ *  @brief Sets the callback invoked on per-device state changes.
+ *  @param callback The callback, called from whichever thread runs poll()
+ */
+void GamepadManager::setCallback(ChangeCallback callback)
+{
+    std::lock_guard<std::mutex> lock(this->devicesMutex);
+    this->callback = std::make_shared<const ChangeCallback>(std::move(callback));
+}
+
+/**
+ *  @brief Waits for input on any registered device and dispatches it.
+ *  @param timeout Maximum time to wait, negative to wait indefinitely
+ *  @return The number of devices dispatched, -1 on error
+ *  @details Can be driven from the caller's own loop instead of start().
+ */
+int GamepadManager::poll(std::chrono::milliseconds timeout)
+{
+    if (this->epollFd < 0)
+        return -1;
+
+    int timeoutMs = timeout.count() < 0 ? -1 : (int)timeout.count();
+    {
+        // Held-back axis values never make an fd readable, wake up when the first one is due
+        std::lock_guard<std::mutex> lock(this->devicesMutex);
+        for (const std::unique_ptr<Device> &device : this->devices)
+        {
+            int64_t heldNs = device->pending ? -1 : device->gamepad->getHeldDueNs();
+            int heldMs = heldNs < 0 ? -1 : (int)std::min<int64_t>((heldNs + 999999) / 1000000, INT32_MAX);
+            if (heldMs >= 0 && (timeoutMs < 0 || heldMs < timeoutMs))
+                timeoutMs = heldMs;
+        }
+    }
+
+    struct epoll_event events[MAX_EVENTS];
+    int ready = epoll_wait(this->epollFd, events, MAX_EVENTS, timeoutMs);
+    if (ready < 0)
+        return errno == EINTR ? 0 : -1;
+
+    int dispatched = 0;
+    std::unique_lock<std::mutex> lock(this->devicesMutex);
+    for (int i = 0; i < ready; i++)
+    {
+        if (events[i].data.u64 == WAKE_ID)
+        {
+            uint64_t value;
+            // Drain the eventfd counter so it stops reporting readable
+            while (read(this->wakeFd, &value, sizeof(value)) > 0)
+                ;
+            continue;
+        }
+        if (events[i].data.u64 & RECONNECT_TAG)
+        {
+            size_t id = (size_t)(events[i].data.u64 & ~RECONNECT_TAG);
+            Device &device = *this->devices[id];
+            uint64_t value;
+            read(device.reconnectFd, &value, sizeof(value));
+            // Reopened, possibly before dispatch() saw the error: register the new fd either way
+            this->unregister(device);
+            continue;
+        }
+        this->dispatch((size_t)events[i].data.u64);
+        dispatched++;
+    }
+    for (size_t id = 0; id < this->devices.size(); id++)
+    {
+        const Device &device = *this->devices[id];
+        if (!device.pending && device.gamepad->getHeldDueNs() == 0)
+        {
+            this->dispatch(id);
+            dispatched++;
+        }
+    }
+    if (this->pendingCount.load() > 0)
+        this->syncPending();
+    if (this->notifications.empty())
+        return dispatched;
+
+    // Called unlocked, the callback may use the manager; devices are never removed, so the pointers stay valid
+    std::shared_ptr<const ChangeCallback> callback = this->callback;
+    for (const std::pair<size_t, Gamepad *> &notification : this->notifications)
+        this->devices[notification.first]->notify = false;
+    lock.unlock();
+    if (callback && *callback)
+    {
+        for (const std::pair<size_t, Gamepad *> &notification : this->notifications)
+            (*callback)(notification.first, *notification.second);
+    }
+    this->notifications.clear();
+    return dispatched;
+}
+
+/**
+ *  @brief Runs poll() on a single background reactor thread.
+ *  @return 0 on success, -1 with errno set if the setThreadConfig() options could not be applied, the reactor still runs then
+ */
+int GamepadManager::start()
+{
+    if (this->running.exchange(true))
+        return 0;
+    return this->threadConfig.launch(this->reactorThread, [this]()
+                                     {
+        while (this->running.load())
+        {
+            if (this->poll() < 0)
+                break;
+        } });
+}
+
+/**
+ *  @brief Stops the reactor thread.
+ */
+void GamepadManager::stop()
+{
+    this->running.store(false);
+    if (this->reactorThread.joinable())
+    {
+        uint64_t value = 1;
+        // Interrupt epoll_wait()
+        write(this->wakeFd, &value, sizeof(value));
+        this->reactorThread.join();
+    }
+}
+
+/**
+ *  @brief Sets the CPU affinity, priority and memory locking of the reactor thread.
+ *  @param config The options, applied right away if the reactor runs, or by start()
+ *  @return 0 on success, -1 on failure with errno set
+ */
+int GamepadManager::setThreadConfig(const ThreadConfig &config)
+{
+    this->threadConfig = config;
+    if (config.lockProcessMemory() < 0)
+        return -1;
+    if (this->reactorThread.joinable() && config.apply(this->reactorThread.native_handle()) < 0)
+        return -1;
+    return 0;
+}
+
+/**
+ *  @brief Registers a device entry and wakes the reactor to pick it up.
+ *  @param device The device entry
+ *  @return The id of the device within the manager
+ */
+size_t GamepadManager::addDevice(std::unique_ptr<Device> device)
+{
+    size_t id;
+    {
+        std::lock_guard<std::mutex> lock(this->devicesMutex);
+        id = this->devices.size();
+        if (device->reconnectFd >= 0)
+        {
+            // Disconnected devices sleep until the HotplugMonitor signals the reopen
+            struct epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.u64 = id | RECONNECT_TAG;
+            epoll_ctl(this->epollFd, EPOLL_CTL_ADD, device->reconnectFd, &ev);
+        }
+        this->devices.push_back(std::move(device));
+        this->pendingCount.fetch_add(1);
+    }
+    uint64_t value = 1;
+    write(this->wakeFd, &value, sizeof(value));
+    return id;
+}
+
+/**
+ *  @brief Refreshes a ready device and queues a report if it changed.
+ *  @param id The id of the device
+ */
+void GamepadManager::dispatch(size_t id)
+{
+    Device &device = *this->devices[id];
+    Gamepad &gamepad = *device.gamepad;
+    gamepad.refresh();
+    // A hung up fd stays readable in level-triggered epoll, drop it until it reconnects
+    if (gamepad.getErr())
+        this->unregister(device);
+    this->reportChanges(id);
+}
+
+/**
+ *  @brief Queues a report if the last refresh() of a device changed its state or status.
+ *  @param id The id of the device
+ */
+void GamepadManager::reportChanges(size_t id)
+{
+    Device &device = *this->devices[id];
+    Gamepad &gamepad = *device.gamepad;
+    GamepadStatus status = gamepad.getStatus();
+    if (status != device.lastStatus || gamepad.changedAxes().any() || gamepad.changedButtons().any())
+        this->queueNotification(id);
+    device.lastStatus = status;
+}
+
+/**
+ *  @brief Queues a device for the callback, once per poll().
+ *  @param id The id of the device
+ */
+void GamepadManager::queueNotification(size_t id)
+{
+    Device &device = *this->devices[id];
+    if (device.notify)
+        return;
+    device.notify = true;
+    this->notifications.emplace_back(id, device.gamepad);
+}
+
+/**
+ *  @brief Re-registers pending devices whose fd changed (new or reconnected).
+ */
+void GamepadManager::syncPending()
+{
+    for (size_t id = 0; id < this->devices.size(); id++)
+    {
+        Device &device = *this->devices[id];
+        if (!device.pending)
+            continue;
+        // Let the device pick up a finished reconnection, which applies its init events
+        device.gamepad->refresh();
+        this->reportChanges(id);
+        int fd = device.gamepad->getFd();
+        if (fd < 0 || device.gamepad->getErr())
+            continue;
+
+        struct epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.u64 = id;
+        if (epoll_ctl(this->epollFd, EPOLL_CTL_ADD, fd, &ev) < 0 && errno == EEXIST)
+            epoll_ctl(this->epollFd, EPOLL_CTL_MOD, fd, &ev);
+        device.registeredFd = fd;
+        device.pending = false;
+        this->pendingCount.fetch_sub(1);
+    }
+}
+
+/**
+ *  @brief Removes a device's fd from the epoll set and marks it pending.
+ *  @param device The device entry
+ */
+void GamepadManager::unregister(Device &device)
+{
+    if (device.pending)
+        return;
+    // May fail if the fd was already closed by a reconnect, which removes it implicitly
+    epoll_ctl(this->epollFd, EPOLL_CTL_DEL, device.registeredFd, nullptr);
+    device.registeredFd = -1;
+    device.pending = true;
+    this->pendingCount.fetch_add(1);
+}
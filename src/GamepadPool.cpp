@@ -0,0 +1,288 @@
+#include "../include/gamepad/GamepadPool.h"
+
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+static_assert(GamepadPool::MAX_PADS % GamepadPool::LANES == 0, "pads must fill whole vectors");
+
+/**
+ *  @brief Initializes an empty GamepadPool.
+ *  @return The created GamepadPool object
+ */
+GamepadPool::GamepadPool()
+{
+    // Never reallocated, so pads keep their address and their threads are never moved
+    this->pads.reserve(MAX_PADS);
+    this->axisColumns = 0;
+    for (size_t axis = 0; axis < GamepadState::MAX_AXES; axis++)
+        this->setDeadzone(axis, 0.0f);
+}
+
+/**
+ *  @brief Opens a controller and adds it to the pool.
+ *  @param path The path to the 'jsX' or 'eventX' input file stream as a string
+ *  @return The index of the pad within the pool, -1 if the pool is full
+ */
+int GamepadPool::add(const std::string &path)
+{
+    if (this->pads.size() == MAX_PADS)
+        return -1;
+    this->pads.emplace_back(path);
+    this->gatherAll(this->pads.size() - 1);
+    return (int)this->pads.size() - 1;
+}
+
+/**
+ *  @brief Adds an already opened controller to the pool, without reopening it.
+ *  @param gamepad The Gamepad to move into the pool
+ *  @return The index of the pad within the pool, -1 if the pool is full
+ */
+int GamepadPool::add(Gamepad &&gamepad)
+{
+    if (this->pads.size() == MAX_PADS)
+        return -1;
+    this->pads.push_back(std::move(gamepad));
+    this->gatherAll(this->pads.size() - 1);
+    return (int)this->pads.size() - 1;
+}
+
+/**
+ *  @brief Gives the pad at the given index.
+ *  @param pad The index returned by add()
+ *  @return A reference to the Gamepad, which stays at the same address for the pool's lifetime
+ */
+Gamepad &GamepadPool::get(size_t pad)
+{
+    return this->pads[pad];
+}
+
+/**
+ *  @brief Gives the number of pads in the pool.
+ *  @return The pad count
+ */
+size_t GamepadPool::size() const
+{
+    return this->pads.size();
+}
+
+/**
+ *  @brief Refreshes every pad with pending input in one batch.
+ *  @param timeout Maximum time to wait for input, negative to wait indefinitely
+ *  @return The number of pads that changed, -1 on error with errno set
+ */
+int GamepadPool::refresh(std::chrono::milliseconds timeout)
+{
+    // Edges only last one refresh, clear the ones set by the previous call
+    for (size_t button : this->edgeButtons)
+    {
+        this->pressed[button].clear();
+        this->released[button].clear();
+    }
+    this->edgeButtons.clear();
+    this->changed.clear();
+
+    struct pollfd pfds[MAX_PADS];
+    size_t count = this->pads.size();
+    bool always = false;
+    PadMask signalled;
+    for (size_t pad = 0; pad < count; pad++)
+    {
+        Gamepad &gamepad = this->pads[pad];
+        // Background readers and reconnections signal an eventfd, the device fd isn't ours to poll then
+        if (gamepad.isReaderActive())
+            pfds[pad].fd = gamepad.getReadyFd();
+        else if (gamepad.isReconnecting())
+            pfds[pad].fd = gamepad.getReconnectFd();
+        else
+            pfds[pad].fd = gamepad.getErr() ? -1 : gamepad.getFd();
+        if (pfds[pad].fd >= 0 && (gamepad.isReaderActive() || gamepad.isReconnecting()))
+            signalled.set(pad);
+        pfds[pad].events = POLLIN;
+        pfds[pad].revents = 0;
+        // A negative fd is ignored by poll(), such pads are refreshed unconditionally
+        always |= pfds[pad].fd < 0;
+    }
+    // Pads without an fd still need their refresh, so don't sleep on the others
+    int timeoutMs = always ? 0 : timeout.count() < 0 ? -1 : (int)timeout.count();
+    for (size_t pad = 0; pad < count; pad++)
+    {
+        // Held-back axis values never make an fd readable, wake up when the first one is due
+        int64_t heldNs = this->pads[pad].getHeldDueNs();
+        int heldMs = heldNs < 0 ? -1 : (int)std::min<int64_t>((heldNs + 999999) / 1000000, INT32_MAX);
+        if (heldMs >= 0 && (timeoutMs < 0 || heldMs < timeoutMs))
+            timeoutMs = heldMs;
+    }
+    if (poll(pfds, count, timeoutMs) < 0)
+    {
+        if (errno != EINTR)
+            return -1;
+        // Interrupted, still handle the pads that need no fd
+        for (size_t pad = 0; pad < count; pad++)
+            pfds[pad].revents = 0;
+    }
+
+    int updated = 0;
+    for (size_t pad = 0; pad < count; pad++)
+    {
+        if (pfds[pad].fd >= 0 && !pfds[pad].revents && this->pads[pad].getHeldDueNs() != 0)
+            continue;
+        if (signalled.test(pad) && pfds[pad].revents)
+        {
+            uint64_t value;
+            // Cleared before the refresh, so events queued during it signal the next call
+            read(pfds[pad].fd, &value, sizeof(value));
+        }
+        this->pads[pad].refresh();
+        if (this->gather(pad))
+        {
+            this->changed.set(pad);
+            updated++;
+        }
+    }
+    if (this->dirtyAxes.any())
+        this->processAxes();
+    return updated;
+}
+
+/**
+ *  @brief Sets the axial deadzone applied to one axis of every pad.
+ *  @param axis The index of the axis
+ *  @param deadzone Fraction of travel around the center reported as 0
+ *  @param saturation Fraction of travel reported as full output
+ *  @return 0 on success, -1 if the index is out of range
+ */
+int GamepadPool::setDeadzone(size_t axis, float deadzone, float saturation)
+{
+    if (axis >= GamepadState::MAX_AXES)
+        return -1;
+    this->deadzone[axis] = deadzone;
+    // A saturation at or below the deadzone turns the axis into a switch
+    this->deadzoneScale[axis] = saturation > deadzone ? 1.0f / (saturation - deadzone) : 1e30f;
+    this->dirtyAxes.set(axis);
+    return 0;
+}
+
+/**
+ *  @brief Copies the controls a pad changed in its last refresh into the columns.
+ *  @param pad The index of the pad
+ *  @return true if anything changed
+ */
+bool GamepadPool::gather(size_t pad)
+{
+    Gamepad &gamepad = this->pads[pad];
+    if (gamepad.getAxisCount() != this->axisCounts[pad] || gamepad.getButtonCount() != this->buttonCounts[pad])
+    {
+        // Reopened as a different device, the change masks don't cover controls that vanished
+        this->gatherAll(pad);
+        return true;
+    }
+    bool any = false;
+    for (size_t axis : gamepad.changedAxes())
+    {
+        this->axes[axis][pad] = gamepad.getAxis((int)axis);
+        this->dirtyAxes.set(axis);
+        any = true;
+    }
+    for (size_t button : gamepad.changedButtons())
+    {
+        if (gamepad.getButton((int)button))
+            this->held[button].set(pad);
+        else
+            this->held[button].reset(pad);
+        if (gamepad.wasPressed((int)button))
+            this->pressed[button].set(pad);
+        if (gamepad.wasReleased((int)button))
+            this->released[button].set(pad);
+        this->edgeButtons.set(button);
+        any = true;
+    }
+    return any;
+}
+
+/**
+ *  @brief Copies every control of a pad into the columns, after it was added.
+ *  @param pad The index of the pad
+ */
+void GamepadPool::gatherAll(size_t pad)
+{
+    Gamepad &gamepad = this->pads[pad];
+    size_t axisCount = std::max<size_t>(this->axisCounts[pad], gamepad.getAxisCount());
+    size_t buttonCount = std::max<size_t>(this->buttonCounts[pad], gamepad.getButtonCount());
+    // getAxis() / getButton() give 0 past the reported counts, clearing what the old device had
+    for (size_t axis = 0; axis < axisCount; axis++)
+    {
+        this->axes[axis][pad] = gamepad.getAxis((int)axis);
+        this->dirtyAxes.set(axis);
+    }
+    for (size_t button = 0; button < buttonCount; button++)
+    {
+        if (gamepad.getButton((int)button))
+            this->held[button].set(pad);
+        else
+            this->held[button].reset(pad);
+    }
+    this->axisCounts[pad] = (uint16_t)gamepad.getAxisCount();
+    this->buttonCounts[pad] = (uint16_t)gamepad.getButtonCount();
+    this->axisColumns = std::max<size_t>(this->axisColumns, axisCount);
+}
+
+/**
+ *  @brief Recomputes the deadzoned values of every dirty axis column.
+ */
+void GamepadPool::processAxes()
+{
+    size_t usedBlocks = (this->pads.size() + LANES - 1) / LANES;
+    for (size_t axis : this->dirtyAxes)
+    {
+        if (axis >= this->axisColumns)
+            break;
+        for (size_t block = 0; block < usedBlocks; block++)
+            this->processBlock(axis, block * LANES);
+    }
+    this->dirtyAxes.clear();
+}
+
+/**
+ *  @brief Normalizes and deadzones four pads of one axis column.
+ *  @param axis The index of the axis
+ *  @param first The index of the first pad in the block
+ */
+void GamepadPool::processBlock(size_t axis, size_t first)
+{
+    const short *raw = &this->axes[axis][first];
+    float *out = &this->values[axis][first];
+#if defined(__SSE2__)
+    __m128i packed = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(raw));
+    // Sign extend the four shorts to 32 bits
+    __m128i wide = _mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16);
+    __m128 x = _mm_mul_ps(_mm_cvtepi32_ps(wide), _mm_set1_ps(1.0f / 32767.0f));
+    __m128 signMask = _mm_set1_ps(-0.0f);
+    __m128 sign = _mm_and_ps(x, signMask);
+    __m128 magnitude = _mm_andnot_ps(signMask, x);
+    magnitude = _mm_mul_ps(_mm_sub_ps(magnitude, _mm_set1_ps(this->deadzone[axis])), _mm_set1_ps(this->deadzoneScale[axis]));
+    magnitude = _mm_min_ps(_mm_max_ps(magnitude, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    _mm_store_ps(out, _mm_or_ps(magnitude, sign));
+#elif defined(__ARM_NEON)
+    float32x4_t x = vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vld1_s16(raw))), 1.0f / 32767.0f);
+    uint32x4_t sign = vandq_u32(vreinterpretq_u32_f32(x), vdupq_n_u32(0x80000000u));
+    float32x4_t magnitude = vmulq_n_f32(vsubq_f32(vabsq_f32(x), vdupq_n_f32(this->deadzone[axis])), this->deadzoneScale[axis]);
+    magnitude = vminq_f32(vmaxq_f32(magnitude, vdupq_n_f32(0.0f)), vdupq_n_f32(1.0f));
+    vst1q_f32(out, vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(magnitude), sign)));
+#else
+    for (size_t lane = 0; lane < LANES; lane++)
+    {
+        float x = raw[lane] * (1.0f / 32767.0f);
+        float magnitude = (std::fabs(x) - this->deadzone[axis]) * this->deadzoneScale[axis];
+        out[lane] = std::copysign(std::fmin(std::fmax(magnitude, 0.0f), 1.0f), x);
+    }
+#endif
+}
@@ -0,0 +1,306 @@
+#include "../include/gamepad/GamepadSampler.h"
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+
+/**
+ *  @brief Gives the current CLOCK_MONOTONIC time.
+ *  @return The time in nanoseconds
+ */
+static uint64_t monotonicNs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/**
+ *  @brief Converts nanoseconds to a timespec.
+ *  @param ns The time in nanoseconds
+ *  @return The timespec
+ */
+static struct timespec toTimespec(uint64_t ns)
+{
+    struct timespec value;
+    value.tv_sec = (time_t)(ns / 1000000000);
+    value.tv_nsec = (long)(ns % 1000000000);
+    return value;
+}
+
+/**
+ *  @brief Adds to a counter owned by the calling thread.
+ *  @param counter The counter
+ *  @param amount The amount to add
+ */
+static void add(std::atomic<uint64_t> &counter, uint64_t amount)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+/**
+ *  @brief Initializes a GamepadSampler for a Gamepad, without starting the timer.
+ *  @param gamepad The Gamepad to sample, must outlive the sampler
+ *  @return The created GamepadSampler object
+ */
+GamepadSampler::GamepadSampler(Gamepad &gamepad) : gamepad(gamepad)
+{
+    this->timerFd = -1;
+    this->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    this->periodNs = 0;
+    this->startNs = 0;
+    this->ticks = 0;
+    this->running.store(false);
+}
+
+/**
+ *  @brief Destructor for GamepadSampler object, stops sampling and closes the timer
+ */
+GamepadSampler::~GamepadSampler()
+{
+    this->close();
+    if (this->wakeFd >= 0)
+        ::close(this->wakeFd);
+}
+
+/**
+ *  @brief Arms the timer, the first tick is due one period from now.
+ *  @param period The sampling period, e.g. 1 ms for 1 kHz
+ *  @return 0 on success, -1 on failure with errno set
+ */
+int GamepadSampler::open(std::chrono::nanoseconds period)
+{
+    if (period.count() <= 0)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    this->close();
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    this->periodNs = (uint64_t)period.count();
+    this->startNs = monotonicNs();
+    this->ticks = 0;
+    // Absolute deadlines: a late tick doesn't push back the ones after it
+    struct itimerspec spec;
+    spec.it_value = toTimespec(this->startNs + this->periodNs);
+    spec.it_interval = toTimespec(this->periodNs);
+    if (timerfd_settime(fd, TFD_TIMER_ABSTIME, &spec, nullptr) < 0)
+    {
+        int err = errno;
+        ::close(fd);
+        errno = err;
+        return -1;
+    }
+    this->timerFd = fd;
+    this->pending = SampleTick();
+    return 0;
+}
+
+/**
+ *  @brief Stops sampling and disarms the timer.
+ */
+void GamepadSampler::close()
+{
+    this->stop();
+    if (this->timerFd >= 0)
+        ::close(this->timerFd);
+    this->timerFd = -1;
+}
+
+/**
+ *  @brief Sets the callback invoked for each tick.
+ *  @param callback The callback, called from whichever thread runs poll()
+ */
+void GamepadSampler::setCallback(TickCallback callback)
+{
+    this->callback = std::move(callback);
+}
+
+/**
+ *  @brief Makes ticks available through popTick() as well.
+ */
+void GamepadSampler::enableQueue()
+{
+    if (!this->queue)
+        this->queue.reset(new EventRing<SampleTick, QUEUE_SIZE>());
+}
+
+/**
+ *  @brief Pops the oldest queued tick.
+ *  @param tick Reference to write the tick into
+ *  @return true if a tick was popped, false if none are queued or the queue is disabled
+ */
+bool GamepadSampler::popTick(SampleTick &tick)
+{
+    return this->queue && this->queue->pop(tick);
+}
+
+/**
+ *  @brief Waits for input or the next tick and handles it.
+ *  @param timeout Maximum time to wait, negative to wait indefinitely
+ *  @return The number of ticks delivered (0 or 1), -1 on error with errno set
+ */
+int GamepadSampler::poll(std::chrono::milliseconds timeout)
+{
+    if (this->timerFd < 0)
+    {
+        errno = EBADF;
+        return -1;
+    }
+    struct pollfd pfds[3];
+    pfds[0].fd = this->timerFd;
+    // The background reader owns the fd, and a failed device is refreshed on ticks only
+    pfds[1].fd = this->gamepad.isReaderActive() || this->gamepad.getErr() ? -1 : this->gamepad.getFd();
+    pfds[2].fd = this->wakeFd;
+    for (struct pollfd &pfd : pfds)
+    {
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+    }
+    int timeoutMs = timeout.count() < 0 ? -1 : (int)timeout.count();
+    if (::poll(pfds, 3, timeoutMs) < 0)
+        return errno == EINTR ? 0 : -1;
+
+    if (pfds[2].revents & POLLIN)
+    {
+        uint64_t value;
+        read(this->wakeFd, &value, sizeof(value));
+    }
+    // Drain input as it arrives so the kernel queue never overflows between ticks
+    if (pfds[1].revents)
+        this->collect();
+    if (!(pfds[0].revents & POLLIN))
+        return 0;
+    uint64_t expirations;
+    if (read(this->timerFd, &expirations, sizeof(expirations)) != sizeof(expirations))
+        return errno == EAGAIN ? 0 : -1;
+    this->deliver(expirations, monotonicNs());
+    return 1;
+}
+
+/**
+ *  @brief Runs poll() on a background sampling thread.
+ *  @return 0 on success, -1 with errno set to EBADF if open() was not called, or to the
+ *  @return setThreadConfig() failure (the thread still runs then)
+ */
+int GamepadSampler::start()
+{
+    if (this->timerFd < 0)
+    {
+        errno = EBADF;
+        return -1;
+    }
+    if (this->running.exchange(true))
+        return 0;
+    return this->threadConfig.launch(this->samplerThread, [this]()
+                                     {
+        while (this->running.load())
+        {
+            if (this->poll() < 0)
+                break;
+        } });
+}
+
+/**
+ *  @brief Stops the background sampling thread.
+ */
+void GamepadSampler::stop()
+{
+    this->running.store(false);
+    if (this->samplerThread.joinable())
+    {
+        uint64_t value = 1;
+        // Interrupt poll()
+        write(this->wakeFd, &value, sizeof(value));
+        this->samplerThread.join();
+    }
+}
+
+/**
+ *  @brief Sets the CPU affinity, priority and memory locking of the sampling thread.
+ *  @param config The options, applied right away if the thread runs, or by start()
+ *  @return 0 on success, -1 on failure with errno set
+ */
+int GamepadSampler::setThreadConfig(const ThreadConfig &config)
+{
+    this->threadConfig = config;
+    if (config.lockProcessMemory() < 0)
+        return -1;
+    if (this->samplerThread.joinable() && config.apply(this->samplerThread.native_handle()) < 0)
+        return -1;
+    return 0;
+}
+
+/**
+ *  @brief Gives the tick and deadline statistics.
+ *  @return The values so far, safe to call from any thread
+ */
+SamplerStats GamepadSampler::getStats() const
+{
+    SamplerStats stats;
+    stats.ticks = this->statTicks.load(std::memory_order_relaxed);
+    stats.missedTicks = this->statMissed.load(std::memory_order_relaxed);
+    stats.queueOverruns = this->statOverruns.load(std::memory_order_relaxed);
+    stats.totalLateNs = this->statTotalLateNs.load(std::memory_order_relaxed);
+    stats.maxLateNs = this->statMaxLateNs.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < SamplerStats::LATE_BUCKETS; i++)
+        stats.lateHistogram[i] = this->statLate[i].load(std::memory_order_relaxed);
+    return stats;
+}
+
+/**
+ *  @brief Refreshes the Gamepad and folds its changes into the pending tick.
+ */
+void GamepadSampler::collect()
+{
+    this->gamepad.refresh();
+    for (size_t axis : this->gamepad.changedAxes())
+        this->pending.changedAxes.set(axis);
+    for (size_t button : this->gamepad.changedButtons())
+    {
+        if (this->gamepad.wasPressed((int)button))
+            this->pending.pressed.set(button);
+        if (this->gamepad.wasReleased((int)button))
+            this->pending.released.set(button);
+    }
+}
+
+/**
+ *  @brief Delivers the pending tick after the timer expired.
+ *  @param expirations The number of periods elapsed since the last tick
+ *  @param nowNs CLOCK_MONOTONIC time the expiration was read
+ */
+void GamepadSampler::deliver(uint64_t expirations, uint64_t nowNs)
+{
+    // Pick up whatever arrived since the last wakeup, e.g. from the background reader
+    this->collect();
+    this->ticks += expirations;
+    SampleTick &tick = this->pending;
+    tick.state = this->gamepad.snapshot();
+    tick.index = this->ticks;
+    tick.deadlineNs = this->startNs + this->ticks * this->periodNs;
+    tick.lateNs = nowNs > tick.deadlineNs ? (int64_t)(nowNs - tick.deadlineNs) : 0;
+    tick.missed = (uint32_t)std::min<uint64_t>(expirations - 1, UINT32_MAX);
+
+    uint64_t lateUs = (uint64_t)tick.lateNs / 1000;
+    size_t bucket = lateUs == 0 ? 0 : 64 - __builtin_clzll(lateUs);
+    add(this->statTicks, 1);
+    add(this->statMissed, expirations - 1);
+    add(this->statTotalLateNs, (uint64_t)tick.lateNs);
+    add(this->statLate[std::min(bucket, SamplerStats::LATE_BUCKETS - 1)], 1);
+    if ((uint64_t)tick.lateNs > this->statMaxLateNs.load(std::memory_order_relaxed))
+        this->statMaxLateNs.store((uint64_t)tick.lateNs, std::memory_order_relaxed);
+
+    if (this->callback)
+        this->callback(tick);
+    if (this->queue && !this->queue->push(tick))
+        add(this->statOverruns, 1);
+    tick.changedAxes.clear();
+    tick.pressed.clear();
+    tick.released.clear();
+}
@@ -0,0 +1,290 @@
+#include "../include/gamepad/HotplugMonitor.h"
+
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#include <climits>
+#include <cstdint>
+
+// Retry interval for watches whose directory cannot be watched (missing or inotify unavailable)
+static constexpr int FALLBACK_RETRY_MS = 250;
+
+/**
+ *  @brief Splits a path into its directory and last component.
+ *  @param path The path
+ *  @param name Set to the last component
+ *  @return The directory, "." for a bare name
+ */
+static std::string splitPath(const std::string &path, std::string &name)
+{
+    size_t slash = path.find_last_of('/');
+    name = slash == std::string::npos ? path : path.substr(slash + 1);
+    return slash == std::string::npos ? "." : path.substr(0, slash == 0 ? 1 : slash);
+}
+
+/**
+ *  @brief Gives the process-wide monitor shared by all Gamepad instances.
+ *  @return The HotplugMonitor singleton
+ */
+HotplugMonitor &HotplugMonitor::instance()
+{
+    static HotplugMonitor monitor;
+    return monitor;
+}
+
+/**
+ *  @brief Initializes the monitor. Use instance() instead.
+ *  @return The created HotplugMonitor object
+ */
+HotplugMonitor::HotplugMonitor()
+{
+    this->running.store(false);
+    this->inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    this->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+
+/**
+ *  @brief Destructor for HotplugMonitor object, stops the monitor thread
+ */
+HotplugMonitor::~HotplugMonitor()
+{
+    this->running.store(false);
+    if (this->monitorThread.joinable())
+    {
+        uint64_t value = 1;
+        write(this->wakeFd, &value, sizeof(value));
+        this->monitorThread.join();
+    }
+    if (this->inotifyFd >= 0)
+        close(this->inotifyFd);
+    if (this->wakeFd >= 0)
+        close(this->wakeFd);
+}
+
+/**
+ *  @brief Waits for a device node to (re)appear and calls back to reopen it.
+ *  @param owner Key identifying the watch, used by unwatch()
+ *  @param path The path to the device node
+ *  @param callback Called on the monitor thread when the node is created or changes
+ *  @details The callback is also tried once right away, in case the node still exists.
+ */
+void HotplugMonitor::watch(const void *owner, const std::string &path, ReopenCallback callback)
+{
+    std::string name;
+    std::string directory = splitPath(path, name);
+    {
+        std::lock_guard<std::mutex> lock(this->watchesMutex);
+        this->watches.push_back(Watch{owner, directory, name, std::move(callback), false, false});
+        this->refreshWatch(this->watches.back());
+        // Monitor thread is only started once something needs watching, with the default
+        // config: setThreadConfig() starts it itself so that it can report failures
+        if (!this->running.exchange(true))
+            this->threadConfig.launch(this->monitorThread, [this]()
+                                      { this->monitorLoop(); });
+    }
+    uint64_t value = 1;
+    // Wake the monitor to try the new watch right away
+    write(this->wakeFd, &value, sizeof(value));
+}
+
+/**
+ *  @brief Drops the watch registered by owner.
+ *  @param owner Key passed to watch()
+ *  @details Once this returns the owner's callback is not running and will not run again.
+ */
+void HotplugMonitor::unwatch(const void *owner)
+{
+    std::lock_guard<std::mutex> lock(this->watchesMutex);
+    for (size_t i = 0; i < this->watches.size();)
+    {
+        if (this->watches[i].owner == owner)
+            this->watches.erase(this->watches.begin() + i);
+        else
+            i++;
+    }
+}
+
+/**
+ *  @brief Sets the CPU affinity, priority and memory locking of the monitor thread.
+ *  @param config The options, applied right away, starting the thread if needed
+ *  @return 0 on success, -1 on failure with errno set
+ */
+int HotplugMonitor::setThreadConfig(const ThreadConfig &config)
+{
+    std::lock_guard<std::mutex> lock(this->watchesMutex);
+    this->threadConfig = config;
+    if (config.lockProcessMemory() < 0)
+        return -1;
+    // Started now rather than by the first watch(), so a failure is reported here
+    if (!this->running.exchange(true))
+        return this->threadConfig.launch(this->monitorThread, [this]()
+                                         { this->monitorLoop(); });
+    return config.apply(this->monitorThread.native_handle());
+}
+
+/**
+ *  @brief Body of the monitor thread.
+ */
+void HotplugMonitor::monitorLoop()
+{
+    // Large enough for several events with maximum length names
+    alignas(struct inotify_event) char buffer[16 * (sizeof(struct inotify_event) + NAME_MAX + 1)];
+    struct pollfd pfds[2];
+    pfds[0].fd = this->inotifyFd;
+    pfds[0].events = POLLIN;
+    pfds[1].fd = this->wakeFd;
+    pfds[1].events = POLLIN;
+
+    while (this->running.load())
+    {
+        bool fallback = false;
+        {
+            std::lock_guard<std::mutex> lock(this->watchesMutex);
+            for (const Watch &watch : this->watches)
+                fallback = fallback || (!watch.watched && !watch.parentWatched);
+        }
+
+        pfds[0].revents = 0;
+        pfds[1].revents = 0;
+        // Sleep until a node changes, only fall back to timed retries when inotify cannot help
+        int ready = poll(pfds, 2, fallback ? FALLBACK_RETRY_MS : -1);
+        if (ready < 0)
+            continue;
+        if (ready == 0)
+        {
+            this->tryReopen("", "", true);
+            continue;
+        }
+
+        if (pfds[1].revents & POLLIN)
+        {
+            uint64_t value;
+            read(this->wakeFd, &value, sizeof(value));
+            // New watches get one immediate attempt
+            this->tryReopen("", "", false);
+        }
+
+        if (pfds[0].revents & POLLIN)
+        {
+            ssize_t length;
+            while ((length = read(this->inotifyFd, buffer, sizeof(buffer))) > 0)
+            {
+                for (char *ptr = buffer; ptr < buffer + length;)
+                {
+                    const struct inotify_event *event = reinterpret_cast<const struct inotify_event *>(ptr);
+                    ptr += sizeof(struct inotify_event) + event->len;
+                    if (event->mask & IN_IGNORED)
+                    {
+                        // The directory itself is gone, its node can only come back with it
+                        std::lock_guard<std::mutex> lock(this->watchesMutex);
+                        this->dropDirectory(event->wd);
+                        continue;
+                    }
+                    if (event->len == 0)
+                        continue;
+                    std::string directory;
+                    {
+                        std::lock_guard<std::mutex> lock(this->watchesMutex);
+                        auto it = this->directories.find(event->wd);
+                        if (it == this->directories.end())
+                            continue;
+                        directory = it->second;
+                    }
+                    this->tryReopen(directory, event->name, false);
+                }
+            }
+        }
+    }
+}
+
+/**
+ *  @brief Adds an inotify watch on a directory, if not watched already.
+ *  @param directory The directory containing device nodes
+ *  @return true if the directory is watched
+ */
+bool HotplugMonitor::watchDirectory(const std::string &directory)
+{
+    if (this->inotifyFd < 0)
+        return false;
+    for (const auto &entry : this->directories)
+    {
+        if (entry.second == directory)
+            return true;
+    }
+    // IN_ATTRIB covers udev fixing up permissions after the kernel creates the node
+    int wd = inotify_add_watch(this->inotifyFd, directory.c_str(), IN_CREATE | IN_ATTRIB | IN_MOVED_TO);
+    if (wd < 0)
+        return false;
+    this->directories[wd] = directory;
+    return true;
+}
+
+/**
+ *  @brief Brings a watch's inotify coverage up to date, watching its directory or else its parent.
+ *  @param watch The watch
+ *  @return true if its directory became watched
+ */
+bool HotplugMonitor::refreshWatch(Watch &watch)
+{
+    if (watch.watched)
+        return false;
+    watch.watched = this->watchDirectory(watch.directory);
+    if (watch.watched)
+    {
+        watch.parentWatched = false;
+        return true;
+    }
+    // Creating the directory is an IN_CREATE in its parent, which retries this
+    std::string name;
+    std::string parent = splitPath(watch.directory, name);
+    watch.parentWatched = parent != watch.directory && this->watchDirectory(parent);
+    return false;
+}
+
+/**
+ *  @brief Forgets an inotify watch the kernel dropped, e.g. because its directory was deleted.
+ *  @param wd The watch descriptor
+ */
+void HotplugMonitor::dropDirectory(int wd)
+{
+    auto it = this->directories.find(wd);
+    if (it == this->directories.end())
+        return;
+    std::string directory = it->second;
+    this->directories.erase(it);
+    for (Watch &watch : this->watches)
+    {
+        if (watch.directory == directory)
+            watch.watched = false;
+        watch.parentWatched = false;
+    }
+    // Watch the parents instead, or fall back to timed retries where that fails too
+    for (Watch &watch : this->watches)
+        this->refreshWatch(watch);
+}
+
+/**
+ *  @brief Tries the callbacks of matching watches, dropping those that succeed.
+ *  @param directory The directory of the changed node, empty to match any
+ *  @param name The name of the changed node, empty to match any
+ *  @param unwatchedOnly Only try watches whose directory could not be watched
+ */
+void HotplugMonitor::tryReopen(const std::string &directory, const std::string &name, bool unwatchedOnly)
+{
+    // Held across callbacks so unwatch() cannot return while one is running
+    std::lock_guard<std::mutex> lock(this->watchesMutex);
+    for (size_t i = 0; i < this->watches.size();)
+    {
+        Watch &watch = this->watches[i];
+        bool matches = (directory.empty() || watch.directory == directory) &&
+                       (name.empty() || watch.name == name) &&
+                       (!unwatchedOnly || !watch.watched);
+        // The directory may exist by now, and so may the node
+        bool nowWatched = this->refreshWatch(watch);
+        if ((matches || nowWatched) && watch.callback())
+            this->watches.erase(this->watches.begin() + i);
+        else
+            i++;
+    }
+}
@@ -0,0 +1,267 @@
+#include "../include/gamepad/InputSource.h"
+
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <linux/input.h>
+#include <unistd.h>
+#include <cerrno>
+#include <utility>
+
+/**
+ *  @brief Initializes an InputSource with nothing open.
+ *  @return The created InputSource object
+ */
+InputSource::InputSource()
+{
+    this->type = SOURCE_NONE;
+}
+
+/**
+ *  @brief Destructor for InputSource object, closes the open backend
+ */
+InputSource::~InputSource()
+{
+    this->close();
+}
+
+/**
+ *  @brief Takes over the open backend of another InputSource without reopening it.
+ *  @param other The InputSource to take from, left with nothing open
+ *  @return The created InputSource object
+ */
+InputSource::InputSource(InputSource &&other) : InputSource()
+{
+    this->swap(other);
+}
+
+/**
+ *  @brief Closes the open backend and takes over the one of another InputSource.
+ *  @param other The InputSource to take from, left with nothing open
+ *  @return This InputSource
+ */
+InputSource &InputSource::operator=(InputSource &&other)
+{
+    if (this != &other)
+    {
+        this->close();
+        this->swap(other);
+    }
+    return *this;
+}
+
+/**
+ *  @brief Exchanges the open backends of two InputSources, nothing is reopened.
+ *  @param other The InputSource to swap with
+ */
+void InputSource::swap(InputSource &other)
+{
+    // The fd-based backends are plain values, only the replay owns a mapping
+    std::swap(this->type, other.type);
+    std::swap(this->joystick, other.joystick);
+    std::swap(this->evdev, other.evdev);
+    std::swap(this->memory, other.memory);
+    this->replay.swap(other.replay);
+}
+
+/**
+ *  @brief Opens a device node, picking evdev or the joystick API by probing it.
+ *  @param path The path to a 'jsX' or 'eventX' node
+ *  @return The file descriptor, negative on failure with errno set
+ */
+int InputSource::openDevice(const std::string &path)
+{
+    int newFd = open(path.c_str(), O_RDONLY | O_NONBLOCK);
+    this->close();
+    if (newFd < 0)
+        return newFd;
+    int version;
+    // Only evdev nodes answer EVIOCGVERSION
+    if (ioctl(newFd, EVIOCGVERSION, &version) >= 0)
+    {
+        this->evdev.adopt(newFd);
+        this->type = SOURCE_EVDEV;
+    }
+    else
+    {
+        this->joystick.adopt(newFd);
+        this->type = SOURCE_JOYSTICK;
+    }
+    return newFd;
+}
+
+/**
+ *  @brief Switches to an in-memory event buffer.
+ *  @param events Pointer to the first event, copied
+ *  @param count The number of events
+ *  @param axisCount Axes the simulated device reports
+ *  @param buttonCount Buttons the simulated device reports
+ */
+void InputSource::openMemory(const JSEvent *events, size_t count, uint16_t axisCount, uint16_t buttonCount)
+{
+    this->close();
+    this->memory.assign(events, count, axisCount, buttonCount);
+    this->type = SOURCE_MEMORY;
+}
+
+/**
+ *  @brief Switches to a recording made by EventRecorder.
+ *  @param path The path to the recording file
+ *  @param realtime true to deliver events with their original spacing
+ *  @return 0 on success, -1 on failure with errno set, the current backend stays open on failure
+ */
+int InputSource::openReplay(const std::string &path, bool realtime)
+{
+    InputSourceType previous = this->type;
+    // ReplaySource::open() keeps any previous mapping if the new one fails
+    if (this->replay.open(path, realtime) < 0)
+        return -1;
+    if (previous != SOURCE_REPLAY)
+    {
+        this->type = SOURCE_NONE;
+        switch (previous)
+        {
+        case SOURCE_JOYSTICK:
+            this->joystick.close();
+            break;
+        case SOURCE_EVDEV:
+            this->evdev.close();
+            break;
+        case SOURCE_MEMORY:
+            this->memory.close();
+            break;
+        default:
+            break;
+        }
+    }
+    this->type = SOURCE_REPLAY;
+    return 0;
+}
+
+/**
+ *  @brief Closes the open backend.
+ *  @return The output of its close(), 0 if nothing was open
+ */
+int InputSource::close()
+{
+    InputSourceType previous = this->type;
+    this->type = SOURCE_NONE;
+    switch (previous)
+    {
+    case SOURCE_JOYSTICK:
+        return this->joystick.close();
+    case SOURCE_EVDEV:
+        return this->evdev.close();
+    case SOURCE_MEMORY:
+        return this->memory.close();
+    case SOURCE_REPLAY:
+        return this->replay.close();
+    default:
+        return 0;
+    }
+}
+
+/**
+ *  @brief Gives the type of the open backend.
+ *  @return The InputSourceType
+ */
+InputSourceType InputSource::getType()
+{
+    return this->type;
+}
+
+/**
+ *  @brief Gives the file descriptor to poll for input.
+ *  @return The file descriptor, -1 for backends without one
+ */
+int InputSource::getFd()
+{
+    switch (this->type)
+    {
+    case SOURCE_JOYSTICK:
+        return this->joystick.getFd();
+    case SOURCE_EVDEV:
+        return this->evdev.getFd();
+    default:
+        return -1;
+    }
+}
+
+/**
+ *  @brief Gives how long until events can be read without waiting on the fd.
+ *  @return 0 if events are ready, nanoseconds until the next one for timed backends,
+ *  @return -1 if the fd must be polled or nothing more will arrive
+ */
+int64_t InputSource::nextDueNs()
+{
+    switch (this->type)
+    {
+    case SOURCE_EVDEV:
+        // Init events are buffered in user space, the fd won't signal them
+        return this->evdev.hasPending() ? 0 : -1;
+    case SOURCE_MEMORY:
+        return this->memory.finished() ? -1 : 0;
+    case SOURCE_REPLAY:
+        return this->replay.nextDueNs();
+    default:
+        return -1;
+    }
+}
+
+/**
+ *  @brief Checks whether a memory or replay backend delivered all of its events.
+ *  @return true if finished
+ */
+bool InputSource::finished()
+{
+    switch (this->type)
+    {
+    case SOURCE_MEMORY:
+        return this->memory.finished();
+    case SOURCE_REPLAY:
+        return this->replay.finished();
+    default:
+        return false;
+    }
+}
+
+/**
+ *  @brief Gives the number of axes reported by the open backend.
+ *  @return The axis count
+ */
+uint16_t InputSource::getAxisCount()
+{
+    switch (this->type)
+    {
+    case SOURCE_JOYSTICK:
+        return this->joystick.getAxisCount();
+    case SOURCE_EVDEV:
+        return this->evdev.getAxisCount();
+    case SOURCE_MEMORY:
+        return this->memory.getAxisCount();
+    case SOURCE_REPLAY:
+        return this->replay.getHeader().axisCount;
+    default:
+        return 0;
+    }
+}
+
+/**
+ *  @brief Gives the number of buttons reported by the open backend.
+ *  @return The button count
+ */
+uint16_t InputSource::getButtonCount()
+{
+    switch (this->type)
+    {
+    case SOURCE_JOYSTICK:
+        return this->joystick.getButtonCount();
+    case SOURCE_EVDEV:
+        return this->evdev.getButtonCount();
+    case SOURCE_MEMORY:
+        return this->memory.getButtonCount();
+    case SOURCE_REPLAY:
+        return this->replay.getHeader().buttonCount;
+    default:
+        return 0;
+    }
+}
@@ -0,0 +1,119 @@
+#include "../include/gamepad/JoystickSource.h"
+#include "../include/gamepad/GamepadState.h"
+
+#include <sys/ioctl.h>
+#include <linux/joystick.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+
+/**
+ *  @brief Initializes a JoystickSource without an open device.
+ *  @return The created JoystickSource object
+ */
+JoystickSource::JoystickSource()
+{
+    this->fd = -1;
+    this->axisCount = 0;
+    this->buttonCount = 0;
+    this->partialSize = 0;
+}
+
+/**
+ *  @brief Takes ownership of an open 'jsX' (or any readable) file descriptor.
+ *  @param fd The file descriptor
+ *  @details Queries JSIOCGAXES/JSIOCGBUTTONS, nodes that reject them get the full index range.
+ */
+void JoystickSource::adopt(int fd)
+{
+    this->fd = fd;
+    this->partialSize = 0;
+    uint8_t reportedAxes = 0;
+    uint8_t reportedButtons = 0;
+    this->axisCount = GamepadState::MAX_AXES;
+    this->buttonCount = GamepadState::MAX_BUTTONS;
+    // Not a joystick node (e.g. a pipe), accept the full index range instead
+    if (ioctl(fd, JSIOCGAXES, &reportedAxes) >= 0 && ioctl(fd, JSIOCGBUTTONS, &reportedButtons) >= 0)
+    {
+        this->axisCount = std::min<uint16_t>(reportedAxes, GamepadState::MAX_AXES);
+        this->buttonCount = reportedButtons;
+    }
+}
+
+/**
+ *  @brief Reads whole JSEvents straight from the device.
+ *  @param buf A buffer to read into
+ *  @param size The size of the buffer in bytes
+ *  @return The number of bytes read, a multiple of sizeof(JSEvent), or -1 with errno set
+ *  @details Streams such as pipes can end a read() inside an event, the trailing bytes are
+ *  @details kept and put in front of the next read().
+ */
+ssize_t JoystickSource::read(void *buf, size_t size)
+{
+    size_t whole = size - size % sizeof(JSEvent);
+    if (whole == 0)
+    {
+        // joydev rejects reads shorter than one event as well
+        errno = EINVAL;
+        return -1;
+    }
+    uint8_t *out = static_cast<uint8_t *>(buf);
+    std::memcpy(out, this->partial.data(), this->partialSize);
+    ssize_t bytesRead = ::read(this->fd, out + this->partialSize, whole - this->partialSize);
+    if (bytesRead <= 0)
+        return bytesRead;
+
+    size_t total = this->partialSize + bytesRead;
+    size_t complete = total - total % sizeof(JSEvent);
+    this->partialSize = total - complete;
+    std::memcpy(this->partial.data(), out + complete, this->partialSize);
+    if (complete == 0)
+    {
+        // Not even one whole event yet, the rest is still on its way
+        errno = EAGAIN;
+        return -1;
+    }
+    return complete;
+}
+
+/**
+ *  @brief Closes the device.
+ *  @return The output of the close() system call, 0 if it was not open
+ */
+int JoystickSource::close()
+{
+    int oldFd = this->fd;
+    this->fd = -1;
+    this->partialSize = 0;
+    if (oldFd >= 0)
+        return ::close(oldFd);
+    return 0;
+}
+
+/**
+ *  @brief Gives the device file descriptor.
+ *  @return The file descriptor, -1 if not open
+ */
+int JoystickSource::getFd()
+{
+    return this->fd;
+}
+
+/**
+ *  @brief Gives the number of axes reported by the device.
+ *  @return The axis count
+ */
+uint16_t JoystickSource::getAxisCount()
+{
+    return this->axisCount;
+}
+
+/**
+ *  @brief Gives the number of buttons reported by the device.
+ *  @return The button count
+ */
+uint16_t JoystickSource::getButtonCount()
+{
+    return this->buttonCount;
+}
@@ -0,0 +1,90 @@
+#include "../include/gamepad/MemorySource.h"
+
+#include <cerrno>
+#include <cstring>
+
+/**
+ *  @brief Initializes an empty MemorySource.
+ *  @return The created MemorySource object
+ */
+MemorySource::MemorySource()
+{
+    this->position = 0;
+    this->axisCount = 0;
+    this->buttonCount = 0;
+}
+
+/**
+ *  @brief Replaces the buffered events.
+ *  @param events Pointer to the first event, copied
+ *  @param count The number of events
+ *  @param axisCount Axes the simulated device reports
+ *  @param buttonCount Buttons the simulated device reports
+ */
+void MemorySource::assign(const JSEvent *events, size_t count, uint16_t axisCount, uint16_t buttonCount)
+{
+    this->events.assign(events, events + count);
+    this->position = 0;
+    this->axisCount = axisCount;
+    this->buttonCount = buttonCount;
+}
+
+/**
+ *  @brief Copies the next buffered events into buf, mirroring read() on a joystick fd.
+ *  @param buf A buffer to read into
+ *  @param size The size of the buffer in bytes
+ *  @return The number of bytes copied, or -1 with errno set to EAGAIN once drained
+ */
+ssize_t MemorySource::read(void *buf, size_t size)
+{
+    size_t wanted = size / sizeof(JSEvent);
+    size_t available = this->events.size() - this->position;
+    if (wanted > available)
+        wanted = available;
+    if (wanted == 0)
+    {
+        errno = EAGAIN;
+        return -1;
+    }
+    std::memcpy(buf, this->events.data() + this->position, wanted * sizeof(JSEvent));
+    this->position += wanted;
+    return wanted * sizeof(JSEvent);
+}
+
+/**
+ *  @brief Drops the buffered events.
+ *  @return 0
+ */
+int MemorySource::close()
+{
+    this->events.clear();
+    this->position = 0;
+    return 0;
+}
+
+/**
+ *  @brief Checks whether every event has been read.
+ *  @return true if drained
+ */
+bool MemorySource::finished()
+{
+    return this->position >= this->events.size();
+}
+
+/**
+ *  @brief Gives the number of axes the simulated device reports.
+ *  @return The axis count
+ */
+uint16_t MemorySource::getAxisCount()
+{
+    return this->axisCount;
+}
+
+/**
+ *  @brief Gives the number of buttons the simulated device reports.
+ *  @return The button count
+ */
+uint16_t MemorySource::getButtonCount()
+{
+    return this->buttonCount;
+}
@@ -0,0 +1,207 @@
+#include "../include/gamepad/ReplaySource.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <chrono>
+#include <utility>
+
+/**
+ *  @brief Gives the current CLOCK_MONOTONIC time.
+ *  @return The time in nanoseconds
+ */
+static uint64_t monotonicNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+/**
+ *  @brief Initializes a ReplaySource without an open recording.
+ *  @return The created ReplaySource object
+ */
+ReplaySource::ReplaySource()
+{
+    this->mapping = nullptr;
+    this->mappingSize = 0;
+    this->events = nullptr;
+    this->count = 0;
+    this->position = 0;
+    this->realtime = false;
+    this->startNs = 0;
+}
+
+/**
+ *  @brief Destructor for ReplaySource object, unmaps the recording
+ */
+ReplaySource::~ReplaySource()
+{
+    this->close();
+}
+
+/**
+ *  @brief Exchanges the open recordings of two ReplaySources, the mappings stay in place.
+ *  @param other The ReplaySource to swap with
+ */
+void ReplaySource::swap(ReplaySource &other)
+{
+    std::swap(this->mapping, other.mapping);
+    std::swap(this->mappingSize, other.mappingSize);
+    std::swap(this->header, other.header);
+    std::swap(this->events, other.events);
+    std::swap(this->count, other.count);
+    std::swap(this->position, other.position);
+    std::swap(this->realtime, other.realtime);
+    std::swap(this->startNs, other.startNs);
+}
+
+/**
+ *  @brief Memory-maps a recording made by EventRecorder.
+ *  @param path The path to the recording file
+ *  @param realtime true to deliver events with their original spacing, false for as fast as possible
+ *  @return 0 on success, -1 on failure with errno set
+ */
+int ReplaySource::open(const std::string &path, bool realtime)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    struct stat info;
+    if (fstat(fd, &info) < 0 || (size_t)info.st_size < sizeof(RecordingHeader))
+    {
+        ::close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    void *mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+        return -1;
+
+    RecordingHeader header;
+    std::memcpy(&header, mapping, sizeof(header));
+    if (header.magic != RecordingHeader::MAGIC || header.recordSize != sizeof(JSEvent))
+    {
+        munmap(mapping, info.st_size);
+        errno = EINVAL;
+        return -1;
+    }
+    // Replay is sequential, let the kernel read ahead
+    madvise(mapping, info.st_size, MADV_SEQUENTIAL);
+
+    if (this->mapping)
+        munmap(this->mapping, this->mappingSize);
+    this->mapping = mapping;
+    this->mappingSize = info.st_size;
+    this->header = header;
+    this->events = reinterpret_cast<const JSEvent *>(static_cast<const char *>(mapping) + sizeof(RecordingHeader));
+    this->count = (info.st_size - sizeof(RecordingHeader)) / sizeof(JSEvent);
+    this->position = 0;
+    this->realtime = realtime;
+    this->startNs = 0;
+    return 0;
+}
+
+/**
+ *  @brief Copies the events that are due into buf, mirroring read() on a joystick fd.
+ *  @param buf A buffer to read into
+ *  @param size The size of the buffer in bytes
+ *  @return The number of bytes copied, or -1 with errno set to EAGAIN if nothing is due
+ */
+ssize_t ReplaySource::read(void *buf, size_t size)
+{
+    if (!this->events)
+    {
+        errno = EBADF;
+        return -1;
+    }
+    if (this->startNs == 0)
+        this->startNs = monotonicNs();
+
+    size_t wanted = size / sizeof(JSEvent);
+    size_t available = this->count - this->position;
+    if (wanted > available)
+        wanted = available;
+    if (this->realtime && wanted > 0)
+    {
+        uint64_t now = monotonicNs();
+        size_t due = 0;
+        while (due < wanted && this->dueNs(this->position + due) <= now)
+            due++;
+        wanted = due;
+    }
+    if (wanted == 0)
+    {
+        // Like an idle device, nothing to read yet
+        errno = EAGAIN;
+        return -1;
+    }
+    std::memcpy(buf, this->events + this->position, wanted * sizeof(JSEvent));
+    this->position += wanted;
+    return wanted * sizeof(JSEvent);
+}
+
+/**
+ *  @brief Unmaps the recording.
+ *  @return 0
+ */
+int ReplaySource::close()
+{
+    if (this->mapping)
+        munmap(this->mapping, this->mappingSize);
+    this->mapping = nullptr;
+    this->mappingSize = 0;
+    this->events = nullptr;
+    this->count = 0;
+    this->position = 0;
+    return 0;
+}
+
+/**
+ *  @brief Gives how long until the next event is due.
+ *  @return Nanoseconds until the next event, 0 if one is due, -1 if the replay finished
+ */
+int64_t ReplaySource::nextDueNs()
+{
+    if (this->finished())
+        return -1;
+    if (!this->realtime || this->startNs == 0)
+        return 0;
+    uint64_t due = this->dueNs(this->position);
+    uint64_t now = monotonicNs();
+    return due > now ? (int64_t)(due - now) : 0;
+}
+
+/**
+ *  @brief Checks whether every event has been delivered.
+ *  @return true if finished
+ */
+bool ReplaySource::finished()
+{
+    return this->position >= this->count;
+}
+
+/**
+ *  @brief Gives the header of the open recording.
+ *  @return The header
+ */
+const RecordingHeader &ReplaySource::getHeader()
+{
+    return this->header;
+}
+
+/**
+ *  @brief Gives when an event is due, relative to the first read().
+ *  @param index The index of the event
+ *  @return The due time in CLOCK_MONOTONIC nanoseconds
+ */
+uint64_t ReplaySource::dueNs(size_t index)
+{
+    // Kernel millisecond stamps wrap at 32 bits, offsets are taken modulo that
+    uint32_t offsetMs = this->events[index].time - this->events[0].time;
+    return this->startNs + (uint64_t)offsetMs * 1000000ull;
+}
@@ -0,0 +1,389 @@
+#include "../include/gamepad/RumbleWriter.h"
+
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+/**
+ *  @brief Converts a motor strength to an ff_rumble_effect magnitude.
+ *  @param value The strength in [0, 1]
+ *  @return The magnitude
+ */
+static uint16_t toMagnitude(float value)
+{
+    return (uint16_t)(std::min(std::max(value, 0.0f), 1.0f) * 0xFFFF);
+}
+
+/**
+ *  @brief Initializes a RumbleWriter without a device.
+ *  @return The created RumbleWriter object
+ */
+RumbleWriter::RumbleWriter()
+{
+    this->fd = -1;
+    this->pending = false;
+    this->running = false;
+    this->error.store(0);
+}
+
+/**
+ *  @brief Destructor for RumbleWriter object, stops the writer and closes the device
+ */
+RumbleWriter::~RumbleWriter()
+{
+    this->close();
+}
+
+/**
+ *  @brief Opens the evdev node of a controller for writing and starts the writer thread.
+ *  @param path The path to the controller's 'jsX' or 'eventX' node, or a link to either
+ *  @return 0 on success, -1 on failure with errno set
+ */
+int RumbleWriter::open(const std::string &path)
+{
+    this->close();
+    this->path = path;
+    int newFd = this->openDevice();
+    if (newFd < 0)
+        return -1;
+    std::lock_guard<std::mutex> lock(this->slotsMutex);
+    this->fd = newFd;
+    this->slots.fill(Slot());
+    this->pending = false;
+    this->running = true;
+    this->writerThread = std::thread(&RumbleWriter::writerLoop, this);
+    return 0;
+}
+
+/**
+ *  @brief Stops the writer thread, erases uploaded effects and closes the device.
+ */
+void RumbleWriter::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->slotsMutex);
+        this->running = false;
+        this->wake.notify_one();
+    }
+    if (this->writerThread.joinable())
+        this->writerThread.join();
+    // The kernel erases the effects uploaded through this fd when it is closed
+    if (this->fd >= 0)
+        ::close(this->fd);
+    this->fd = -1;
+}
+
+/**
+ *  @brief Sets the rumble motors, replacing the previous request.
+ *  @param strong Low frequency motor in [0, 1]
+ *  @param weak High frequency motor in [0, 1]
+ *  @param duration How long to play, 0 to play until changed or stopped
+ */
+void RumbleWriter::setMagnitude(float strong, float weak, std::chrono::milliseconds duration)
+{
+    std::lock_guard<std::mutex> lock(this->slotsMutex);
+    Slot &slot = this->slots[0];
+    slot.used = true;
+    struct ff_effect &effect = slot.effect;
+    effect.type = FF_RUMBLE;
+    effect.u.rumble.strong_magnitude = toMagnitude(strong);
+    effect.u.rumble.weak_magnitude = toMagnitude(weak);
+    effect.replay.length = (uint16_t)std::min<int64_t>(duration.count(), 0xFFFF);
+    effect.replay.delay = 0;
+    bool silent = effect.u.rumble.strong_magnitude == 0 && effect.u.rumble.weak_magnitude == 0;
+    // Only the latest magnitude is uploaded, however often this is called in between
+    slot.uploadPending = !silent;
+    slot.playPending = silent ? 0 : 1;
+    slot.playing = !silent;
+    this->notify();
+}
+
+/**
+ *  @brief Stops the rumble motors.
+ */
+void RumbleWriter::stop()
+{
+    std::lock_guard<std::mutex> lock(this->slotsMutex);
+    if (!this->slots[0].used)
+        return;
+    this->slots[0].uploadPending = false;
+    this->slots[0].playPending = 0;
+    this->slots[0].playing = false;
+    this->notify();
+}
+
+/**
+ *  @brief Queues an effect for upload.
+ *  @param effect The effect, its id is ignored
+ *  @return A handle for playEffect() / stopEffect() / eraseEffect(), -1 if all slots are in use
+ */
+int RumbleWriter::uploadEffect(const struct ff_effect &effect)
+{
+    std::lock_guard<std::mutex> lock(this->slotsMutex);
+    // Slot 0 belongs to setMagnitude()
+    for (size_t i = 1; i < MAX_EFFECTS; i++)
+    {
+        Slot &slot = this->slots[i];
+        if (slot.used || slot.erasePending)
+            continue;
+        uint32_t generation = slot.generation + 1;
+        slot = Slot();
+        slot.generation = generation;
+        slot.used = true;
+        slot.effect = effect;
+        slot.uploadPending = true;
+        this->notify();
+        return (int)i;
+    }
+    return -1;
+}
+
+/**
+ *  @brief Queues a replacement for an uploaded effect.
+ *  @param handle The handle given by uploadEffect()
+ *  @param effect The new effect, its id is ignored
+ */
+void RumbleWriter::updateEffect(int handle, const struct ff_effect &effect)
+{
+    std::lock_guard<std::mutex> lock(this->slotsMutex);
+    if (handle <= 0 || handle >= (int)MAX_EFFECTS || !this->slots[handle].used)
+        return;
+    this->slots[handle].effect = effect;
+    this->slots[handle].uploadPending = true;
+    this->notify();
+}
+
+/**
+ *  @brief Queues playback of an effect.
+ *  @param handle The handle given by uploadEffect()
+ *  @param count Number of repetitions
+ */
+void RumbleWriter::playEffect(int handle, int count)
+{
+    std::lock_guard<std::mutex> lock(this->slotsMutex);
+    if (handle < 0 || handle >= (int)MAX_EFFECTS || !this->slots[handle].used)
+        return;
+    this->slots[handle].playPending = std::max(count, 1);
+    this->slots[handle].playing = true;
+    this->notify();
+}
+
+/**
+ *  @brief Queues stopping an effect.
+ *  @param handle The handle given by uploadEffect()
+ */
+void RumbleWriter::stopEffect(int handle)
+{
+    std::lock_guard<std::mutex> lock(this->slotsMutex);
+    if (handle < 0 || handle >= (int)MAX_EFFECTS || !this->slots[handle].used)
+        return;
+    this->slots[handle].playPending = 0;
+    this->slots[handle].playing = false;
+    this->notify();
+}
+
+/**
+ *  @brief Queues removal of an effect from the device, freeing its handle.
+ *  @param handle The handle given by uploadEffect()
+ */
+void RumbleWriter::eraseEffect(int handle)
+{
+    std::lock_guard<std::mutex> lock(this->slotsMutex);
+    if (handle <= 0 || handle >= (int)MAX_EFFECTS || !this->slots[handle].used)
+        return;
+    Slot &slot = this->slots[handle];
+    slot.used = false;
+    slot.playing = false;
+    slot.generation++;
+    slot.uploadPending = false;
+    slot.playPending = -1;
+    // Nothing to tell the kernel about an effect it never received
+    slot.erasePending = slot.kernelId >= 0;
+    if (slot.erasePending)
+        this->notify();
+}
+
+/**
+ *  @brief Gives the errno of the last failed ioctl or write on the writer thread.
+ *  @return The error, 0 if none
+ */
+int RumbleWriter::getError()
+{
+    return this->error.load(std::memory_order_relaxed);
+}
+
+/**
+ *  @brief Resolves and opens the evdev node for path.
+ *  @return The file descriptor, -1 on failure with errno set
+ */
+int RumbleWriter::openDevice()
+{
+    char resolved[PATH_MAX];
+    if (!realpath(this->path.c_str(), resolved))
+        return -1;
+    std::string node = resolved;
+    const char *name = strrchr(resolved, '/');
+    if (!name || strncmp(name + 1, "event", 5) != 0)
+    {
+        // joydev cannot do force feedback, its input device has an evdev node next to it
+        struct stat st;
+        if (stat(resolved, &st) < 0)
+            return -1;
+        char sysfs[128];
+        snprintf(sysfs, sizeof(sysfs), "/sys/dev/char/%u:%u/device", major(st.st_rdev), minor(st.st_rdev));
+        DIR *directory = opendir(sysfs);
+        if (!directory)
+            return -1;
+        node.clear();
+        while (struct dirent *entry = readdir(directory))
+        {
+            if (strncmp(entry->d_name, "event", 5) == 0)
+            {
+                node = std::string("/dev/input/") + entry->d_name;
+                break;
+            }
+        }
+        closedir(directory);
+        if (node.empty())
+        {
+            errno = ENODEV;
+            return -1;
+        }
+    }
+    return ::open(node.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+}
+
+/**
+ *  @brief Body of the writer thread.
+ */
+void RumbleWriter::writerLoop()
+{
+    std::array<Slot, MAX_EFFECTS> work;
+    std::unique_lock<std::mutex> lock(this->slotsMutex);
+    while (this->running)
+    {
+        if (!this->pending)
+        {
+            this->wake.wait(lock);
+            continue;
+        }
+        if (this->fd < 0)
+        {
+            lock.unlock();
+            int newFd = this->openDevice();
+            lock.lock();
+            if (newFd < 0)
+            {
+                // Still unplugged, try again later unless new requests arrive first
+                this->wake.wait_for(lock, REOPEN_INTERVAL);
+                continue;
+            }
+            this->fd = newFd;
+        }
+
+        // Take the latest state of every dirty slot, later requests coalesce into the next pass
+        this->pending = false;
+        work = this->slots;
+        for (Slot &slot : this->slots)
+        {
+            slot.uploadPending = false;
+            slot.erasePending = false;
+            slot.playPending = -1;
+        }
+        int device = this->fd;
+        lock.unlock();
+
+        bool alive = true;
+        for (size_t i = 0; i < MAX_EFFECTS && alive; i++)
+        {
+            Slot &slot = work[i];
+            if (slot.uploadPending || slot.erasePending || slot.playPending >= 0)
+                alive = this->apply(slot);
+        }
+
+        lock.lock();
+        for (size_t i = 0; i < MAX_EFFECTS; i++)
+        {
+            // A handle freed or reused meanwhile must not inherit the old kernel id
+            if (this->slots[i].generation == work[i].generation)
+                this->slots[i].kernelId = work[i].kernelId;
+        }
+        if (!alive)
+        {
+            // Device went away, the kernel dropped our effects, redo them once it is back
+            ::close(device);
+            this->fd = -1;
+            for (Slot &slot : this->slots)
+            {
+                slot.kernelId = -1;
+                slot.erasePending = false;
+                slot.uploadPending = slot.used;
+                slot.playPending = slot.used && slot.playing ? 1 : -1;
+            }
+            this->pending = true;
+        }
+    }
+}
+
+/**
+ *  @brief Performs the pending operations of one slot on the device.
+ *  @param slot The slot state copied out of slots
+ *  @return false if the device is gone
+ */
+bool RumbleWriter::apply(Slot &slot)
+{
+    if (slot.erasePending)
+    {
+        if (slot.kernelId >= 0 && ioctl(this->fd, EVIOCRMFF, slot.kernelId) < 0 && errno == ENODEV)
+            return false;
+        slot.kernelId = -1;
+        return true;
+    }
+    if (slot.uploadPending)
+    {
+        // An id of -1 asks the kernel for a new effect, an existing id updates it in place
+        slot.effect.id = slot.kernelId;
+        if (ioctl(this->fd, EVIOCSFF, &slot.effect) < 0)
+        {
+            this->error.store(errno, std::memory_order_relaxed);
+            if (errno == ENODEV)
+                return false;
+        }
+        else
+        {
+            slot.kernelId = slot.effect.id;
+        }
+    }
+    if (slot.playPending >= 0 && slot.kernelId >= 0)
+    {
+        struct input_event event{};
+        event.type = EV_FF;
+        event.code = (uint16_t)slot.kernelId;
+        event.value = slot.playPending;
+        if (write(this->fd, &event, sizeof(event)) < 0)
+        {
+            this->error.store(errno, std::memory_order_relaxed);
+            if (errno == ENODEV)
+                return false;
+        }
+    }
+    return true;
+}
+
+/**
+ *  @brief Marks a slot dirty and wakes the writer, with slotsMutex held.
+ */
+void RumbleWriter::notify()
+{
+    this->pending = true;
+    this->wake.notify_one();
+}
@@ -0,0 +1,497 @@
+#include "../include/gamepad/SharedGamepad.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <time.h>
+
+static_assert(sizeof(JSEvent) == sizeof(uint64_t), "events travel through the ring as one word");
+static_assert((SharedGamepadSegment::EVENT_SLOTS & (SharedGamepadSegment::EVENT_SLOTS - 1)) == 0,
+              "SharedGamepadSegment::EVENT_SLOTS must be a power of two");
+
+/**
+ *  @brief Gives the current CLOCK_MONOTONIC time, which is shared by every process.
+ *  @return The time in nanoseconds
+ */
+static uint64_t monotonicNs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/**
+ *  @brief Initializes a SharedGamepadPublisher for a Gamepad, without creating the segment.
+ *  @param gamepad The Gamepad to publish, must outlive the publisher
+ *  @return The created SharedGamepadPublisher object
+ */
+SharedGamepadPublisher::SharedGamepadPublisher(Gamepad &gamepad) : gamepad(gamepad)
+{
+    this->segment = nullptr;
+    this->historySeen = 0;
+    this->stateVersion = 0;
+    this->lastStatus = OK;
+}
+
+/**
+ *  @brief Destructor for SharedGamepadPublisher object, removes the segment
+ */
+SharedGamepadPublisher::~SharedGamepadPublisher()
+{
+    this->close();
+}
+
+/**
+ *  @brief Creates the segment and publishes the current state.
+ *  @param name The shm_open() name, e.g. "/gamepad0"
+ *  @return 0 on success, -1 on failure with errno set
+ */
+int SharedGamepadPublisher::open(const std::string &name)
+{
+    this->close();
+    // A segment left by a crashed publisher is replaced, views still mapping it keep its last state
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return -1;
+    void *memory = MAP_FAILED;
+    if (ftruncate(fd, sizeof(SharedGamepadSegment)) == 0)
+        memory = mmap(nullptr, sizeof(SharedGamepadSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int err = errno;
+    ::close(fd);
+    if (memory == MAP_FAILED)
+    {
+        shm_unlink(name.c_str());
+        errno = err;
+        return -1;
+    }
+
+    this->segment = new (memory) SharedGamepadSegment();
+    this->name = name;
+    this->segment->version = SharedGamepadSegment::VERSION;
+    this->segment->size = sizeof(SharedGamepadSegment);
+    DeviceIdentity identity = this->gamepad.getIdentity();
+    std::strncpy(this->segment->name, identity.name.c_str(), SharedGamepadSegment::NAME_SIZE - 1);
+    this->segment->busType = identity.busType;
+    this->segment->vendor = identity.vendor;
+    this->segment->product = identity.product;
+    this->segment->hardwareVersion = identity.version;
+
+    this->gamepad.enableHistory();
+    this->historySeen = this->gamepad.getHistory()->pushed();
+    this->lastStatus = this->gamepad.getStatus();
+    this->segment->status.store(this->lastStatus, std::memory_order_relaxed);
+    // Version first, a state published in between is then simply stored again
+    this->stateVersion = this->gamepad.getStateVersion();
+    this->segment->state.store(this->gamepad.snapshot());
+    this->segment->publishedNs.store(monotonicNs(), std::memory_order_relaxed);
+    // Views refuse the segment until everything above is visible
+    this->segment->magic.store(SharedGamepadSegment::MAGIC, std::memory_order_release);
+    return 0;
+}
+
+/**
+ *  @brief Unmaps and removes the segment, mapped views keep their last state.
+ */
+void SharedGamepadPublisher::close()
+{
+    if (!this->segment)
+        return;
+    munmap(this->segment, sizeof(SharedGamepadSegment));
+    shm_unlink(this->name.c_str());
+    this->segment = nullptr;
+}
+
+/**
+ *  @brief Writes the state and the events applied since the last call.
+ */
+void SharedGamepadPublisher::publish()
+{
+    if (!this->segment)
+        return;
+    SharedGamepadSegment &segment = *this->segment;
+
+    const EventHistory<Gamepad::HISTORY_SIZE> *history = this->gamepad.getHistory();
+    uint64_t fresh = history->pushed() - this->historySeen;
+    size_t held = history->size();
+    if (fresh > held)
+    {
+        // Overwritten in the history before this call, publish() ran too rarely
+        segment.droppedEvents.store(segment.droppedEvents.load(std::memory_order_relaxed) + fresh - held,
+                                    std::memory_order_relaxed);
+        fresh = held;
+    }
+    uint64_t tail = segment.eventTail.load(std::memory_order_relaxed);
+    for (size_t i = held - fresh; i < held; i++)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &history->at(i), sizeof(bits));
+        SharedGamepadSegment::Slot &slot = segment.events[tail & (SharedGamepadSegment::EVENT_SLOTS - 1)];
+        // Per-slot seqlock: a reader that raced this write sees a sequence mismatch
+        slot.sequence.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.event.store(bits, std::memory_order_relaxed);
+        slot.sequence.store(tail + 1, std::memory_order_release);
+        tail++;
+    }
+    segment.eventTail.store(tail, std::memory_order_release);
+    this->historySeen = history->pushed();
+
+    int32_t status = this->gamepad.getStatus();
+    // Compared with what was last stored, not with the last refresh(): calls can skip refreshes,
+    // and a reopen can change the counts without changing a value
+    uint32_t version = this->gamepad.getStateVersion();
+    if (version != this->stateVersion || status != this->lastStatus)
+    {
+        this->stateVersion = version;
+        segment.state.store(this->gamepad.snapshot());
+    }
+    if (status != this->lastStatus)
+        segment.status.store(status, std::memory_order_release);
+    this->lastStatus = status;
+    segment.publishedNs.store(monotonicNs(), std::memory_order_relaxed);
+}
+
+/**
+ *  @brief Checks whether the segment exists.
+ *  @return true between a successful open() and close()
+ */
+bool SharedGamepadPublisher::isOpen()
+{
+    return this->segment != nullptr;
+}
+
+/**
+ *  @brief Initializes a SharedGamepadView that is not mapped yet.
+ *  @return The created SharedGamepadView object
+ */
+SharedGamepadView::SharedGamepadView()
+{
+    this->segment = nullptr;
+    this->stateVersion = 0;
+    this->eventHead = 0;
+    this->dropped = 0;
+    this->publisherDroppedAtOpen = 0;
+    this->pendingHead = 0;
+    this->pendingCount = 0;
+}
+
+/**
+ *  @brief Destructor for SharedGamepadView object, unmaps the segment
+ */
+SharedGamepadView::~SharedGamepadView()
+{
+    this->close();
+}
+
+/**
+ *  @brief Maps a segment created by a SharedGamepadPublisher.
+ *  @param name The shm_open() name given to the publisher
+ *  @return 0 on success, -1 on failure with errno set
+ */
+int SharedGamepadView::open(const std::string &name)
+{
+    this->close();
+    int fd = shm_open(name.c_str(), O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+    struct stat info;
+    if (fstat(fd, &info) < 0)
+    {
+        int err = errno;
+        ::close(fd);
+        errno = err;
+        return -1;
+    }
+    if ((size_t)info.st_size < sizeof(SharedGamepadSegment))
+    {
+        ::close(fd);
+        // Still empty if the publisher hasn't sized it yet
+        errno = info.st_size == 0 ? EAGAIN : EPROTO;
+        return -1;
+    }
+    void *memory = mmap(nullptr, sizeof(SharedGamepadSegment), PROT_READ, MAP_SHARED, fd, 0);
+    int err = errno;
+    ::close(fd);
+    if (memory == MAP_FAILED)
+    {
+        errno = err;
+        return -1;
+    }
+
+    const SharedGamepadSegment *segment = static_cast<const SharedGamepadSegment *>(memory);
+    uint32_t magic = segment->magic.load(std::memory_order_acquire);
+    if (magic != SharedGamepadSegment::MAGIC || segment->version != SharedGamepadSegment::VERSION ||
+        segment->size != sizeof(SharedGamepadSegment))
+    {
+        munmap(memory, sizeof(SharedGamepadSegment));
+        errno = magic == 0 ? EAGAIN : EPROTO;
+        return -1;
+    }
+
+    this->segment = segment;
+    this->state = GamepadState();
+    // Differs from any version, so the first refresh() loads the state
+    this->stateVersion = segment->state.version() - 1;
+    this->eventHead = segment->eventTail.load(std::memory_order_acquire);
+    this->dropped = 0;
+    this->publisherDroppedAtOpen = segment->droppedEvents.load(std::memory_order_relaxed);
+    this->pendingHead = 0;
+    this->pendingCount = 0;
+    return 0;
+}
+
+/**
+ *  @brief Unmaps the segment.
+ */
+void SharedGamepadView::close()
+{
+    if (!this->segment)
+        return;
+    munmap(const_cast<SharedGamepadSegment *>(this->segment), sizeof(SharedGamepadSegment));
+    this->segment = nullptr;
+}
+
+/**
+ *  @brief Checks whether a segment is mapped.
+ *  @return true between a successful open() and close()
+ */
+bool SharedGamepadView::isOpen()
+{
+    return this->segment != nullptr;
+}
+
+/**
+ *  @brief Takes the latest published state and collects the new events.
+ */
+void SharedGamepadView::refresh()
+{
+    this->axisChanges.clear();
+    this->buttonChanges.clear();
+    this->presses.clear();
+    this->releases.clear();
+    if (!this->segment)
+        return;
+
+    uint32_t version = this->segment->state.version();
+    if (version != this->stateVersion)
+    {
+        GamepadState next = this->segment->state.load();
+        for (size_t i = 0; i < GamepadState::MAX_AXES; i++)
+            if (next.axes[i] != this->state.axes[i])
+                this->axisChanges.set(i);
+        for (size_t i = 0; i < GamepadState::MAX_BUTTONS; i++)
+        {
+            if (next.buttons[i] == this->state.buttons[i])
+                continue;
+            this->buttonChanges.set(i);
+            if (next.buttons[i])
+                this->presses.set(i);
+            else
+                this->releases.set(i);
+        }
+        this->state = next;
+        this->stateVersion = version;
+    }
+    this->collectEvents();
+}
+
+/**
+ *  @brief Pops the oldest event collected by refresh().
+ *  @param event Reference to write the event into
+ *  @return true if an event was popped
+ */
+bool SharedGamepadView::popEvent(JSEvent &event)
+{
+    if (!this->pendingCount)
+        return false;
+    event = this->pending[this->pendingHead];
+    this->pendingHead = (this->pendingHead + 1) % PENDING_SIZE;
+    this->pendingCount--;
+    return true;
+}
+
+/**
+ *  @brief Gives the state of an axis as of the last refresh().
+ *  @param index The index of the axis
+ *  @return The value, 0 if out of range
+ */
+short SharedGamepadView::getAxis(int index)
+{
+    if (index < 0 || (size_t)index >= GamepadState::MAX_AXES)
+        return 0;
+    return this->state.axes[index];
+}
+
+/**
+ *  @brief Gives the state of a button as of the last refresh().
+ *  @param index The index of the button
+ *  @return The value, 0 if out of range
+ */
+short SharedGamepadView::getButton(int index)
+{
+    if (index < 0 || (size_t)index >= GamepadState::MAX_BUTTONS)
+        return 0;
+    return this->state.buttons[index];
+}
+
+/**
+ *  @brief Checks whether a button went down in the last refresh().
+ *  @param index The index of the button
+ *  @return true if it was pressed
+ */
+bool SharedGamepadView::wasPressed(int index)
+{
+    return index >= 0 && (size_t)index < GamepadState::MAX_BUTTONS && this->presses.test(index);
+}
+
+/**
+ *  @brief Checks whether a button went up in the last refresh().
+ *  @param index The index of the button
+ *  @return true if it was released
+ */
+bool SharedGamepadView::wasReleased(int index)
+{
+    return index >= 0 && (size_t)index < GamepadState::MAX_BUTTONS && this->releases.test(index);
+}
+
+/**
+ *  @brief Gives the axes that changed in the last refresh().
+ *  @return The mask
+ */
+const BitMask<GamepadState::MAX_AXES> &SharedGamepadView::changedAxes()
+{
+    return this->axisChanges;
+}
+
+/**
+ *  @brief Gives the buttons that changed in the last refresh().
+ *  @return The mask
+ */
+const BitMask<GamepadState::MAX_BUTTONS> &SharedGamepadView::changedButtons()
+{
+    return this->buttonChanges;
+}
+
+/**
+ *  @brief Gives the whole state as of the last refresh().
+ *  @return The state
+ */
+const GamepadState &SharedGamepadView::snapshot()
+{
+    return this->state;
+}
+
+/**
+ *  @brief Gives the number of axes the device reports.
+ *  @return The axis count
+ */
+int SharedGamepadView::getAxisCount()
+{
+    return this->state.axisCount;
+}
+
+/**
+ *  @brief Gives the number of buttons the device reports.
+ *  @return The button count
+ */
+int SharedGamepadView::getButtonCount()
+{
+    return this->state.buttonCount;
+}
+
+/**
+ *  @brief Gives the status of the publisher's Gamepad.
+ *  @return The status, INVALID_FILE_ERROR if no segment is mapped
+ */
+GamepadStatus SharedGamepadView::getStatus()
+{
+    if (!this->segment)
+        return INVALID_FILE_ERROR;
+    return (GamepadStatus)this->segment->status.load(std::memory_order_acquire);
+}
+
+/**
+ *  @brief Checks whether the publisher's Gamepad is in an error state.
+ *  @return true if the status is not OK
+ */
+bool SharedGamepadView::getErr()
+{
+    return this->getStatus() != OK;
+}
+
+/**
+ *  @brief Gives the device name published by the publisher.
+ *  @return The name, empty if no segment is mapped
+ */
+std::string SharedGamepadView::getName()
+{
+    if (!this->segment)
+        return std::string();
+    return std::string(this->segment->name, strnlen(this->segment->name, SharedGamepadSegment::NAME_SIZE));
+}
+
+/**
+ *  @brief Gives the time since the publisher last called publish().
+ *  @return The age in nanoseconds, lets readers notice a publisher that died
+ */
+uint64_t SharedGamepadView::getPublishAgeNs()
+{
+    if (!this->segment)
+        return 0;
+    uint64_t published = this->segment->publishedNs.load(std::memory_order_relaxed);
+    uint64_t now = monotonicNs();
+    return now > published ? now - published : 0;
+}
+
+/**
+ *  @brief Gives the number of events this view missed because the writer lapped it.
+ *  @return The count, including events the publisher itself dropped since open()
+ */
+uint64_t SharedGamepadView::getDroppedEvents()
+{
+    if (!this->segment)
+        return this->dropped;
+    return this->dropped + this->segment->droppedEvents.load(std::memory_order_relaxed) - this->publisherDroppedAtOpen;
+}
+
+/**
+ *  @brief Copies the events published since the last call into pending.
+ */
+void SharedGamepadView::collectEvents()
+{
+    uint64_t tail = this->segment->eventTail.load(std::memory_order_acquire);
+    if (tail - this->eventHead > SharedGamepadSegment::EVENT_SLOTS)
+    {
+        // Lapped: the oldest unread slots already hold newer events
+        this->dropped += tail - SharedGamepadSegment::EVENT_SLOTS - this->eventHead;
+        this->eventHead = tail - SharedGamepadSegment::EVENT_SLOTS;
+    }
+    for (; this->eventHead < tail; this->eventHead++)
+    {
+        const SharedGamepadSegment::Slot &slot = this->segment->events[this->eventHead & (SharedGamepadSegment::EVENT_SLOTS - 1)];
+        uint64_t before = slot.sequence.load(std::memory_order_acquire);
+        uint64_t bits = slot.event.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t after = slot.sequence.load(std::memory_order_relaxed);
+        if (before != this->eventHead + 1 || after != before)
+        {
+            // Overwritten while we were getting to it
+            this->dropped++;
+            continue;
+        }
+        if (this->pendingCount == PENDING_SIZE)
+        {
+            // Nobody popped, keep the newest events
+            this->pendingHead = (this->pendingHead + 1) % PENDING_SIZE;
+            this->pendingCount--;
+            this->dropped++;
+        }
+        std::memcpy(&this->pending[(this->pendingHead + this->pendingCount) % PENDING_SIZE], &bits, sizeof(bits));
+        this->pendingCount++;
+    }
+}
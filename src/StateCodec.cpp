@@ -0,0 +1,351 @@
+#include "../include/gamepad/StateCodec.h"
+
+#include <cerrno>
+
+static constexpr size_t BUTTON_GROUPS = GamepadState::MAX_BUTTONS / 8;
+static constexpr size_t BUTTON_WORDS = GamepadState::MAX_BUTTONS / 64;
+
+static_assert(GamepadState::MAX_AXES <= 64, "axis mask is a single varint");
+static_assert(BUTTON_GROUPS <= 64, "button group mask is a single varint");
+
+/**
+ *  @brief Appends an unsigned LEB128 varint.
+ *  @param value The value
+ *  @param out Where to write, advanced past the varint
+ */
+static void putVarint(uint64_t value, uint8_t *&out)
+{
+    while (value >= 0x80)
+    {
+        *out++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = (uint8_t)value;
+}
+
+/**
+ *  @brief Reads an unsigned LEB128 varint.
+ *  @param data Where to read, advanced past the varint
+ *  @param end One past the last readable byte
+ *  @param value Receives the value
+ *  @return false if the varint is truncated or too long
+ */
+static bool getVarint(const uint8_t *&data, const uint8_t *end, uint64_t &value)
+{
+    value = 0;
+    for (unsigned shift = 0; shift < 64 && data < end; shift += 7)
+    {
+        uint8_t byte = *data++;
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+/**
+ *  @brief Maps small signed deltas to small unsigned values: 0, -1, 1, -2, ...
+ *  @param value The delta
+ *  @return The zigzag encoding
+ */
+static uint64_t zigzag(int32_t value)
+{
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+/**
+ *  @brief Reverses zigzag().
+ *  @param value The zigzag encoding
+ *  @return The delta
+ */
+static int32_t unzigzag(uint64_t value)
+{
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+/**
+ *  @brief Initializes a StateEncoder whose first packet is a keyframe.
+ *  @return The created StateEncoder object
+ */
+StateEncoder::StateEncoder()
+{
+    this->sequence = 0;
+    this->keyframeInterval = 0;
+    this->sinceKeyframe = 0;
+    this->keyframePending = true;
+}
+
+/**
+ *  @brief Encodes the controls marked in the change masks that differ from the last packet.
+ *  @param state The current state
+ *  @param axisChanges Axes that may have changed since the last call
+ *  @param buttonChanges Buttons that may have changed since the last call
+ *  @param out Buffer of at least StatePacket::MAX_SIZE bytes
+ *  @return The packet size, 0 if nothing changed and no packet needs to be sent
+ */
+size_t StateEncoder::encode(const GamepadState &state, const BitMask<GamepadState::MAX_AXES> &axisChanges,
+                            const BitMask<GamepadState::MAX_BUTTONS> &buttonChanges, uint8_t *out)
+{
+    return this->encodeDiff(state, axisChanges.data()[0], buttonChanges.data().data(), out);
+}
+
+/**
+ *  @brief Encodes every control that differs from the last packet, without change masks.
+ *  @param state The current state
+ *  @param out Buffer of at least StatePacket::MAX_SIZE bytes
+ *  @return The packet size, 0 if nothing changed and no packet needs to be sent
+ */
+size_t StateEncoder::encode(const GamepadState &state, uint8_t *out)
+{
+    uint64_t all[BUTTON_WORDS];
+    for (uint64_t &word : all)
+        word = ~uint64_t(0);
+    return this->encodeDiff(state, ~uint64_t(0), all, out);
+}
+
+/**
+ *  @brief Makes the next packet a keyframe, e.g. when the decoder reports a gap.
+ */
+void StateEncoder::requestKeyframe()
+{
+    this->keyframePending = true;
+}
+
+/**
+ *  @brief Sends a keyframe every so many packets, so lossy transports recover on their own.
+ *  @param packets The interval, 0 to only send keyframes on request
+ */
+void StateEncoder::setKeyframeInterval(uint32_t packets)
+{
+    this->keyframeInterval = packets;
+}
+
+/**
+ *  @brief Encodes the candidates that differ from sent and updates sent.
+ *  @param state The current state
+ *  @param axisCandidates Axes to compare
+ *  @param buttonWords Buttons to compare, one bit per button
+ *  @param out Buffer of at least StatePacket::MAX_SIZE bytes
+ *  @return The packet size, 0 if nothing needs to be sent
+ */
+size_t StateEncoder::encodeDiff(const GamepadState &state, uint64_t axisCandidates, const uint64_t *buttonWords, uint8_t *out)
+{
+    bool keyframe = this->keyframePending || state.axisCount != this->sent.axisCount ||
+                    state.buttonCount != this->sent.buttonCount ||
+                    (this->keyframeInterval && this->sinceKeyframe >= this->keyframeInterval);
+    uint64_t allButtons[BUTTON_WORDS];
+    if (keyframe)
+    {
+        // Everything that isn't zero, against a fresh state
+        this->sent = GamepadState();
+        this->sent.axisCount = state.axisCount;
+        this->sent.buttonCount = state.buttonCount;
+        axisCandidates = ~uint64_t(0);
+        for (uint64_t &word : allButtons)
+            word = ~uint64_t(0);
+        buttonWords = allButtons;
+    }
+
+    uint64_t axisMask = 0;
+    if (state.axisCount < 64)
+        axisCandidates &= (uint64_t(1) << state.axisCount) - 1;
+    for (uint64_t bits = axisCandidates; bits; bits &= bits - 1)
+    {
+        size_t axis = __builtin_ctzll(bits);
+        if (state.axes[axis] != this->sent.axes[axis])
+            axisMask |= uint64_t(1) << axis;
+    }
+
+    // Buttons travel as pressed/released toggles, eight per byte
+    uint8_t toggles[BUTTON_GROUPS] = {};
+    uint64_t groupMask = 0;
+    for (size_t word = 0; word < BUTTON_WORDS; word++)
+    {
+        for (uint64_t bits = buttonWords[word]; bits; bits &= bits - 1)
+        {
+            size_t button = word * 64 + __builtin_ctzll(bits);
+            if (button >= state.buttonCount)
+                break;
+            if ((state.buttons[button] != 0) != (this->sent.buttons[button] != 0))
+            {
+                toggles[button / 8] |= 1 << (button % 8);
+                groupMask |= uint64_t(1) << (button / 8);
+            }
+        }
+    }
+
+    if (!keyframe && !axisMask && !groupMask)
+        return 0;
+
+    uint8_t *cursor = out;
+    *cursor++ = keyframe ? StatePacket::FLAG_KEYFRAME : 0;
+    putVarint(this->sequence++, cursor);
+    if (keyframe)
+    {
+        putVarint(state.axisCount, cursor);
+        putVarint(state.buttonCount, cursor);
+    }
+    putVarint(axisMask, cursor);
+    for (uint64_t bits = axisMask; bits; bits &= bits - 1)
+    {
+        size_t axis = __builtin_ctzll(bits);
+        putVarint(zigzag((int32_t)state.axes[axis] - this->sent.axes[axis]), cursor);
+        this->sent.axes[axis] = state.axes[axis];
+    }
+    putVarint(groupMask, cursor);
+    for (uint64_t bits = groupMask; bits; bits &= bits - 1)
+    {
+        size_t group = __builtin_ctzll(bits);
+        *cursor++ = toggles[group];
+        for (size_t bit = 0; bit < 8; bit++)
+            if (toggles[group] >> bit & 1)
+                this->sent.buttons[group * 8 + bit] = !this->sent.buttons[group * 8 + bit];
+    }
+
+    this->keyframePending = false;
+    this->sinceKeyframe = keyframe ? 0 : this->sinceKeyframe + 1;
+    return cursor - out;
+}
+
+/**
+ *  @brief Initializes a StateDecoder waiting for a keyframe.
+ *  @return The created StateDecoder object
+ */
+StateDecoder::StateDecoder()
+{
+    this->expected = 0;
+    this->synced = false;
+}
+
+/**
+ *  @brief Applies one packet to the state.
+ *  @param data The packet
+ *  @param size The packet size in bytes
+ *  @param state The state to update, only touched on success
+ *  @param axisChanges Optional mask receiving the axes the packet changed
+ *  @param buttonChanges Optional mask receiving the buttons the packet changed
+ *  @return 0 on success, -1 with errno set to EBADMSG, EALREADY or EPROTO
+ */
+int StateDecoder::decode(const uint8_t *data, size_t size, GamepadState &state,
+                         BitMask<GamepadState::MAX_AXES> *axisChanges,
+                         BitMask<GamepadState::MAX_BUTTONS> *buttonChanges)
+{
+    const uint8_t *end = data + size;
+    uint64_t sequence;
+    if (size < 2)
+    {
+        errno = EBADMSG;
+        return -1;
+    }
+    bool keyframe = *data++ & StatePacket::FLAG_KEYFRAME;
+    if (!getVarint(data, end, sequence))
+    {
+        errno = EBADMSG;
+        return -1;
+    }
+    // Wrap-safe: negative means older than the last applied packet
+    int32_t distance = (int32_t)((uint32_t)sequence - this->expected);
+    if (this->synced && distance < 0)
+    {
+        errno = EALREADY;
+        return -1;
+    }
+    if (!keyframe && (!this->synced || distance > 0))
+    {
+        // A delta against a state we never saw, only a keyframe can fix that
+        this->synced = false;
+        errno = EPROTO;
+        return -1;
+    }
+
+    GamepadState next = state;
+    if (keyframe)
+    {
+        uint64_t axisCount, buttonCount;
+        if (!getVarint(data, end, axisCount) || !getVarint(data, end, buttonCount) ||
+            axisCount > GamepadState::MAX_AXES || buttonCount > GamepadState::MAX_BUTTONS)
+        {
+            errno = EBADMSG;
+            return -1;
+        }
+        next = GamepadState();
+        next.axisCount = (uint16_t)axisCount;
+        next.buttonCount = (uint16_t)buttonCount;
+    }
+
+    uint64_t axisMask, groupMask;
+    if (!getVarint(data, end, axisMask))
+    {
+        errno = EBADMSG;
+        return -1;
+    }
+    for (uint64_t bits = axisMask; bits; bits &= bits - 1)
+    {
+        size_t axis = __builtin_ctzll(bits);
+        uint64_t delta;
+        if (axis >= next.axisCount || !getVarint(data, end, delta))
+        {
+            errno = EBADMSG;
+            return -1;
+        }
+        int32_t value = next.axes[axis] + unzigzag(delta);
+        if (value < -32768 || value > 32767)
+        {
+            errno = EBADMSG;
+            return -1;
+        }
+        next.axes[axis] = (short)value;
+    }
+    if (!getVarint(data, end, groupMask))
+    {
+        errno = EBADMSG;
+        return -1;
+    }
+    for (uint64_t bits = groupMask; bits; bits &= bits - 1)
+    {
+        size_t group = __builtin_ctzll(bits);
+        if (group * 8 >= next.buttonCount || data >= end)
+        {
+            errno = EBADMSG;
+            return -1;
+        }
+        uint8_t toggles = *data++;
+        for (size_t bit = 0; bit < 8; bit++)
+        {
+            size_t button = group * 8 + bit;
+            if (!(toggles >> bit & 1))
+                continue;
+            if (button >= next.buttonCount)
+            {
+                errno = EBADMSG;
+                return -1;
+            }
+            next.buttons[button] = !next.buttons[button];
+        }
+    }
+    if (data != end)
+    {
+        errno = EBADMSG;
+        return -1;
+    }
+
+    for (size_t axis = 0; axisChanges && axis < GamepadState::MAX_AXES; axis++)
+        if (next.axes[axis] != state.axes[axis])
+            axisChanges->set(axis);
+    for (size_t button = 0; buttonChanges && button < GamepadState::MAX_BUTTONS; button++)
+        if (next.buttons[button] != state.buttons[button])
+            buttonChanges->set(button);
+    state = next;
+    this->expected = (uint32_t)sequence + 1;
+    this->synced = true;
+    return 0;
+}
+
+/**
+ *  @brief Checks whether deltas are being refused until the next keyframe.
+ *  @return true if a keyframe should be requested from the encoder
+ */
+bool StateDecoder::needsKeyframe() const
+{
+    return !this->synced;
+}
@@ -0,0 +1,69 @@
+#include "../include/gamepad/ThreadConfig.h"
+
+#include <alloca.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <cerrno>
+
+// Stack is faulted in one page at a time
+static constexpr size_t PAGE_SIZE_GUESS = 4096;
+
+/**
+ *  @brief Applies the CPU affinity and scheduling policy to a running thread.
+ *  @param thread The thread
+ *  @return 0 on success, -1 on failure with errno set
+ */
+int ThreadConfig::apply(pthread_t thread) const
+{
+    if (this->cpuMask)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (size_t cpu = 0; cpu < 64; cpu++)
+            if (this->cpuMask >> cpu & 1)
+                CPU_SET(cpu, &set);
+        int err = pthread_setaffinity_np(thread, sizeof(set), &set);
+        if (err)
+        {
+            errno = err;
+            return -1;
+        }
+    }
+    if (this->priority > 0)
+    {
+        struct sched_param param{};
+        param.sched_priority = this->priority;
+        int err = pthread_setschedparam(thread, SCHED_FIFO, &param);
+        if (err)
+        {
+            errno = err;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ *  @brief Locks the process' memory if lockMemory is set.
+ *  @return 0 on success or if nothing was requested, -1 on failure with errno set
+ */
+int ThreadConfig::lockProcessMemory() const
+{
+    if (!this->lockMemory)
+        return 0;
+    // MCL_FUTURE also faults in everything mapped later, e.g. ring buffers and thread stacks
+    return mlockall(MCL_CURRENT | MCL_FUTURE);
+}
+
+/**
+ *  @brief Touches stackPrefault bytes of the calling thread's stack so later use doesn't fault.
+ */
+void ThreadConfig::prefaultStack() const
+{
+    if (!this->stackPrefault)
+        return;
+    // The pages stay mapped after alloca()'s frame is gone
+    volatile char *stack = static_cast<volatile char *>(alloca(this->stackPrefault));
+    for (size_t offset = 0; offset < this->stackPrefault; offset += PAGE_SIZE_GUESS)
+        stack[offset] = 0;
+}
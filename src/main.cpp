@@ -1,17 +1,20 @@
-#include "../include/gamepad/Gamepad.h"
+#include "../include/gamepad/BasicGamepad.h"
 
 #include <iostream>
 
 int main()
 {
-    Gamepad gamepad = Gamepad("/dev/input/js0");
-    std::array<std::string, 6> buttonNames{"A", "B", "X", "Y", "LB", "RB"};
-    while (!(gamepad.getButton(0) && gamepad.getButton(3)))
+    XboxGamepad gamepad("/dev/input/js0");
+    while (!(gamepad.get<XboxLayout::Button::A>() && gamepad.get<XboxLayout::Button::Y>()))
     {
-        gamepad.refresh();
+        // Sleep until input arrives instead of spinning on refresh()
+        gamepad.waitForEvent(std::chrono::milliseconds(100));
+        // Only redraw when a button actually changed
+        if (!gamepad.changedButtons().any())
+            continue;
         std::cout << "\r";
-        for (int i = 0; i < buttonNames.size(); i++) {
-            std::cout << buttonNames[i] + ": " << gamepad.getButton(i) << " | ";
+        for (size_t i = 0; i < XboxLayout::BUTTONS; i++) {
+            std::cout << XboxLayout::BUTTON_NAMES[i] << ": " << gamepad.getButton(i) << " | ";
         }
     }
-}
\ No newline at end of file
+}
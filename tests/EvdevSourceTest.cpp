@@ -0,0 +1,134 @@
+#include "../include/gamepad/EvdevSource.h"
+#include "../include/gamepad/JSEvent.h"
+#include "TestCheck.h"
+
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdarg>
+#include <cstring>
+#include <linux/input.h>
+
+// The read end of the pipe standing in for an evdev node
+static int deviceFd = -1;
+
+/**
+ *  @brief Answers the evdev ioctls for the fake device, 2 axes (ABS_X, ABS_Y) and BTN_SOUTH.
+ *  @details Defined in the test binary, so it takes precedence over the C library one.
+ */
+extern "C" int ioctl(int fd, unsigned long request, ...) noexcept
+{
+    va_list arguments;
+    va_start(arguments, request);
+    void *argument = va_arg(arguments, void *);
+    va_end(arguments);
+    if (fd != deviceFd || _IOC_TYPE(request) != 'E')
+    {
+        errno = ENOTTY;
+        return -1;
+    }
+
+    unsigned int number = _IOC_NR(request);
+    unsigned int size = _IOC_SIZE(request);
+    const size_t width = sizeof(unsigned long) * 8;
+    if (number == _IOC_NR(EVIOCGBIT(EV_ABS, 0)) || number == _IOC_NR(EVIOCGBIT(EV_KEY, 0)))
+    {
+        unsigned long *bits = static_cast<unsigned long *>(argument);
+        std::memset(bits, 0, size);
+        if (number == _IOC_NR(EVIOCGBIT(EV_ABS, 0)))
+        {
+            bits[ABS_X / width] |= 1UL << (ABS_X % width);
+            bits[ABS_Y / width] |= 1UL << (ABS_Y % width);
+        }
+        else
+            bits[BTN_SOUTH / width] |= 1UL << (BTN_SOUTH % width);
+        return 0;
+    }
+    if (number == _IOC_NR(EVIOCGKEY(0)))
+    {
+        std::memset(argument, 0, size);
+        return 0;
+    }
+    if (number >= _IOC_NR(EVIOCGABS(0)) && number < _IOC_NR(EVIOCGABS(ABS_CNT)))
+    {
+        struct input_absinfo *info = static_cast<struct input_absinfo *>(argument);
+        *info = input_absinfo{};
+        info->minimum = -100;
+        info->maximum = 100;
+        return 0;
+    }
+    if (request == EVIOCSCLOCKID)
+        return 0;
+    errno = ENOTTY;
+    return -1;
+}
+
+/**
+ *  @brief Builds an input_event.
+ *  @param type The event type
+ *  @param code The event code
+ *  @param value The event value
+ *  @return The input_event
+ */
+static struct input_event inputEvent(uint16_t type, uint16_t code, int32_t value)
+{
+    struct input_event event{};
+    event.type = type;
+    event.code = code;
+    event.value = value;
+    return event;
+}
+
+/**
+ *  @brief A resync that fills the read() buffer must not lose the input_events read after it.
+ */
+static void testResyncFillingBuffer()
+{
+    int fds[2];
+    CHECK(pipe2(fds, O_NONBLOCK) == 0);
+    deviceFd = fds[0];
+    EvdevSource source;
+    source.adopt(fds[0]);
+    CHECK(source.getAxisCount() == 2);
+    CHECK(source.getButtonCount() == 1);
+
+    // Button, 2 axes and a sync: exactly one buffer of init events
+    JSEvent events[4];
+    CHECK(source.read(events, sizeof(events)) == (ssize_t)sizeof(events));
+    CHECK(!source.hasPending());
+
+    const struct input_event written[] = {
+        inputEvent(EV_SYN, SYN_DROPPED, 0),
+        inputEvent(EV_SYN, SYN_REPORT, 0),
+        inputEvent(EV_ABS, ABS_X, 100),
+        inputEvent(EV_SYN, SYN_REPORT, 0),
+        inputEvent(EV_KEY, BTN_SOUTH, 1),
+        inputEvent(EV_SYN, SYN_REPORT, 0),
+    };
+    CHECK(write(fds[1], written, sizeof(written)) == (ssize_t)sizeof(written));
+
+    // 4 input_events are read, the resync at the second one fills the buffer
+    CHECK(source.read(events, sizeof(events)) == (ssize_t)sizeof(events));
+    for (const JSEvent &event : events)
+        CHECK(event.type & EVENT_INIT);
+    CHECK(source.hasPending());
+
+    CHECK(source.read(events, sizeof(events)) == (ssize_t)sizeof(events));
+    CHECK(events[0].type == EVENT_AXIS && events[0].number == 0 && events[0].value == 32767);
+    CHECK(events[1].type == EVENT_SYNC);
+    CHECK(events[2].type == EVENT_BUTTON && events[2].number == 0 && events[2].value == 1);
+    CHECK(events[3].type == EVENT_SYNC);
+    CHECK(!source.hasPending());
+    CHECK(source.read(events, sizeof(events)) == -1 && errno == EAGAIN);
+
+    source.close();
+    close(fds[1]);
+    deviceFd = -1;
+}
+
+int main()
+{
+    testResyncFillingBuffer();
+    return testResult("EvdevSourceTest");
+}
@@ -0,0 +1,49 @@
+#include "../include/gamepad/Gamepad.h"
+#include "../include/gamepad/JSEvent.h"
+#include "TestCheck.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <string>
+
+/**
+ *  @brief A read() ending inside an event must neither break refresh() nor lose the event.
+ */
+static void testShortRead()
+{
+    char directory[] = "/tmp/GamepadTest.XXXXXX";
+    CHECK(mkdtemp(directory) != nullptr);
+    std::string path = std::string(directory) + "/fifo";
+    CHECK(mkfifo(path.c_str(), 0600) == 0);
+    // Opened read-write so the Gamepad never sees end of stream
+    int writer = open(path.c_str(), O_RDWR | O_NONBLOCK);
+    CHECK(writer >= 0);
+
+    Gamepad gamepad(path);
+    const JSEvent events[2] = {{1, 1234, EVENT_AXIS, 0}, {2, 1, EVENT_BUTTON, 3}};
+    const char *bytes = reinterpret_cast<const char *>(events);
+
+    CHECK(write(writer, bytes, 5) == 5);
+    gamepad.refresh();
+    CHECK(gamepad.getAxis(0) == 0);
+    CHECK(gamepad.getStatus() == OK);
+
+    // The rest of the first event arrives together with the second one
+    CHECK(write(writer, bytes + 5, sizeof(events) - 5) == (ssize_t)(sizeof(events) - 5));
+    gamepad.refresh();
+    CHECK(gamepad.getAxis(0) == 1234);
+    CHECK(gamepad.getButton(3) == 1);
+    CHECK(gamepad.getStatus() == OK);
+
+    close(writer);
+    unlink(path.c_str());
+    rmdir(directory);
+}
+
+int main()
+{
+    testShortRead();
+    return testResult("GamepadTest");
+}
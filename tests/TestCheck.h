@@ -0,0 +1,36 @@
+#ifndef TESTCHECK_H
+#define TESTCHECK_H
+
+#include <cstdio>
+
+// Failed checks are counted rather than aborting, so one run reports all of them
+static int testFailures = 0;
+
+#define CHECK(condition)                                                         \
+    do                                                                           \
+    {                                                                            \
+        if (!(condition))                                                        \
+        {                                                                        \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, \
+                         #condition);                                            \
+            testFailures++;                                                      \
+        }                                                                        \
+    } while (0)
+
+/**
+ *  @brief Prints the outcome of a test program.
+ *  @param name The name of the test program
+ *  @return The exit status, 0 if every check passed
+ */
+static int testResult(const char *name)
+{
+    if (testFailures > 0)
+    {
+        std::fprintf(stderr, "%s: %d check(s) failed\n", name, testFailures);
+        return 1;
+    }
+    std::printf("%s: ok\n", name);
+    return 0;
+}
+
+#endif // TESTCHECK_H